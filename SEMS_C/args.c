@@ -1,6 +1,9 @@
 /* Argument : Function Definition File */
 
 #include "args.h"
+#include "collapse.h"
+#include "epistasis.h"
+#include "stepwise.h"
 
 /*
  * get_params
@@ -25,15 +28,47 @@ args* get_params(int argc, char** argv){
     int nflag = 0;
     int mflag = 0;
     int rflag = 0;
+    int cflag = 0;
+    int tflag = 0;
+    int bflag = 0;
+    int aflag = 0;
+    int eflag = 0;
+    int sflag = 0;
+    int Sflag = 0;
+    int kflag = 0;
+    int qflag = 0;
+    int dflag = 0;
+    int Tflag = 0;
+    int xflag = 0;
+    int lflag = 0;
+    int wflag = 0;
+    int iflag = 0;
+    int Cflag = 0;
+    int Rflag = 0;
     int hflag = 0;
     
     /* Option Arguments. */
     char* g_opt_arg = NULL;
     char* p_opt_arg = NULL;
     char* o_opt_arg = NULL;
+    char* c_opt_arg = NULL;
+    char* r_opt_arg = NULL;
+    char* s_opt_arg = NULL;
+    char* x_opt_arg = NULL;
+    char* C_opt_arg = NULL;
     int n_opt_arg = -1;
     int m_opt_arg = -1;
-    int r_opt_arg = -1;
+    int t_opt_arg = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int b_opt_arg = 0;
+    double a_opt_arg = 0.0;
+    double S_opt_arg = STEPWISE_THRESHOLD;
+    int k_opt_arg = 0;
+    int q_opt_arg = 0;
+    unsigned long long d_opt_arg = 1;
+    int T_opt_arg = 0;
+    double l_opt_arg = 0.0;
+    int w_opt_arg = COLLAPSE_WINDOW;
+    int i_opt_arg = EPISTASIS_TILE;
     
     /* Return argument. */
     args* my_args = NULL;
@@ -52,12 +87,29 @@ args* get_params(int argc, char** argv){
         {"output",    required_argument, NULL, 'o'},
         {"individual",optional_argument, NULL, 'n'},
         {"marker",    optional_argument, NULL, 'm'},
-        {"trait",     optional_argument, NULL, 'r'},
+        {"trait",     required_argument, NULL, 'r'},
+        {"convert",   required_argument, NULL, 'c'},
+        {"threads",   required_argument, NULL, 't'},
+        {"block-markers", required_argument, NULL, 'b'},
+        {"threshold", required_argument, NULL, 'a'},
+        {"epistasis", no_argument,       NULL, 'e'},
+        {"stepwise",  required_argument, NULL, 's'},
+        {"stepwise-threshold", required_argument, NULL, 'S'},
+        {"max-terms", required_argument, NULL, 'k'},
+        {"permutations", required_argument, NULL, 'q'},
+        {"seed",      required_argument, NULL, 'd'},
+        {"top",       required_argument, NULL, 'T'},
+        {"collapse",  required_argument, NULL, 'x'},
+        {"ld-r2",     required_argument, NULL, 'l'},
+        {"ld-window", required_argument, NULL, 'w'},
+        {"tile",      required_argument, NULL, 'i'},
+        {"checkpoint",required_argument, NULL, 'C'},
+        {"resume",    no_argument,       NULL, 'R'},
         {0, 0, 0, 0}
     };
     
     /* Start getopt_long_only option parsing loop. */
-    while((opt = getopt_long_only(argc, argv, "hg:p:o:nmr", long_options, &option_index)) != -1){
+    while((opt = getopt_long_only(argc, argv, "hg:p:o:nmr:c:t:b:a:es:S:k:q:d:T:x:l:w:i:C:R", long_options, &option_index)) != -1){
         switch(opt){
             case 'g':
                 g_opt_arg = optarg;
@@ -80,9 +132,75 @@ args* get_params(int argc, char** argv){
                 mflag++;
                 break;
             case 'r':
-                r_opt_arg = atoi(optarg);
+                r_opt_arg = optarg;
                 rflag++;
                 break;
+            case 'c':
+                c_opt_arg = optarg;
+                cflag++;
+                break;
+            case 't':
+                t_opt_arg = atoi(optarg);
+                tflag++;
+                break;
+            case 'b':
+                b_opt_arg = atoi(optarg);
+                bflag++;
+                break;
+            case 'a':
+                a_opt_arg = atof(optarg);
+                aflag++;
+                break;
+            case 'e':
+                eflag++;
+                break;
+            case 's':
+                s_opt_arg = optarg;
+                sflag++;
+                break;
+            case 'S':
+                S_opt_arg = atof(optarg);
+                Sflag++;
+                break;
+            case 'k':
+                k_opt_arg = atoi(optarg);
+                kflag++;
+                break;
+            case 'q':
+                q_opt_arg = atoi(optarg);
+                qflag++;
+                break;
+            case 'd':
+                d_opt_arg = strtoull(optarg, NULL, 10);
+                dflag++;
+                break;
+            case 'T':
+                T_opt_arg = atoi(optarg);
+                Tflag++;
+                break;
+            case 'x':
+                x_opt_arg = optarg;
+                xflag++;
+                break;
+            case 'l':
+                l_opt_arg = atof(optarg);
+                lflag++;
+                break;
+            case 'w':
+                w_opt_arg = atoi(optarg);
+                wflag++;
+                break;
+            case 'i':
+                i_opt_arg = atoi(optarg);
+                iflag++;
+                break;
+            case 'C':
+                C_opt_arg = optarg;
+                Cflag++;
+                break;
+            case 'R':
+                Rflag++;
+                break;
             
             /* Help. */
             case 'h':
@@ -94,7 +212,51 @@ args* get_params(int argc, char** argv){
                 printf("\nOptional Arguments:\n");
                 printf("    -individual (-n)  |  input: number of individuals  |  example: -t 1000\n");
                 printf("    -marker     (-m)  |  input: number of markers      |  example: -m 1000\n");
-                printf("    -trait      (-r)  |  input: number of traits       |  example: -r 1000\n\n");
+                printf("    -trait      (-r)  |  input: traits to scan (1-based) |  example: -r 1-10,15\n");
+                printf("                      |  (default: every trait in the phenotype file)\n");
+                printf("    -threads    (-t)  |  input: number of threads      |  example: -t 8\n");
+                printf("    -block-markers (-b) | input: stream K markers at a time |  example: -b 10000\n");
+                printf("                      |  (bounds genotype memory to two blocks of K markers)\n");
+                printf("    -threshold  (-a)  |  input: p-value threshold      |  example: -a 5e-8\n");
+                printf("                      |  (only markers at or below it are written)\n");
+                printf("    -epistasis  (-e)  |  also scan every marker pair a*b |  example: -e\n");
+                printf("    -stepwise   (-s)  |  output: stepwise models       |  example: -s model.txt\n");
+                printf("    -stepwise-threshold (-S) | input: p-value to enter and stay |  example: -S 0.01\n");
+                printf("                      |  (with -s; default 0.05, independent of -a)\n");
+                printf("    -max-terms  (-k)  |  input: largest stepwise model |  example: -k 50\n");
+                printf("    -top        (-T)  |  input: tests kept per trait   |  example: -T 1000\n");
+                printf("                      |  (writes only the K largest |t| per trait and the -a hits,\n");
+                printf("                      |   sorted, instead of every test; pairs on -t threads)\n");
+                printf("    -collapse   (-x)  |  output: marker map            |  example: -x map.txt\n");
+                printf("                      |  (-e scans one representative of each set of identical\n");
+                printf("                      |   markers; the map gives each marker's representative)\n");
+                printf("    -ld-r2      (-l)  |  input: r^2 to clump markers at |  example: -l 0.95\n");
+                printf("                      |  (with -x, also collapses markers in LD)\n");
+                printf("    -ld-window  (-w)  |  input: markers compared per clump |  example: -w 100\n");
+                printf("                      |  (with -l; default 100)\n");
+                printf("    -tile       (-i)  |  input: markers per pair tile side |  example: -i 128\n");
+                printf("                      |  (with -e; a multiple of 2, default 64)\n");
+                printf("    -checkpoint (-C)  |  output: progress of the run   |  example: -C run.ckp\n");
+                printf("                      |  (with -e or -s; saved at most once a minute and in\n");
+                printf("                      |   under 1%% of the run time, removed when the run ends)\n");
+                printf("    -resume     (-R)  |  go on from the -C file        |  example: -C run.ckp -R\n");
+                printf("                      |  (same data and options; starts over if there is none)\n");
+                printf("\nPermutation Mode:\n");
+                printf("    -permutations (-q) | input: permutations per trait |  example: -q 1000\n");
+                printf("                      |  (-o gets empirical thresholds instead of the scan;\n");
+                printf("                      |   levels 0.01, 0.05, 0.1, or the -a level)\n");
+                printf("    -seed       (-d)  |  input: random seed            |  example: -d 42\n");
+                printf("\nDistributed Runs:\n");
+                printf("    mpirun -np N main ... splits the single-marker and pairwise scans over\n");
+                printf("    N ranks; rank 0 loads the data and writes every file\n");
+                printf("    (convert, permutation and -block-markers runs use rank 0 alone)\n");
+                printf("    (-stepwise selects on rank 0; final models of 2^28 or more design cells\n");
+                printf("     are fitted over every rank with ScaLAPACK)\n");
+                printf("\nConvert Mode:\n");
+                printf("    -convert    (-c)  |  output: binary genotype cache |  example: -g file.txt -c file.bin\n");
+                printf("                      |  (replaces -p and -o; later runs can pass file.bin to -g)\n");
+                printf("                      |  (marker statistics go to file.bin.stats, reused while\n");
+                printf("                      |   file.bin is unchanged)\n\n");
                 hflag++;
                 errflag++;
                 break;
@@ -125,23 +287,211 @@ args* get_params(int argc, char** argv){
     for(i = optind; i < argc; i++)
         fprintf(stderr, "non-option argument: %s\n", argv[i]);
     
-    if(!gflag || !pflag || !oflag){
+    if(!gflag || (!cflag && (!pflag || !oflag))){
         fprintf(stderr, "not all required arguments satisfied\n");
         printf("use \"-help\" for a description of valid arguments\n");
         return NULL;
     }
     
+    if(t_opt_arg < 1)
+        t_opt_arg = 1;
+    
+    if(bflag && b_opt_arg < 1){
+        fprintf(stderr, "-block-markers must be positive\n");
+        return NULL;
+    }
+    
+    if(aflag && !(a_opt_arg > 0.0 && a_opt_arg < 1.0)){
+        fprintf(stderr, "-threshold must be between 0 and 1\n");
+        return NULL;
+    }
+    
+    if(eflag && bflag){
+        fprintf(stderr, "-epistasis needs every marker in memory; drop -block-markers\n");
+        return NULL;
+    }
+    
+    if(sflag && bflag){
+        fprintf(stderr, "-stepwise needs every marker in memory; drop -block-markers\n");
+        return NULL;
+    }
+    
+    if(Sflag && (!sflag || !(S_opt_arg > 0.0 && S_opt_arg < 1.0))){
+        fprintf(stderr, "-stepwise-threshold must be between 0 and 1 and needs -stepwise\n");
+        return NULL;
+    }
+    
+    if(kflag && (!sflag || k_opt_arg < 1)){
+        fprintf(stderr, "-max-terms must be positive and needs -stepwise\n");
+        return NULL;
+    }
+    
+    if(qflag && q_opt_arg < 1){
+        fprintf(stderr, "-permutations must be positive\n");
+        return NULL;
+    }
+    
+    if(qflag && (bflag || eflag || sflag)){
+        fprintf(stderr, "-permutations cannot be used with -block-markers, -epistasis or -stepwise\n");
+        return NULL;
+    }
+    
+    if(Tflag && T_opt_arg < 1){
+        fprintf(stderr, "-top must be positive\n");
+        return NULL;
+    }
+    
+    if(Tflag && qflag){
+        fprintf(stderr, "-top cannot be used with -permutations\n");
+        return NULL;
+    }
+    
+    if(xflag && !eflag){
+        fprintf(stderr, "-collapse needs -epistasis\n");
+        return NULL;
+    }
+    
+    if(lflag && (!xflag || !(l_opt_arg > 0.0 && l_opt_arg <= 1.0))){
+        fprintf(stderr, "-ld-r2 must be in (0, 1] and needs -collapse\n");
+        return NULL;
+    }
+    
+    if(wflag && (!lflag || w_opt_arg < 1)){
+        fprintf(stderr, "-ld-window must be positive and needs -ld-r2\n");
+        return NULL;
+    }
+    
+    if(iflag && (!eflag || i_opt_arg < 1 || i_opt_arg % EPISTASIS_GROUP != 0)){
+        fprintf(stderr, "-tile must be a positive multiple of %d and needs -epistasis\n", EPISTASIS_GROUP);
+        return NULL;
+    }
+    
+    if(Cflag && !eflag && !sflag){
+        fprintf(stderr, "-checkpoint needs -epistasis or -stepwise\n");
+        return NULL;
+    }
+    
+    if(Rflag && !Cflag){
+        fprintf(stderr, "-resume needs -checkpoint\n");
+        return NULL;
+    }
+    
+    if(dflag && !qflag){
+        fprintf(stderr, "-seed needs -permutations\n");
+        return NULL;
+    }
+    
+    if(bflag && cflag){
+        fprintf(stderr, "-block-markers cannot be used with -convert\n");
+        return NULL;
+    }
+    
     /* Fill args struct. */
     my_args->genotypeFile = g_opt_arg;
     my_args->phenotypeFile = p_opt_arg;
     my_args->outputFile = o_opt_arg;
+    my_args->convertFile = c_opt_arg;
     my_args->n_individual = n_opt_arg;
     my_args->n_marker = m_opt_arg;
-    my_args->n_trait = r_opt_arg;
+    my_args->traitSet = r_opt_arg;
+    my_args->n_threads = t_opt_arg;
+    my_args->block_markers = b_opt_arg;
+    my_args->threshold = a_opt_arg;
+    my_args->stepwise_threshold = S_opt_arg;
+    my_args->epistasis = eflag;
+    my_args->stepwiseFile = s_opt_arg;
+    my_args->max_terms = k_opt_arg;
+    my_args->n_perm = q_opt_arg;
+    my_args->seed = d_opt_arg;
+    my_args->top = T_opt_arg;
+    my_args->collapseFile = x_opt_arg;
+    my_args->ld_r2 = l_opt_arg;
+    my_args->ld_window = w_opt_arg;
+    my_args->tile = i_opt_arg;
+    my_args->checkpointFile = C_opt_arg;
+    my_args->resume = Rflag;
     
     return my_args;
 }
 
+/*
+ * parse_index_set
+ *   DESCRIPTION: Parses a list of 1-based indices and ranges such as
+ *                "1-10,15" into 0-based indices.
+ *   INPUTS: spec    -- index list, NULL for all indices.
+ *           n       -- number of valid indices.
+ *   OUTPUTS: n_index -- number of parsed indices.
+ *   RETURN VALUE: Newly allocated array of indices, NULL on failure.
+ *   SIDE EFFECTS: Allocates an array.
+ */
+int* parse_index_set(const char* spec, int n, int* n_index){
+
+    int* index = NULL;          /* Return argument.   */
+    int* grown = NULL;
+    int capacity = n;
+    const char* p = spec;       /* Parse pointer.     */
+    char* end = NULL;
+    long lo, hi, k;             /* Current range.     */
+
+    *n_index = 0;
+    if(capacity < 1)
+        capacity = 1;
+    if((index = (int*)malloc(capacity * sizeof(int))) == NULL){
+        fprintf(stderr, "cannot allocate memory: index set\n");
+        return NULL;
+    }
+
+    /* Default: everything. */
+    if(spec == NULL){
+        for(k = 0; k < n; k++)
+            index[k] = (int)k;
+        *n_index = n;
+        return index;
+    }
+
+    while(*p != '\0'){
+        lo = hi = strtol(p, &end, 10);
+        if(end == p)
+            break;
+        p = end;
+        if(*p == '-'){
+            hi = strtol(p + 1, &end, 10);
+            if(end == p + 1)
+                break;
+            p = end;
+        }
+        if(lo < 1 || hi > n || lo > hi){
+            fprintf(stderr, "index range %ld-%ld outside 1-%d\n", lo, hi, n);
+            free(index);
+            return NULL;
+        }
+        for(k = lo; k <= hi; k++){
+            if(*n_index == capacity){
+                capacity *= 2;
+                if((grown = (int*)realloc(index, capacity * sizeof(int))) == NULL){
+                    fprintf(stderr, "cannot allocate memory: index set\n");
+                    free(index);
+                    return NULL;
+                }
+                index = grown;
+            }
+            index[(*n_index)++] = (int)(k - 1);
+        }
+        if(*p == ',')
+            p++;
+        else if(*p != '\0')
+            break;
+    }
+
+    if(*p != '\0' || *n_index == 0){
+        fprintf(stderr, "invalid index list \"%s\"\n", spec);
+        free(index);
+        return NULL;
+    }
+
+    return index;
+}
+
 /*
  * free_params
  *   DESCRIPTION: Deallocates memory associated with an args struct.
@@ -12,10 +12,27 @@ typedef struct {
     char* genotypeFile;
     char* phenotypeFile;
     char* outputFile;
+    char* convertFile;
+    char* traitSet;
+    char* stepwiseFile;
+    char* collapseFile;
+    char* checkpointFile;
     
     int n_individual;
     int n_marker;
-    int n_trait;
+    int n_threads;
+    int block_markers;
+    double threshold;
+    double stepwise_threshold;
+    int epistasis;
+    int max_terms;
+    int n_perm;
+    int top;
+    unsigned long long seed;
+    double ld_r2;
+    int ld_window;
+    int tile;
+    int resume;
 } args;
 
 
@@ -31,6 +48,18 @@ typedef struct {
  */
 args* get_params(int argc, char** argv);
 
+/*
+ * parse_index_set
+ *   DESCRIPTION: Parses a list of 1-based indices and ranges such as
+ *                "1-10,15" into 0-based indices.
+ *   INPUTS: spec    -- index list, NULL for all indices.
+ *           n       -- number of valid indices.
+ *   OUTPUTS: n_index -- number of parsed indices.
+ *   RETURN VALUE: Newly allocated array of indices, NULL on failure.
+ *   SIDE EFFECTS: Allocates an array.
+ */
+int* parse_index_set(const char* spec, int n, int* n_index);
+
 /*
  * free_params
  *   DESCRIPTION: Deallocates memory associated with an args struct.
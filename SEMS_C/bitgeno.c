@@ -0,0 +1,228 @@
+/* Bit-Packed Genotype : Function Definition File */
+
+#include "bitgeno.h"
+
+/*
+ * bitgeno_is_dosage
+ *   DESCRIPTION: Checks whether every value of a genotype slab is 0, 1
+ *                or 2 (missing values do not pack).
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if every value is a dosage, (0) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+int bitgeno_is_dosage(const float* x, int ldx, int n_marker, int n_individual){
+
+    float v = 0.0f;
+    int i, j;                   /* Loop variables. */
+
+    for(j = 0; j < n_marker; j++){
+        for(i = 0; i < n_individual; i++){
+            v = x[(size_t)j * ldx + i];
+            if(!(v == 0.0f || v == 1.0f || v == 2.0f))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * bitgeno_create
+ *   DESCRIPTION: Packs a genotype slab of 0/1/2 dosages.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated bitgeno, NULL on failure or
+ *                 if a value is not a dosage.
+ *   SIDE EFFECTS: Allocates a bitgeno.
+ */
+bitgeno* bitgeno_create(const float* x, int ldx, int n_marker, int n_individual){
+
+    bitgeno* g = NULL;          /* Return argument. */
+    const float* c = NULL;
+    uint64_t* one = NULL;
+    uint64_t* two = NULL;
+    uint64_t bit = 0;
+    size_t n_bits = 0;
+    int i, j;                   /* Loop variables. */
+
+    if((g = (bitgeno*)calloc(1, sizeof(bitgeno))) == NULL){
+        fprintf(stderr, "cannot allocate memory: bitgeno*\n");
+        return NULL;
+    }
+    g->n_marker = n_marker;
+    g->n_individual = n_individual;
+    g->n_word = bitgeno_words(n_individual);
+    n_bits = (size_t)n_marker * g->n_word;
+
+    if((g->one = (uint64_t*)calloc(n_bits, sizeof(uint64_t))) == NULL ||
+       (g->two = (uint64_t*)calloc(n_bits, sizeof(uint64_t))) == NULL ||
+       (g->has_two = (unsigned char*)calloc(n_marker, 1)) == NULL){
+        fprintf(stderr, "cannot allocate memory: bitgeno*\n");
+        free_bitgeno(g);
+        return NULL;
+    }
+
+    for(j = 0; j < n_marker; j++){
+        c = x + (size_t)j * ldx;
+        one = g->one + (size_t)j * g->n_word;
+        two = g->two + (size_t)j * g->n_word;
+        for(i = 0; i < n_individual; i++){
+            bit = (uint64_t)1 << (i % BITGENO_WORD);
+            if(c[i] == 1.0f)
+                one[i / BITGENO_WORD] |= bit;
+            else if(c[i] == 2.0f){
+                two[i / BITGENO_WORD] |= bit;
+                g->has_two[j] = 1;
+            }
+            else if(c[i] != 0.0f){
+                fprintf(stderr, "cannot pack genotype: marker %d, individual %d is not a 0/1/2 dosage\n",
+                        j + 1, i + 1);
+                free_bitgeno(g);
+                return NULL;
+            }
+        }
+    }
+
+    return g;
+}
+
+/*
+ * bitgeno_mask
+ *   DESCRIPTION: Mask of the individuals with a nonzero weight, such as
+ *                the observed individuals of a trait (scan_trait w).
+ *   INPUTS: w            -- weights.
+ *           n_individual -- number of individuals.
+ *           mask         -- bitgeno_words(n_individual) words.
+ *   OUTPUTS: mask
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void bitgeno_mask(const float* w, int n_individual, uint64_t* mask){
+
+    int i = 0;                  /* Loop variable. */
+
+    memset(mask, 0, bitgeno_words(n_individual) * sizeof(uint64_t));
+    for(i = 0; i < n_individual; i++)
+        if(w[i] != 0.0f)
+            mask[i / BITGENO_WORD] |= (uint64_t)1 << (i % BITGENO_WORD);
+}
+
+/*
+ * pair_counts
+ *   DESCRIPTION: c11, c12, c21 and c22 of one pair; the counts of an
+ *                empty two plane are 0 without a pass.
+ *   INPUTS: oa, ta -- planes of marker a (already masked).
+ *           ob, tb -- planes of marker b.
+ *           n_word -- words per plane.
+ *           ha, hb -- whether a and b have a 2.
+ *           c      -- four counts.
+ *   OUTPUTS: c
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+static void pair_counts(const uint64_t* oa, const uint64_t* ta, const uint64_t* ob,
+                        const uint64_t* tb, int n_word, int ha, int hb, long* c){
+
+    int w = 0;                  /* Loop variable. */
+
+    c[0] = c[1] = c[2] = c[3] = 0;
+    if(ha && hb){
+        for(w = 0; w < n_word; w++){
+            c[0] += bitgeno_popcount(oa[w] & ob[w]);
+            c[1] += bitgeno_popcount(oa[w] & tb[w]);
+            c[2] += bitgeno_popcount(ta[w] & ob[w]);
+            c[3] += bitgeno_popcount(ta[w] & tb[w]);
+        }
+    }
+    else if(ha){
+        for(w = 0; w < n_word; w++){
+            c[0] += bitgeno_popcount(oa[w] & ob[w]);
+            c[2] += bitgeno_popcount(ta[w] & ob[w]);
+        }
+    }
+    else if(hb){
+        for(w = 0; w < n_word; w++){
+            c[0] += bitgeno_popcount(oa[w] & ob[w]);
+            c[1] += bitgeno_popcount(oa[w] & tb[w]);
+        }
+    }
+    else{
+        for(w = 0; w < n_word; w++)
+            c[0] += bitgeno_popcount(oa[w] & ob[w]);
+    }
+}
+
+/*
+ * bitgeno_tile
+ *   DESCRIPTION: Pair sums of a tile pair over a mask:
+ *                s1[b * ld + a] = sum x_a x_b and s2 the sum of its
+ *                squares, for markers i0 + a and j0 + b. On a diagonal
+ *                tile (i0 == j0) only b > a is filled.
+ *   INPUTS: g    -- pointer to bitgeno.
+ *           i0   -- first marker of the rows.
+ *           n_i  -- rows.
+ *           j0   -- first marker of the columns.
+ *           n_j  -- columns.
+ *           mask -- individuals to sum over, NULL for all.
+ *           work -- 2 * n_word words of scratch, used with a mask.
+ *           s1   -- sums of products.
+ *           s2   -- sums of squared products.
+ *           ld   -- leading dimension of s1 and s2.
+ *   OUTPUTS: s1, s2
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void bitgeno_tile(const bitgeno* g, int i0, int n_i, int j0, int n_j, const uint64_t* mask,
+                  uint64_t* work, float* s1, float* s2, int ld){
+
+    const uint64_t* oa = NULL;
+    const uint64_t* ta = NULL;
+    size_t nw = g->n_word;
+    size_t s = 0;
+    long c[4];                  /* c11, c12, c21, c22         */
+    int a, b, w;                /* Loop variables.            */
+
+    for(a = 0; a < n_i; a++){
+        oa = g->one + (i0 + a) * nw;
+        ta = g->two + (i0 + a) * nw;
+        /* The mask is applied once per row marker, not once per pair. */
+        if(mask != NULL){
+            for(w = 0; w < (int)nw; w++){
+                work[w] = oa[w] & mask[w];
+                work[nw + w] = ta[w] & mask[w];
+            }
+            oa = work;
+            ta = work + nw;
+        }
+        for(b = (i0 == j0) ? a + 1 : 0; b < n_j; b++){
+            pair_counts(oa, ta, g->one + (j0 + b) * nw, g->two + (j0 + b) * nw, (int)nw,
+                        g->has_two[i0 + a], g->has_two[j0 + b], c);
+            s = (size_t)b * ld + a;
+            s1[s] = (float)(c[0] + 2 * (c[1] + c[2]) + 4 * c[3]);
+            s2[s] = (float)(c[0] + 4 * (c[1] + c[2]) + 16 * c[3]);
+        }
+    }
+}
+
+/*
+ * free_bitgeno
+ *   DESCRIPTION: Deallocates memory associated with a bitgeno.
+ *   INPUTS: g -- pointer to bitgeno.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a bitgeno.
+ */
+void free_bitgeno(bitgeno* g){
+    if(g != NULL){
+        free(g->one);
+        free(g->two);
+        free(g->has_two);
+        free(g);
+    }
+}
@@ -0,0 +1,140 @@
+/* Bit-Packed Genotype : Header File */
+
+#ifndef BITGENO_H
+#define BITGENO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Individuals per word of a bit plane. */
+#define BITGENO_WORD 64
+
+/*
+ * Biallelic dosages packed as two bit planes per marker: bit i of one is
+ * set where individual i carries one copy, bit i of two where it carries
+ * two, so x = one + 2 two and x^2 = one + 4 two. The pair scan takes the
+ * genotype-only sums of a tile pair from them, over the individuals of a
+ * mask m (all of them, or the observed ones of a trait), as weighted
+ * sums of popcounts of ANDed words:
+ *     sum x_a x_b     = c11 + 2 c12 + 2 c21 +  4 c22
+ *     sum x_a^2 x_b^2 = c11 + 4 c12 + 4 c21 + 16 c22
+ * with c11 = |one_a one_b m|, c12 = |one_a two_b m| and so on. The sums
+ * are exact integers. The planes are built next to the float slab, which
+ * every sum involving a trait still reads, so they add two bits per
+ * individual and marker rather than replace the float column. Markers
+ * without a single 2 skip their two plane, so 0/1 panels cost one AND and
+ * one popcount per word and pair. Padding bits past n_individual are 0 in
+ * every plane and mask.
+ */
+typedef struct {
+    int n_marker;
+    int n_individual;
+    int n_word;                 /* Words per plane.                    */
+    uint64_t* one;              /* Marker j: one[j * n_word ...].      */
+    uint64_t* two;
+    unsigned char* has_two;     /* Whether marker j has a 2.           */
+} bitgeno;
+
+
+
+/*
+ * bitgeno_words
+ *   DESCRIPTION: Words of one plane or mask of n individuals.
+ */
+static inline int bitgeno_words(int n_individual){
+    return (n_individual + BITGENO_WORD - 1) / BITGENO_WORD;
+}
+
+/*
+ * bitgeno_popcount
+ *   DESCRIPTION: Number of set bits of a word: the POPCNT instruction
+ *                when the target has it, a SWAR count otherwise.
+ */
+static inline int bitgeno_popcount(uint64_t v){
+#if defined(__GNUC__) && defined(__POPCNT__)
+    return __builtin_popcountll(v);
+#else
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/*
+ * bitgeno_is_dosage
+ *   DESCRIPTION: Checks whether every value of a genotype slab is 0, 1
+ *                or 2 (missing values do not pack).
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if every value is a dosage, (0) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+int bitgeno_is_dosage(const float* x, int ldx, int n_marker, int n_individual);
+
+/*
+ * bitgeno_create
+ *   DESCRIPTION: Packs a genotype slab of 0/1/2 dosages.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated bitgeno, NULL on failure or
+ *                 if a value is not a dosage.
+ *   SIDE EFFECTS: Allocates a bitgeno.
+ */
+bitgeno* bitgeno_create(const float* x, int ldx, int n_marker, int n_individual);
+
+/*
+ * bitgeno_mask
+ *   DESCRIPTION: Mask of the individuals with a nonzero weight, such as
+ *                the observed individuals of a trait (scan_trait w).
+ *   INPUTS: w            -- weights.
+ *           n_individual -- number of individuals.
+ *           mask         -- bitgeno_words(n_individual) words.
+ *   OUTPUTS: mask
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void bitgeno_mask(const float* w, int n_individual, uint64_t* mask);
+
+/*
+ * bitgeno_tile
+ *   DESCRIPTION: Pair sums of a tile pair over a mask:
+ *                s1[b * ld + a] = sum x_a x_b and s2 the sum of its
+ *                squares, for markers i0 + a and j0 + b. On a diagonal
+ *                tile (i0 == j0) only b > a is filled.
+ *   INPUTS: g    -- pointer to bitgeno.
+ *           i0   -- first marker of the rows.
+ *           n_i  -- rows.
+ *           j0   -- first marker of the columns.
+ *           n_j  -- columns.
+ *           mask -- individuals to sum over, NULL for all.
+ *           work -- 2 * n_word words of scratch, used with a mask.
+ *           s1   -- sums of products.
+ *           s2   -- sums of squared products.
+ *           ld   -- leading dimension of s1 and s2.
+ *   OUTPUTS: s1, s2
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void bitgeno_tile(const bitgeno* g, int i0, int n_i, int j0, int n_j, const uint64_t* mask,
+                  uint64_t* work, float* s1, float* s2, int ld);
+
+/*
+ * free_bitgeno
+ *   DESCRIPTION: Deallocates memory associated with a bitgeno.
+ *   INPUTS: g -- pointer to bitgeno.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a bitgeno.
+ */
+void free_bitgeno(bitgeno* g);
+
+#endif
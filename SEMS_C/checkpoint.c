@@ -0,0 +1,352 @@
+/* Checkpoint : Function Definition File */
+
+#include "checkpoint.h"
+#include "dist.h"
+#include "fastio.h"
+
+/*
+ * put, get
+ *   DESCRIPTION: Writes or reads n items of a checkpoint file.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ */
+static int put(const void* data, size_t size, size_t n, FILE* f){
+    return n > 0 && fwrite(data, size, n, f) != n;
+}
+
+static int get(void* data, size_t size, size_t n, FILE* f){
+    return n > 0 && fread(data, size, n, f) != n;
+}
+
+/*
+ * checkpoint_create
+ *   DESCRIPTION: Sets up checkpoints of a run to a file, from the
+ *                beginning.
+ *   INPUTS: fileName    -- checkpoint file.
+ *           fingerprint -- of the data and options (rank 0).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated checkpoint, NULL on failure.
+ *   SIDE EFFECTS: Allocates a checkpoint.
+ */
+checkpoint* checkpoint_create(char* fileName, uint64_t fingerprint){
+
+    checkpoint* c = NULL;       /* Return argument. */
+
+    if((c = (checkpoint*)calloc(1, sizeof(checkpoint))) == NULL){
+        fprintf(stderr, "cannot allocate memory: checkpoint*\n");
+        return NULL;
+    }
+    c->fileName = fileName;
+    c->fingerprint = fingerprint;
+    c->last = wall_time();
+    c->stage = CHECKPOINT_NONE;
+
+    return c;
+}
+
+/*
+ * load_results
+ *   DESCRIPTION: Reads the tests kept by a checkpoint.
+ *   INPUTS: f -- checkpoint file, at the kept tests.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated result_set, NULL on failure.
+ *   SIDE EFFECTS: Allocates a result_set.
+ */
+static result_set* load_results(FILE* f){
+
+    result_set* s = NULL;       /* Return argument. */
+    int head[2];                /* Traits and top.  */
+    double threshold = 0.0;
+    int k;                      /* Loop variable.   */
+
+    if(get(head, sizeof(int), 2, f) || get(&threshold, sizeof(double), 1, f) ||
+       (s = result_set_create(head[0], head[1], threshold)) == NULL)
+        return NULL;
+    if(get(&s->n_hit, sizeof(long), 1, f) || get(&s->n_test, sizeof(long), 1, f) ||
+       get(s->n_heap, sizeof(int), s->n_trait, f))
+        goto fail;
+    for(k = 0; k < s->n_trait; k++)
+        if(s->n_heap[k] < 0 || s->n_heap[k] > s->top ||
+           get(s->heap + (size_t)k * s->top, sizeof(result_entry), s->n_heap[k], f))
+            goto fail;
+    if(s->n_hit > 0){
+        if((s->hit = (result_entry*)malloc(s->n_hit * sizeof(result_entry))) == NULL){
+            fprintf(stderr, "cannot allocate memory: result hits\n");
+            goto fail;
+        }
+        s->max_hit = s->n_hit;
+        if(get(s->hit, sizeof(result_entry), s->n_hit, f))
+            goto fail;
+    }
+
+    return s;
+
+fail:
+    free_result_set(s);
+    return NULL;
+}
+
+/*
+ * checkpoint_load
+ *   DESCRIPTION: Reads the checkpoint file into c.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: c
+ *   RETURN VALUE: (0) on success or a missing file, (1) on failure.
+ *   SIDE EFFECTS: Writes to stderr.
+ */
+static int checkpoint_load(checkpoint* c){
+
+    FILE* f = NULL;
+    char magic[sizeof(CHECKPOINT_MAGIC) - 1];
+    uint64_t fingerprint = 0;
+    int kept = 0;               /* Whether kept tests follow. */
+    size_t bytes = 0;
+    long n_step = 0;
+
+    if((f = fopen(c->fileName, "rb")) == NULL){
+        fprintf(stderr, "No checkpoint %s: starting from the beginning\n", c->fileName);
+        return 0;
+    }
+    if(get(magic, 1, sizeof(magic), f) || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+       get(&fingerprint, sizeof(uint64_t), 1, f)){
+        fprintf(stderr, "%s: not a checkpoint\n", c->fileName);
+        goto fail;
+    }
+    if(fingerprint != c->fingerprint){
+        fprintf(stderr, "%s: checkpoint of other data or options\n", c->fileName);
+        goto fail;
+    }
+    if(get(&c->stage, sizeof(int), 1, f) || get(&c->done, sizeof(long), 1, f) ||
+       get(&c->offset, sizeof(long), 1, f) || get(&kept, sizeof(int), 1, f) ||
+       (kept && (c->kept = load_results(f)) == NULL) ||
+       get(&bytes, sizeof(size_t), 1, f) || get(&n_step, sizeof(long), 1, f) ||
+       (bytes > 0 && checkpoint_model(c, bytes, n_step) == NULL) ||
+       get(c->model, 1, bytes, f)){
+        fprintf(stderr, "%s: cannot read checkpoint\n", c->fileName);
+        goto fail;
+    }
+    fclose(f);
+    fprintf(stderr, "Resuming from %s\n", c->fileName);
+
+    return 0;
+
+fail:
+    fclose(f);
+    return 1;
+}
+
+/*
+ * checkpoint_resume
+ *   DESCRIPTION: Reads the checkpoint file on rank 0 and tells every rank
+ *                the stage and progress to resume at. A missing file
+ *                resumes from the beginning.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: c
+ *   RETURN VALUE: (0) on success, (1) on failure (also a file of another
+ *                 run), the same on every rank.
+ *   SIDE EFFECTS: Collective; writes to stderr.
+ */
+int checkpoint_resume(checkpoint* c){
+
+    int status = 0;
+
+    if(dist_rank() == 0)
+        status = checkpoint_load(c);
+    if(dist_agree(status))
+        return 1;
+    c->stage = (int)dist_agree(c->stage);
+    c->done = dist_agree(c->done);
+    c->last = wall_time();
+
+    return 0;
+}
+
+/*
+ * checkpoint_due
+ *   DESCRIPTION: Whether a checkpoint should be taken now; if so, its cost
+ *                is counted from now.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if due, (0) otherwise.
+ *   SIDE EFFECTS: Updates c.
+ */
+int checkpoint_due(checkpoint* c){
+
+    double now = wall_time();
+
+    if(now - c->last < CHECKPOINT_INTERVAL || (now - c->last) * CHECKPOINT_BUDGET < c->cost)
+        return 0;
+    c->mark = now;
+
+    return 1;
+}
+
+/*
+ * checkpoint_model
+ *   DESCRIPTION: Makes room for the state of the current stepwise model.
+ *   INPUTS: c      -- pointer to checkpoint.
+ *           bytes  -- size of the state, 0 for none.
+ *           n_step -- forward steps taken.
+ *   OUTPUTS: c
+ *   RETURN VALUE: Space for the state in c, NULL on failure.
+ *   SIDE EFFECTS: Updates c.
+ */
+char* checkpoint_model(checkpoint* c, size_t bytes, long n_step){
+
+    char* grown = NULL;
+
+    if(bytes > c->max_model){
+        if((grown = (char*)realloc(c->model, bytes)) == NULL){
+            fprintf(stderr, "cannot allocate memory: checkpoint model\n");
+            return NULL;
+        }
+        c->model = grown;
+        c->max_model = bytes;
+    }
+    c->model_bytes = bytes;
+    c->n_step = n_step;
+
+    return c->model;
+}
+
+/*
+ * save_results
+ *   DESCRIPTION: Writes the tests kept by a checkpoint.
+ *   INPUTS: s -- tests kept.
+ *           f -- checkpoint file.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f.
+ */
+static int save_results(const result_set* s, FILE* f){
+
+    int head[2] = {s->n_trait, s->top};
+    int status = 0;
+    int k;                      /* Loop variable. */
+
+    status |= put(head, sizeof(int), 2, f);
+    status |= put(&s->threshold, sizeof(double), 1, f);
+    status |= put(&s->n_hit, sizeof(long), 1, f);
+    status |= put(&s->n_test, sizeof(long), 1, f);
+    status |= put(s->n_heap, sizeof(int), s->n_trait, f);
+    for(k = 0; k < s->n_trait; k++)
+        status |= put(s->heap + (size_t)k * s->top, sizeof(result_entry), s->n_heap[k], f);
+    status |= put(s->hit, sizeof(result_entry), s->n_hit, f);
+
+    return status;
+}
+
+/*
+ * checkpoint_save
+ *   DESCRIPTION: Writes the state of c to a temporary file and renames it
+ *                over the checkpoint file, on rank 0.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Replaces the checkpoint file.
+ */
+int checkpoint_save(checkpoint* c){
+
+    FILE* f = NULL;
+    char* tmp = NULL;           /* fileName.tmp                */
+    int kept = (c->kept != NULL);
+    int status = 0;
+
+    if(dist_rank() != 0)
+        return 0;
+    if((tmp = (char*)malloc(strlen(c->fileName) + 5)) == NULL){
+        fprintf(stderr, "cannot allocate memory: checkpoint file name\n");
+        return 1;
+    }
+    sprintf(tmp, "%s.tmp", c->fileName);
+    if((f = fopen(tmp, "wb")) == NULL){
+        fprintf(stderr, "cannot open file: %s\n", tmp);
+        free(tmp);
+        return 1;
+    }
+
+    status |= put(CHECKPOINT_MAGIC, 1, sizeof(CHECKPOINT_MAGIC) - 1, f);
+    status |= put(&c->fingerprint, sizeof(uint64_t), 1, f);
+    status |= put(&c->stage, sizeof(int), 1, f);
+    status |= put(&c->done, sizeof(long), 1, f);
+    status |= put(&c->offset, sizeof(long), 1, f);
+    status |= put(&kept, sizeof(int), 1, f);
+    if(kept)
+        status |= save_results(c->kept, f);
+    status |= put(&c->model_bytes, sizeof(size_t), 1, f);
+    status |= put(&c->n_step, sizeof(long), 1, f);
+    status |= put(c->model, 1, c->model_bytes, f);
+
+    /* On disk before it replaces the last one. */
+    status |= (fflush(f) != 0 || fsync(fileno(f)) != 0);
+    status |= (fclose(f) != 0);
+    if(status || rename(tmp, c->fileName) != 0){
+        fprintf(stderr, "cannot write checkpoint: %s\n", c->fileName);
+        remove(tmp);
+        free(tmp);
+        return 1;
+    }
+    free(tmp);
+
+    c->last = wall_time();
+    c->cost = c->last - ((c->mark > 0.0) ? c->mark : c->last);
+    c->mark = 0.0;
+    c->n_save++;
+
+    return 0;
+}
+
+/*
+ * checkpoint_reopen
+ *   DESCRIPTION: Cuts an output file back to the bytes a checkpoint
+ *                accounts for and opens it to append the rest.
+ *   INPUTS: fileName -- output file.
+ *           offset   -- bytes to keep.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: FILE pointer, NULL on failure.
+ *   SIDE EFFECTS: Truncates the file.
+ */
+FILE* checkpoint_reopen(char* fileName, long offset){
+
+    FILE* f = NULL;
+
+    if(truncate(fileName, (off_t)offset) != 0 || (f = fopen(fileName, "a")) == NULL){
+        fprintf(stderr, "cannot reopen file: %s\n", fileName);
+        return NULL;
+    }
+
+    return f;
+}
+
+/*
+ * checkpoint_finish
+ *   DESCRIPTION: Removes the checkpoint file of a finished run and writes
+ *                the checkpoint cost, on rank 0.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Removes the file; writes to stderr.
+ */
+void checkpoint_finish(checkpoint* c){
+
+    if(dist_rank() != 0)
+        return;
+    remove(c->fileName);
+    fprintf(stderr, "Checkpoints: %ld (last %.3f s)\n", c->n_save, c->cost);
+}
+
+/*
+ * free_checkpoint
+ *   DESCRIPTION: Deallocates memory associated with a checkpoint.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a checkpoint.
+ */
+void free_checkpoint(checkpoint* c){
+
+    if(c == NULL)
+        return;
+    free_result_set(c->kept);
+    free(c->model);
+    free(c);
+}
@@ -0,0 +1,160 @@
+/* Checkpoint : Header File */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "results.h"
+
+/* First bytes of a checkpoint file. */
+#define CHECKPOINT_MAGIC "SEMSCKP1"
+
+/*
+ * Fewest seconds between checkpoints. Compile with -DCHECKPOINT_INTERVAL=0
+ * to checkpoint as often as the budget allows.
+ */
+#ifndef CHECKPOINT_INTERVAL
+#define CHECKPOINT_INTERVAL 60.0
+#endif
+
+/* Largest share of the run time that checkpoints may take. */
+#define CHECKPOINT_BUDGET 0.01
+
+/* Stages a run resumes at. */
+#define CHECKPOINT_NONE     0   /* From the beginning.                 */
+#define CHECKPOINT_PAIRS    1   /* Single markers done; pair scan at done. */
+#define CHECKPOINT_STEPWISE 2   /* Scans written; stepwise at trait done. */
+
+/*
+ * Progress of a long run, saved now and then to a binary file so that a
+ * run killed part way can go on with -resume. The pair scan saves the
+ * tile pairs it has finished: with full output, the bytes of the table
+ * they account for, which a resumed run cuts the table back to; with
+ * -top, the tests kept so far over every rank. Stepwise selection saves
+ * the traits it has written and the state of the current one's model
+ * (its factorization and candidate norms, see save_state in
+ * stepwise.c). A checkpoint is written to a temporary file that is then
+ * renamed over the last, so a crash while writing leaves the old one.
+ * The file starts with CHECKPOINT_MAGIC and a fingerprint of the data
+ * and options, and is only resumed by a run with the same fingerprint.
+ * A checkpoint is due no sooner than CHECKPOINT_INTERVAL seconds after
+ * the last, and not before the last one's cost is CHECKPOINT_BUDGET of
+ * the time since. Only rank 0 reads and writes the file.
+ */
+typedef struct {
+    char* fileName;
+    uint64_t fingerprint;       /* Of the data and options.            */
+    double last;                /* wall_time after the last checkpoint. */
+    double mark;                /* wall_time when the current one was due. */
+    double cost;                /* Seconds the last checkpoint took.   */
+    long n_save;
+
+    int stage;
+    long done;                  /* Tile pairs or traits finished.      */
+    long offset;                /* Bytes of the output they account for. */
+    result_set* kept;           /* Tests kept so far (-top), or NULL.  */
+    char* model;                /* State of the current stepwise model. */
+    size_t model_bytes;         /* 0 for none.                         */
+    size_t max_model;
+    long n_step;                /* Its forward steps so far.           */
+} checkpoint;
+
+
+
+/*
+ * checkpoint_create
+ *   DESCRIPTION: Sets up checkpoints of a run to a file, from the
+ *                beginning.
+ *   INPUTS: fileName    -- checkpoint file.
+ *           fingerprint -- of the data and options (rank 0).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated checkpoint, NULL on failure.
+ *   SIDE EFFECTS: Allocates a checkpoint.
+ */
+checkpoint* checkpoint_create(char* fileName, uint64_t fingerprint);
+
+/*
+ * checkpoint_resume
+ *   DESCRIPTION: Reads the checkpoint file on rank 0 and tells every rank
+ *                the stage and progress to resume at. A missing file
+ *                resumes from the beginning.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: c
+ *   RETURN VALUE: (0) on success, (1) on failure (also a file of another
+ *                 run), the same on every rank.
+ *   SIDE EFFECTS: Collective; writes to stderr.
+ */
+int checkpoint_resume(checkpoint* c);
+
+/*
+ * checkpoint_due
+ *   DESCRIPTION: Whether a checkpoint should be taken now; if so, its cost
+ *                is counted from now.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if due, (0) otherwise.
+ *   SIDE EFFECTS: Updates c.
+ */
+int checkpoint_due(checkpoint* c);
+
+/*
+ * checkpoint_model
+ *   DESCRIPTION: Makes room for the state of the current stepwise model.
+ *   INPUTS: c      -- pointer to checkpoint.
+ *           bytes  -- size of the state, 0 for none.
+ *           n_step -- forward steps taken.
+ *   OUTPUTS: c
+ *   RETURN VALUE: Space for the state in c, NULL on failure.
+ *   SIDE EFFECTS: Updates c.
+ */
+char* checkpoint_model(checkpoint* c, size_t bytes, long n_step);
+
+/*
+ * checkpoint_save
+ *   DESCRIPTION: Writes the state of c to a temporary file and renames it
+ *                over the checkpoint file, on rank 0.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Replaces the checkpoint file.
+ */
+int checkpoint_save(checkpoint* c);
+
+/*
+ * checkpoint_reopen
+ *   DESCRIPTION: Cuts an output file back to the bytes a checkpoint
+ *                accounts for and opens it to append the rest.
+ *   INPUTS: fileName -- output file.
+ *           offset   -- bytes to keep.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: FILE pointer, NULL on failure.
+ *   SIDE EFFECTS: Truncates the file.
+ */
+FILE* checkpoint_reopen(char* fileName, long offset);
+
+/*
+ * checkpoint_finish
+ *   DESCRIPTION: Removes the checkpoint file of a finished run and writes
+ *                the checkpoint cost, on rank 0.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Removes the file; writes to stderr.
+ */
+void checkpoint_finish(checkpoint* c);
+
+/*
+ * free_checkpoint
+ *   DESCRIPTION: Deallocates memory associated with a checkpoint.
+ *   INPUTS: c -- pointer to checkpoint.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a checkpoint.
+ */
+void free_checkpoint(checkpoint* c);
+
+#endif
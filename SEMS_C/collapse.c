@@ -0,0 +1,270 @@
+/* Marker Collapsing : Function Definition File */
+
+#include "collapse.h"
+#include "dist.h"
+#include "fastio.h"
+
+#define LAYOUT      CblasColMajor
+
+/*
+ * collapse_duplicates
+ *   DESCRIPTION: Finds the first marker of every set of identical columns
+ *                through an open-addressing hash index of the columns
+ *                kept so far, and copies those columns into c->matrix.
+ *   INPUTS: c -- pointer to collapse, kept and group allocated.
+ *           g -- genotype.
+ *   OUTPUTS: c
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Fills c->kept, c->group, c->n_kept and c->matrix.
+ */
+static int collapse_duplicates(collapse* c, genotype* g){
+
+    int* slot = NULL;           /* Hash index: representative or -1.   */
+    size_t n_slot = 2;
+    size_t mask, k;
+    size_t bytes = (size_t)g->n_individual * sizeof(float);
+    const float* col = NULL;
+    int j;                      /* Loop variable.                      */
+
+    while(n_slot < 2 * (size_t)g->n_marker)
+        n_slot <<= 1;
+    mask = n_slot - 1;
+    if((slot = (int*)malloc(n_slot * sizeof(int))) == NULL){
+        fprintf(stderr, "cannot allocate memory: collapse index\n");
+        return 1;
+    }
+    memset(slot, -1, n_slot * sizeof(int));
+
+    c->n_kept = 0;
+    for(j = 0; j < g->n_marker; j++){
+        col = genotype_column(g, j);
+        k = (size_t)fnv1a(FNV1A_SEED, col, (size_t)g->n_individual * sizeof(float)) & mask;
+        while(slot[k] >= 0 &&
+              memcmp(genotype_column(g, c->kept[slot[k]]), col, bytes) != 0)
+            k = (k + 1) & mask;
+        if(slot[k] < 0){
+            slot[k] = c->n_kept;
+            c->kept[c->n_kept++] = j;
+        }
+        c->group[j] = slot[k];
+        c->r2[j] = 1.0f;
+    }
+    free(slot);
+    c->n_duplicate = g->n_marker - c->n_kept;
+
+    if((c->matrix = matrix_alloc(g->n_individual, c->n_kept, &c->ld)) == NULL)
+        return 1;
+    for(j = 0; j < c->n_kept; j++)
+        memcpy(c->matrix + (size_t)j * c->ld, genotype_column(g, c->kept[j]), bytes);
+
+    return 0;
+}
+
+/*
+ * collapse_clumps
+ *   DESCRIPTION: Clumps the representatives of c->matrix in LD. Each one
+ *                in order that is not yet in a clump starts a clump and
+ *                takes the unclumped complete markers among its next
+ *                window with r^2 >= threshold; their dot products are one
+ *                GEMV over the window's columns, and r^2 follows from the
+ *                marker statistics. Markers with missing values or
+ *                without variance are never clumped. The clump roots are
+ *                then compacted to the front of c->matrix.
+ *   INPUTS: c         -- pointer to collapse after collapse_duplicates.
+ *           st        -- statistics of the source markers.
+ *           threshold -- r^2 at which markers are clumped.
+ *           window    -- following representatives compared with each.
+ *   OUTPUTS: c
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Updates c->kept, c->group, c->r2, c->n_kept and
+ *                 c->matrix.
+ */
+static int collapse_clumps(collapse* c, const marker_stats* st, double threshold, int window){
+
+    int* root = NULL;           /* Clump of each representative, -1: none. */
+    int* index = NULL;          /* Compacted position of each root.    */
+    float* best = NULL;         /* r^2 of each member with its root.   */
+    float* dot = NULL;          /* Dot products of one window.         */
+    int n = c->n_individual;
+    int a, b, j, m, w, u, v;    /* Loop variables.                     */
+    double cov, r2;
+
+    if((root = (int*)malloc(c->n_kept * sizeof(int))) == NULL ||
+       (index = (int*)malloc(c->n_kept * sizeof(int))) == NULL ||
+       (best = (float*)malloc(c->n_kept * sizeof(float))) == NULL ||
+       (dot = (float*)malloc(((window > 0) ? window : 1) * sizeof(float))) == NULL){
+        fprintf(stderr, "cannot allocate memory: collapse clumps\n");
+        free(root);
+        free(index);
+        free(best);
+        return 1;
+    }
+    for(a = 0; a < c->n_kept; a++)
+        root[a] = -1;
+
+    for(a = 0; a < c->n_kept; a++){
+        if(root[a] >= 0)
+            continue;
+        root[a] = a;
+        best[a] = 1.0f;
+        u = c->kept[a];
+        if(st->n_missing[u] > 0 || !(st->css[u] > 0.0))
+            continue;
+        w = (c->n_kept - a - 1 < window) ? c->n_kept - a - 1 : window;
+        if(w < 1)
+            continue;
+        cblas_sgemv(LAYOUT, CblasTrans, n, w, 1.0f, c->matrix + (size_t)(a + 1) * c->ld, c->ld,
+                    c->matrix + (size_t)a * c->ld, 1, 0.0f, dot, 1);
+        for(b = a + 1; b <= a + w; b++){
+            v = c->kept[b];
+            if(root[b] >= 0 || st->n_missing[v] > 0 || !(st->css[v] > 0.0))
+                continue;
+            cov = dot[b - a - 1] - st->sum[u] * st->sum[v] / n;
+            r2 = cov * cov / (st->css[u] * st->css[v]);
+            if(r2 >= threshold){
+                root[b] = a;
+                best[b] = (float)((r2 < 1.0) ? r2 : 1.0);
+            }
+        }
+    }
+
+    /* Compact the roots; a root never moves past its old position. */
+    for(a = 0, m = 0; a < c->n_kept; a++){
+        if(root[a] != a)
+            continue;
+        index[a] = m;
+        if(m != a)
+            memcpy(c->matrix + (size_t)m * c->ld, c->matrix + (size_t)a * c->ld,
+                   (size_t)n * sizeof(float));
+        c->kept[m++] = c->kept[a];
+    }
+    for(j = 0; j < c->n_marker; j++){
+        a = c->group[j];
+        c->group[j] = index[root[a]];
+        c->r2[j] = best[a];
+    }
+    c->n_clumped = c->n_kept - m;
+    c->n_kept = m;
+
+    free(root);
+    free(index);
+    free(best);
+    free(dot);
+
+    return 0;
+}
+
+/*
+ * collapse_create
+ *   DESCRIPTION: Collapses the duplicate markers of a genotype and, with
+ *                a threshold, clumps markers in LD.
+ *   INPUTS: g         -- genotype.
+ *           st        -- statistics of g.
+ *           threshold -- r^2 at which markers are clumped, 0 for none.
+ *           window    -- following representatives compared with each.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated collapse, NULL on failure.
+ *   SIDE EFFECTS: Allocates a collapse; writes to stderr.
+ */
+collapse* collapse_create(genotype* g, const marker_stats* st, double threshold, int window){
+
+    collapse* c = NULL;         /* Return argument. */
+    double start = wall_time();
+    double before, after;
+    int j;                      /* Loop variable.   */
+
+    if((c = (collapse*)calloc(1, sizeof(collapse))) == NULL){
+        fprintf(stderr, "cannot allocate memory: collapse*\n");
+        return NULL;
+    }
+    c->n_marker = g->n_marker;
+    c->n_individual = g->n_individual;
+
+    if((c->kept = (int*)malloc(((g->n_marker > 0) ? g->n_marker : 1) * sizeof(int))) == NULL ||
+       (c->group = (int*)malloc(((g->n_marker > 0) ? g->n_marker : 1) * sizeof(int))) == NULL ||
+       (c->r2 = (float*)malloc(((g->n_marker > 0) ? g->n_marker : 1) * sizeof(float))) == NULL){
+        fprintf(stderr, "cannot allocate memory: collapse*\n");
+        free_collapse(c);
+        return NULL;
+    }
+
+    if(collapse_duplicates(c, g) ||
+       (threshold > 0.0 && collapse_clumps(c, st, threshold, window))){
+        free_collapse(c);
+        return NULL;
+    }
+
+    if((c->marker = name_table_create(c->n_kept, 16 * (size_t)c->n_kept)) == NULL){
+        free_collapse(c);
+        return NULL;
+    }
+    for(j = 0; j < c->n_kept; j++){
+        if(name_table_add(c->marker, name_table_get(g->marker, c->kept[j]),
+                          strlen(name_table_get(g->marker, c->kept[j]))) < 0){
+            free_collapse(c);
+            return NULL;
+        }
+    }
+    if((c->st = marker_stats_create(c->matrix, c->ld, c->n_kept, c->n_individual)) == NULL){
+        free_collapse(c);
+        return NULL;
+    }
+
+    before = 0.5 * (double)c->n_marker * (c->n_marker - 1);
+    after = 0.5 * (double)c->n_kept * (c->n_kept - 1);
+    if(dist_rank() == 0)
+        fprintf(stderr, "Collapsed markers: %d of %d kept (%d duplicates, %d in LD), "
+                "pairs %.4g -> %.4g in %.3f s\n",
+                c->n_kept, c->n_marker, c->n_duplicate, c->n_clumped, before, after,
+                wall_time() - start);
+
+    return c;
+}
+
+/*
+ * collapse_write
+ *   DESCRIPTION: Writes one line per source marker: its name, the name of
+ *                its representative and their r^2.
+ *   INPUTS: c        -- pointer to collapse.
+ *           fileName -- name of output file.
+ *           marker   -- names of the source markers.
+ *   OUTPUTS: fileName
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to fileName.
+ */
+int collapse_write(const collapse* c, char* fileName, const name_table* marker){
+
+    FILE* f = NULL;
+    int j;                      /* Loop variable. */
+
+    if((f = fopen(fileName, "w")) == NULL){
+        fprintf(stderr, "cannot open file \"%s\"\n", fileName);
+        return 1;
+    }
+    fprintf(f, "Marker\tRepresentative\tR2\n");
+    for(j = 0; j < c->n_marker; j++)
+        fprintf(f, "%s\t%s\t%g\n", name_table_get(marker, j),
+                name_table_get(c->marker, c->group[j]), c->r2[j]);
+
+    return fclose(f) != 0;
+}
+
+/*
+ * free_collapse
+ *   DESCRIPTION: Deallocates memory associated with a collapse.
+ *   INPUTS: c -- pointer to collapse.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a collapse.
+ */
+void free_collapse(collapse* c){
+    if(c != NULL){
+        free(c->kept);
+        free(c->group);
+        free(c->r2);
+        free(c->matrix);
+        free_name_table(c->marker);
+        free_marker_stats(c->st);
+        free(c);
+    }
+}
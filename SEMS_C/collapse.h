@@ -0,0 +1,86 @@
+/* Marker Collapsing : Header File */
+
+#ifndef COLLAPSE_H
+#define COLLAPSE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "mkl.h"
+#include "data.h"
+#include "markerstats.h"
+#include "names.h"
+
+/* Following markers an LD representative is compared with by default. */
+#define COLLAPSE_WINDOW 100
+
+/*
+ * A reduced marker set for the pairwise scan. Markers whose columns are
+ * bit-identical (hashed, then compared) become one representative, the
+ * first of them. With an r^2 threshold, each remaining representative in
+ * marker order that is not yet in a clump then takes every complete
+ * marker among its next window representatives with r^2 at or above the
+ * threshold into its clump. A set of m markers collapsed to k has
+ * k (k - 1) / 2 pairs instead of m (m - 1) / 2.
+ * The representatives are copied into one slab with their own names and
+ * statistics, so the scans run on them unchanged; group and r2 map every
+ * source marker back to its representative for reporting.
+ */
+typedef struct {
+    int n_marker;               /* Markers of the source genotype.     */
+    int n_kept;                 /* Representatives.                    */
+    int n_duplicate;            /* Markers collapsed as duplicates.    */
+    int n_clumped;              /* Markers clumped by LD.              */
+
+    int* kept;                  /* Source marker of each representative. */
+    int* group;                 /* Representative of each source marker. */
+    float* r2;                  /* r^2 of each source marker with it.  */
+
+    float* matrix;              /* n_individual x n_kept, col major.   */
+    int ld;
+    int n_individual;
+    name_table* marker;         /* Names of the representatives.       */
+    marker_stats* st;           /* Statistics of the representatives.  */
+} collapse;
+
+
+
+/*
+ * collapse_create
+ *   DESCRIPTION: Collapses the duplicate markers of a genotype and, with
+ *                a threshold, clumps markers in LD.
+ *   INPUTS: g         -- genotype.
+ *           st        -- statistics of g.
+ *           threshold -- r^2 at which markers are clumped, 0 for none.
+ *           window    -- following representatives compared with each.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated collapse, NULL on failure.
+ *   SIDE EFFECTS: Allocates a collapse; writes to stderr.
+ */
+collapse* collapse_create(genotype* g, const marker_stats* st, double threshold, int window);
+
+/*
+ * collapse_write
+ *   DESCRIPTION: Writes one line per source marker: its name, the name of
+ *                its representative and their r^2.
+ *   INPUTS: c        -- pointer to collapse.
+ *           fileName -- name of output file.
+ *           marker   -- names of the source markers.
+ *   OUTPUTS: fileName
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to fileName.
+ */
+int collapse_write(const collapse* c, char* fileName, const name_table* marker);
+
+/*
+ * free_collapse
+ *   DESCRIPTION: Deallocates memory associated with a collapse.
+ *   INPUTS: c -- pointer to collapse.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a collapse.
+ */
+void free_collapse(collapse* c);
+
+#endif
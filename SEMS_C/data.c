@@ -2,147 +2,760 @@
 
 #include "data.h"
 
+/*
+ * matrix_alloc
+ *   DESCRIPTION: Allocates one column major matrix whose columns start on
+ *                64-byte boundaries. The padding rows are zeroed.
+ *   INPUTS: n_row -- number of rows.
+ *           n_col -- number of columns.
+ *           ld    -- leading dimension (n_row rounded up to 16).
+ *   OUTPUTS: ld
+ *   RETURN VALUE: Pointer to the matrix, NULL on failure. Release with free.
+ *   SIDE EFFECTS: Allocates memory.
+ */
+float* matrix_alloc(int n_row, int n_col, int* ld){
+    
+    void* m = NULL;             /* Return argument. */
+    size_t size = 0;
+    int l = (n_row + 15) & ~15;
+    
+    size = (size_t)l * (n_col > 0 ? n_col : 1) * sizeof(float);
+    if(posix_memalign(&m, MATRIX_ALIGN, size) != 0)
+        return NULL;
+    memset(m, 0, size);
+    
+    *ld = l;
+    return (float*)m;
+}
+
+/*
+ * text_header
+ *   DESCRIPTION: Finds the header of a text table: the first "<Tag>" line
+ *                that lists names (lines holding only a "<...>" tag are
+ *                skipped).
+ *   INPUTS: data     -- start of the text.
+ *           size     -- bytes of text.
+ *           fileName -- name of file, for error messages.
+ *           header   -- first name on the header line.
+ *           body     -- first data line.
+ *           n_col    -- number of names on the header line.
+ *   OUTPUTS: header, body, n_col
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: None.
+ */
+int text_header(const char* data, size_t size, char* fileName,
+                const char** header, const char** body, int* n_col){
+
+    const char* p = data;           /* Scan pointers.             */
+    const char* end = data + size;
+    const char* t = NULL;
+    const char* q = NULL;
+    int nc = 0;
+
+    *header = NULL;
+    while(p < end){
+        t = skip_blank(p, end);
+        if(t < end && *t == '<'){
+            q = skip_blank(skip_token(t, end), end);
+            if(q < end && !is_eol(*q)){
+                *header = q;
+                break;
+            }
+        }
+        else if(t < end && !is_eol(*t))
+            break;
+        p = next_line(p, end);
+    }
+
+    if(*header == NULL){
+        fprintf(stderr, "file \"%s\": missing \"<...>\" header line\n", fileName);
+        return 1;
+    }
+
+    /* Column count from the header. */
+    for(q = *header; q < end && !is_eol(*q); q = skip_blank(q, end)){
+        q = skip_token(q, end);
+        nc++;
+    }
+
+    *body = next_line(*header, end);
+    *n_col = nc;
+
+    return 0;
+}
+
+/*
+ * data_header_check
+ *   DESCRIPTION: Validates a binary cache header against the file size.
+ *   INPUTS: h         -- file header.
+ *           file_size -- size of the file in bytes.
+ *           fileName  -- name of file, for error messages.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) if the header is usable, (1) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+int data_header_check(const data_header* h, uint64_t file_size, char* fileName){
+
+    if(h->version != DATA_VERSION){
+        fprintf(stderr, "file \"%s\": unsupported binary version %u\n", fileName, (unsigned)h->version);
+        return 1;
+    }
+    /*
+     * Sizes are compared by subtraction and division so that a damaged
+     * header cannot wrap around uint64 and pass. The names count as one
+     * int, and their offsets are read in place as uint64_t.
+     */
+    if(h->encoding > DATA_ENCODING_DOSAGE || h->n_col == 0 || h->n_row == 0 ||
+       h->n_col > INT32_MAX || h->ld > INT32_MAX || h->ld < h->n_row || h->ld % 16 != 0 ||
+       h->n_col + h->n_row > INT32_MAX ||
+       h->names_offset % sizeof(uint64_t) != 0 ||
+       h->names_offset > file_size || h->names_size > file_size - h->names_offset ||
+       h->names_size / sizeof(uint64_t) < h->n_col + h->n_row ||
+       h->matrix_offset % MATRIX_ALIGN != 0 || h->matrix_offset > file_size ||
+       h->matrix_size > file_size - h->matrix_offset ||
+       data_column_size(h) > file_size / h->n_col || h->matrix_size != h->n_col * data_column_size(h)){
+        fprintf(stderr, "file \"%s\": corrupt binary header\n", fileName);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * data_names_wrap
+ *   DESCRIPTION: Validates the name table block of a binary cache and
+ *                creates column and row name tables over it.
+ *   INPUTS: h        -- file header.
+ *           names    -- the names block (h->names_size bytes).
+ *           fileName -- name of file, for error messages.
+ *           col      -- column names.
+ *           row      -- row names.
+ *   OUTPUTS: col, row
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates two name tables borrowing names.
+ */
+int data_names_wrap(const data_header* h, char* names, char* fileName,
+                    name_table** col, name_table** row){
+
+    uint64_t* offset = (uint64_t*)names;    /* Name offsets.  */
+    int n_name = (int)(h->n_col + h->n_row);
+    int i = 0;                              /* Loop variable. */
+
+    for(i = 0; i < n_name; i++){
+        if(offset[i] >= h->names_size || memchr(names + offset[i], '\0', (size_t)(h->names_size - offset[i])) == NULL){
+            fprintf(stderr, "file \"%s\": corrupt name table\n", fileName);
+            return 1;
+        }
+    }
+
+    *row = NULL;
+    if((*col = name_table_wrap(names, offset, (int)h->n_col)) == NULL ||
+       (*row = name_table_wrap(names, offset + h->n_col, (int)h->n_row)) == NULL){
+        free_name_table(*col);
+        *col = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * data_decode_dosage
+ *   DESCRIPTION: Expands one column of 2-bit dosage codes to floats.
+ *   INPUTS: code  -- packed codes, four individuals per byte.
+ *           n_row -- number of individuals.
+ *           out   -- n_row floats.
+ *   OUTPUTS: out
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void data_decode_dosage(const unsigned char* code, int n_row, float* out){
+    int i = 0;                  /* Loop variable. */
+    int k = 0;
+
+    for(i = 0; i < n_row; i++){
+        k = (code[i >> 2] >> (2 * (i & 3))) & 3;
+        out[i] = (k == 3) ? NAN : (float)k;
+    }
+}
+
+/*
+ * in_map
+ *   DESCRIPTION: Checks whether p points into a mapped binary file, in
+ *                which case it must not be passed to free.
+ */
+static int in_map(mapped_file* map, const void* p){
+    return map != NULL && (const char*)p >= map->data && (const char*)p < map->data + map->size;
+}
+
+/*
+ * One line-aligned piece of the data section of a text table, parsed by
+ * one thread into rows [first_row, first_row + n_row) of the matrix.
+ */
+typedef struct {
+    const char* begin;          /* First byte of the chunk (line start). */
+    const char* end;            /* One past the last byte.               */
+    char* fileName;             /* For error messages.                   */
+    int n_col;                  /* Values per row.                       */
+    int first_row;              /* Prefix count of rows before chunk.    */
+    int n_row;                  /* Rows in chunk.                        */
+    const char** row;           /* Shared outputs: start of each name.   */
+    float* matrix;
+    int ld;
+    int status;                 /* (0) on success, (1) on failure.       */
+} table_chunk;
+
+/*
+ * chunk_count
+ *   DESCRIPTION: Thread body counting the non-blank lines of a chunk.
+ *   INPUTS: arg -- pointer to table_chunk.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: NULL.
+ *   SIDE EFFECTS: Writes the chunk's n_row.
+ */
+static void* chunk_count(void* arg){
+
+    table_chunk* ch = (table_chunk*)arg;
+    const char* q = NULL;
+    const char* t = NULL;
+
+    ch->n_row = 0;
+    for(q = ch->begin; q < ch->end; q = next_line(q, ch->end)){
+        t = skip_blank(q, ch->end);
+        if(t < ch->end && !is_eol(*t))
+            ch->n_row++;
+    }
+    return NULL;
+}
+
+/*
+ * chunk_parse
+ *   DESCRIPTION: Thread body parsing the rows of a chunk: a name, whose
+ *                position is recorded, followed by n_col values, stored
+ *                column major.
+ *   INPUTS: arg -- pointer to table_chunk.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: NULL.
+ *   SIDE EFFECTS: Fills the chunk's rows of row and matrix, sets status.
+ */
+static void* chunk_parse(void* arg){
+
+    table_chunk* ch = (table_chunk*)arg;
+    const char* end = ch->end;
+    const char* q = NULL;
+    const char* t = NULL;
+    float* m = NULL;
+    int i = 0;                  /* Loop variables. */
+    int j = 0;
+
+    ch->status = 0;
+    for(i = ch->first_row, q = ch->begin; q < end; q = next_line(q, end)){
+        q = skip_blank(q, end);
+        if(q >= end || is_eol(*q))
+            continue;
+
+        ch->row[i] = q;
+        t = skip_token(q, end);
+
+        for(j = 0, m = ch->matrix + i; j < ch->n_col; j++, m += ch->ld){
+            q = skip_blank(t, end);
+            if(q >= end || is_eol(*q)){
+                fprintf(stderr, "file \"%s\": row %d has %d of %d values\n", ch->fileName, i + 1, j, ch->n_col);
+                ch->status = 1;
+                return NULL;
+            }
+            if((t = parse_float(q, end, m)) == NULL){
+                fprintf(stderr, "file \"%s\": row %d, column %d is not a number\n", ch->fileName, i + 1, j + 1);
+                ch->status = 1;
+                return NULL;
+            }
+        }
+        i++;
+    }
+    return NULL;
+}
+
+/*
+ * run_chunks
+ *   DESCRIPTION: Runs body on every chunk, one thread per chunk (the first
+ *                chunk on the calling thread).
+ *   INPUTS: ch       -- chunk array.
+ *           n_chunk  -- number of chunks.
+ *           body     -- thread body.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) if a thread could not be started.
+ *   SIDE EFFECTS: Whatever body does.
+ */
+static int run_chunks(table_chunk* ch, int n_chunk, void* (*body)(void*)){
+
+    pthread_t* tid = NULL;      /* Worker threads.     */
+    int started = 1;            /* Threads to join.    */
+    int k = 0;                  /* Loop variable.      */
+
+    if(n_chunk > 1 && (tid = (pthread_t*)malloc(n_chunk * sizeof(pthread_t))) == NULL){
+        fprintf(stderr, "cannot allocate memory: threads\n");
+        return 1;
+    }
+    for(k = 1; k < n_chunk; k++, started++){
+        if(pthread_create(&tid[k], NULL, body, &ch[k]) != 0){
+            fprintf(stderr, "cannot start parser thread\n");
+            break;
+        }
+    }
+    body(&ch[0]);
+    for(k = 1; k < started; k++)
+        pthread_join(tid[k], NULL);
+    free(tid);
+
+    return (started == n_chunk) ? 0 : 1;
+}
+
+/*
+ * table_load
+ *   DESCRIPTION: Parses a mapped text table. The table is a header line
+ *                "<Tag> name1 name2 ..." (lines that only hold a "<...>"
+ *                tag are skipped) followed by one line per individual:
+ *                "id value1 value2 ...". The data section is split into
+ *                n_threads line-aligned chunks; a first parallel pass
+ *                counts rows per chunk, a prefix sum turns the counts
+ *                into row offsets, and a second parallel pass parses each
+ *                chunk into its own rows of the column major matrix.
+ *   INPUTS: mf        -- mapped file.
+ *           fileName  -- name of file, for error messages.
+ *           n_threads -- number of parser threads.
+ *           n_col     -- number of value columns.
+ *           n_row     -- number of individuals.
+ *           col       -- column (marker or trait) names.
+ *           row       -- individual names.
+ *           matrix    -- column major values (see matrix_alloc).
+ *           ld        -- leading dimension of matrix.
+ *   OUTPUTS: n_col, n_row, col, row, matrix, ld
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates col, row and matrix. On failure everything
+ *                 allocated so far is released.
+ */
+static int table_load(mapped_file* mf, char* fileName, int n_threads, int* n_col, int* n_row,
+                      name_table** col, name_table** row, float** matrix, int* ld){
+
+    const char* end = mf->data + mf->size;  /* Scan pointers.        */
+    const char* header = NULL;      /* Start of header name list.    */
+    const char* t = NULL;
+    const char* q = NULL;
+    const char* data = NULL;        /* Start of first data line.     */
+    table_chunk* ch = NULL;         /* Parser chunks.                */
+    const char** start = NULL;      /* Individual name positions.    */
+    name_table* c = NULL;           /* Local results.                */
+    name_table* r = NULL;
+    float* m = NULL;
+    int nc = 0;
+    int nr = 0;
+    int lm = 0;
+    int n_chunk = 0;
+    int i = 0;                      /* Loop variables.               */
+    int j = 0;
+
+    if(text_header(mf->data, mf->size, fileName, &header, &data, &nc) != 0)
+        return 1;
+
+    /* Line-aligned chunks, no smaller than 64 KB each. */
+    n_chunk = (n_threads > 1) ? n_threads : 1;
+    while(n_chunk > 1 && (size_t)(end - data) / n_chunk < (1 << 16))
+        n_chunk--;
+    if((ch = (table_chunk*)calloc(n_chunk, sizeof(table_chunk))) == NULL){
+        fprintf(stderr, "cannot allocate memory: table chunks\n");
+        return 1;
+    }
+    for(i = 0, q = data; i < n_chunk; i++){
+        ch[i].begin = q;
+        q = (i == n_chunk - 1) ? end : data + (size_t)(end - data) / n_chunk * (i + 1);
+        if(q > ch[i].begin && q < end && !is_eol(q[-1]))
+            q = next_line(q, end);
+        if(q < ch[i].begin)
+            q = ch[i].begin;
+        ch[i].end = q;
+        ch[i].fileName = fileName;
+        ch[i].n_col = nc;
+    }
+
+    /* Rows per chunk, then prefix counts as row offsets. */
+    if(run_chunks(ch, n_chunk, chunk_count) != 0){
+        free(ch);
+        return 1;
+    }
+    for(i = 0; i < n_chunk; i++){
+        ch[i].first_row = nr;
+        nr += ch[i].n_row;
+    }
+
+    if(nc == 0 || nr == 0){
+        fprintf(stderr, "file \"%s\": no data\n", fileName);
+        free(ch);
+        return 1;
+    }
+
+    /* Memory allocation. */
+    if((c = name_table_create(nc, (size_t)(data - header))) == NULL ||
+       (r = name_table_create(nr, 16 * (size_t)nr)) == NULL ||
+       (start = (const char**)malloc(nr * sizeof(const char*))) == NULL ||
+       (m = matrix_alloc(nr, nc, &lm)) == NULL){
+        fprintf(stderr, "cannot allocate memory: table\n");
+        goto fail;
+    }
+
+    /* Column names. */
+    for(j = 0, q = header; j < nc; j++){
+        t = skip_token(q, end);
+        if(name_table_add(c, q, (size_t)(t - q)) < 0)
+            goto fail;
+        q = skip_blank(t, end);
+    }
+
+    /* Rows: name followed by nc values (column major order). */
+    for(i = 0; i < n_chunk; i++){
+        ch[i].row = start;
+        ch[i].matrix = m;
+        ch[i].ld = lm;
+    }
+    if(run_chunks(ch, n_chunk, chunk_parse) != 0)
+        goto fail;
+    for(i = 0; i < n_chunk; i++){
+        if(ch[i].status != 0)
+            goto fail;
+    }
+
+    /* Individual names, interned in row order. */
+    for(i = 0; i < nr; i++){
+        if(name_table_add(r, start[i], (size_t)(skip_token(start[i], end) - start[i])) < 0)
+            goto fail;
+    }
+    for(i = 0, j = 0; i < nr; i++)
+        j += (name_table_find(r, name_table_get(r, i), strlen(name_table_get(r, i))) != i);
+    if(j > 0)
+        fprintf(stderr, "file \"%s\": %d duplicate individual names, the first of each is used\n", fileName, j);
+
+    *n_col = nc;
+    *n_row = nr;
+    *col = c;
+    *row = r;
+    *matrix = m;
+    *ld = lm;
+
+    free(start);
+    free(ch);
+    return 0;
+
+fail:
+    free_name_table(c);
+    free_name_table(r);
+    free(start);
+    free(m);
+    free(ch);
+    return 1;
+}
+
+/*
+ * round_up
+ *   DESCRIPTION: Rounds n up to a multiple of align (a power of two).
+ */
+static uint64_t round_up(uint64_t n, uint64_t align){
+    return (n + align - 1) & ~(align - 1);
+}
+
+/*
+ * write_padding
+ *   DESCRIPTION: Writes zero bytes until the file position reaches offset.
+ *   INPUTS: f      -- open file.
+ *           pos    -- current file position.
+ *           offset -- target file position.
+ *   OUTPUTS: f
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f.
+ */
+static int write_padding(FILE* f, uint64_t pos, uint64_t offset){
+    static const char zero[64] = {0};
+    uint64_t n = 0;
+
+    while(pos < offset){
+        n = (offset - pos < sizeof(zero)) ? offset - pos : sizeof(zero);
+        if(fwrite(zero, 1, (size_t)n, f) != (size_t)n)
+            return 1;
+        pos += n;
+    }
+    return 0;
+}
+
+/*
+ * is_dosage
+ *   DESCRIPTION: Checks whether every value is a 0/1/2 dosage or missing,
+ *                so the matrix can be stored as 2-bit codes.
+ *   INPUTS: matrix -- column major values.
+ *           ld     -- leading dimension of matrix.
+ *           n_col  -- number of columns.
+ *           n_row  -- number of rows.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if all values are dosages, (0) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+static int is_dosage(float* matrix, int ld, int n_col, int n_row){
+    int i, j;                   /* Loop variables. */
+    float v;
+
+    for(j = 0; j < n_col; j++){
+        for(i = 0; i < n_row; i++){
+            v = matrix[(size_t)j * ld + i];
+            if(!(v == 0.0f || v == 1.0f || v == 2.0f || isnan(v)))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * table_store
+ *   DESCRIPTION: Writes a table in the binary cache format (see data.h).
+ *   INPUTS: fileName -- name of binary file to be written to.
+ *           magic    -- GENOTYPE_MAGIC or PHENOTYPE_MAGIC.
+ *           dosage   -- allow the 2-bit dosage encoding.
+ *           n_col    -- number of value columns.
+ *           n_row    -- number of individuals.
+ *           col      -- column names.
+ *           row      -- individual names.
+ *           matrix   -- column major values.
+ *           ld       -- leading dimension of matrix.
+ *   OUTPUTS: fileName
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to fileName.
+ */
+static int table_store(char* fileName, const char* magic, int dosage, int n_col, int n_row,
+                       name_table* col, name_table* row, float* matrix, int ld){
+
+    FILE* f = NULL;             /* File variable.          */
+    data_header h;              /* File header.            */
+    uint64_t* offset = NULL;    /* Name table offsets.     */
+    uint64_t pos = 0;           /* Current file position.  */
+    unsigned char* code = NULL; /* One encoded column.     */
+    float* column = NULL;
+    const char* name = NULL;
+    size_t len = 0;
+    int n_name = n_col + n_row;
+    int i, j;                   /* Loop variables.         */
+    float v;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, magic, strlen(magic) + 1);
+    h.version = DATA_VERSION;
+    h.encoding = (dosage && is_dosage(matrix, ld, n_col, n_row)) ? DATA_ENCODING_DOSAGE : DATA_ENCODING_FLOAT;
+    h.n_col = (uint64_t)n_col;
+    h.n_row = (uint64_t)n_row;
+    h.ld = round_up((uint64_t)n_row, 16);
+
+    /* Name table layout. */
+    if((offset = (uint64_t*)malloc(n_name * sizeof(uint64_t))) == NULL){
+        fprintf(stderr, "cannot allocate memory: name offsets\n");
+        return 1;
+    }
+    pos = n_name * sizeof(uint64_t);
+    for(i = 0; i < n_name; i++){
+        offset[i] = pos;
+        pos += strlen(i < n_col ? name_table_get(col, i) : name_table_get(row, i - n_col)) + 1;
+    }
+    h.names_offset = round_up(sizeof(data_header), 64);
+    h.names_size = pos;
+    h.matrix_offset = round_up(h.names_offset + h.names_size, 4096);
+    h.matrix_size = (uint64_t)n_col * ((h.encoding == DATA_ENCODING_FLOAT) ? h.ld * sizeof(float) : h.ld / 4);
+
+    if((code = (unsigned char*)calloc(h.ld * sizeof(float), 1)) == NULL){
+        fprintf(stderr, "cannot allocate memory: column buffer\n");
+        free(offset);
+        return 1;
+    }
+    column = (float*)code;
+
+    if((f = fopen(fileName, "wb")) == NULL){
+        fprintf(stderr, "cannot open file \"%s\" for writing\n", fileName);
+        free(offset);
+        free(code);
+        return 1;
+    }
+
+    /* Header and name table. */
+    if(fwrite(&h, sizeof(h), 1, f) != 1 ||
+       write_padding(f, sizeof(h), h.names_offset) != 0 ||
+       fwrite(offset, sizeof(uint64_t), n_name, f) != (size_t)n_name)
+        goto fail;
+    for(i = 0; i < n_name; i++){
+        name = (i < n_col) ? name_table_get(col, i) : name_table_get(row, i - n_col);
+        len = strlen(name) + 1;
+        if(fwrite(name, 1, len, f) != len)
+            goto fail;
+    }
+    if(write_padding(f, h.names_offset + h.names_size, h.matrix_offset) != 0)
+        goto fail;
+
+    /* Matrix, one padded column at a time. */
+    for(j = 0; j < n_col; j++){
+        if(h.encoding == DATA_ENCODING_FLOAT){
+            memcpy(column, matrix + (size_t)j * ld, n_row * sizeof(float));
+            len = h.ld * sizeof(float);
+        }
+        else{
+            memset(code, 0, h.ld / 4);
+            for(i = 0; i < n_row; i++){
+                v = matrix[(size_t)j * ld + i];
+                code[i >> 2] |= (unsigned char)((isnan(v) ? 3 : (int)v) << (2 * (i & 3)));
+            }
+            len = h.ld / 4;
+        }
+        if(fwrite(code, 1, len, f) != len)
+            goto fail;
+    }
+
+    free(offset);
+    free(code);
+    if(fclose(f) != 0){
+        fprintf(stderr, "cannot write file \"%s\"\n", fileName);
+        return 1;
+    }
+    return 0;
+
+fail:
+    fprintf(stderr, "cannot write file \"%s\"\n", fileName);
+    free(offset);
+    free(code);
+    fclose(f);
+    return 1;
+}
+
+/*
+ * is_binary
+ *   DESCRIPTION: Checks a mapped file for a binary cache magic number.
+ *   INPUTS: mf    -- mapped file.
+ *           magic -- GENOTYPE_MAGIC or PHENOTYPE_MAGIC.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if the file starts with magic, (0) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+static int is_binary(mapped_file* mf, const char* magic){
+    return mf->size >= sizeof(data_header) && memcmp(mf->data, magic, strlen(magic) + 1) == 0;
+}
+
+/*
+ * table_map
+ *   DESCRIPTION: Attaches a table to a binary cache file. Float matrices
+ *                and all names point straight into the mapping; 2-bit
+ *                dosage matrices are decoded into an owned matrix.
+ *   INPUTS: mf       -- mapped binary file (see is_binary).
+ *           fileName -- name of file, for error messages.
+ *           n_col    -- number of value columns.
+ *           n_row    -- number of individuals.
+ *           col      -- column names.
+ *           row      -- individual names.
+ *           matrix   -- column major values.
+ *           ld       -- leading dimension of matrix.
+ *   OUTPUTS: n_col, n_row, col, row, matrix, ld
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates the col and row pointer arrays, and the
+ *                 matrix for dosage files.
+ */
+static int table_map(mapped_file* mf, char* fileName, int* n_col, int* n_row,
+                     name_table** col, name_table** row, float** matrix, int* ld){
+
+    data_header h;                  /* File header.          */
+    const unsigned char* code = NULL;
+    name_table* c = NULL;           /* Local results.        */
+    name_table* r = NULL;
+    float* m = NULL;
+    int lm = 0;
+    uint64_t column_size = 0;
+    int j;                          /* Loop variable.        */
+
+    memcpy(&h, mf->data, sizeof(h));
+    if(data_header_check(&h, mf->size, fileName) != 0)
+        return 1;
+    column_size = data_column_size(&h);
+
+    /* Name tables over the mapped names. */
+    if(data_names_wrap(&h, mf->data + h.names_offset, fileName, &c, &r) != 0)
+        return 1;
+
+    /* Matrix: zero copy for floats, decoded for dosages. */
+    if(h.encoding == DATA_ENCODING_FLOAT){
+        m = (float*)(mf->data + h.matrix_offset);
+        lm = (int)h.ld;
+    }
+    else{
+        if((m = matrix_alloc((int)h.n_row, (int)h.n_col, &lm)) == NULL){
+            fprintf(stderr, "cannot allocate memory: table\n");
+            free_name_table(c);
+            free_name_table(r);
+            return 1;
+        }
+        for(j = 0; j < (int)h.n_col; j++){
+            code = (const unsigned char*)mf->data + h.matrix_offset + j * column_size;
+            data_decode_dosage(code, (int)h.n_row, m + (size_t)j * lm);
+        }
+    }
+
+    *n_col = (int)h.n_col;
+    *n_row = (int)h.n_row;
+    *col = c;
+    *row = r;
+    *matrix = m;
+    *ld = lm;
+
+    return 0;
+}
+
 /*
  * genotype_load
  *   DESCRIPTION: Creates and fills a genotype struct by 
- *                passing in a text file of a specific format.
- *   INPUTS: fileName -- name of text file to be read.
+ *                passing in a text file of a specific format, or a
+ *                binary cache written by genotype_store (detected by
+ *                its magic number and mapped without copying).
+ *   INPUTS: fileName  -- name of text or binary file to be read.
+ *           n_threads -- number of threads parsing a text file.
  *   OUTPUTS: None.
  *   RETURN VALUE: Pointer to newly allocated genotype struct.
  *   SIDE EFFECTS: Allocates a genotype struct.
  */
-genotype* genotype_load(char* fileName){
+genotype* genotype_load(char* fileName, int n_threads){
 
-    FILE* f = NULL;             /* File variable.         */
+    mapped_file* mf = NULL;     /* Mapped input file.     */
     genotype* g_t = NULL;       /* Return argument.       */
-    char s[32];                 /* Temp variables.        */
-    float d = 0.0;          
-    int i = 0;                  /* Loop variables.        */
-    int j = 0;
-    
-    int n_marker = -2;          /* Initial marker offset. */
-    int n_individual = 1;            /* Initial individual offset.  */
-    
+    double start = wall_time(); /* Load timer.            */
     
-    
-    /* Open file error handling. */
-    if((f = fopen(fileName, "r")) == NULL){
-        fprintf(stderr, "file \"%s\" does not exist\n", fileName);
+    /* Map file. */
+    if((mf = map_file(fileName)) == NULL)
         return NULL;
-    }
-    
-    
-    
-    /* Intial counting to determine n_marker nad n_individual. */
-    /* Skip first two entries. */
-    fscanf(f, "%*s %*s");
-    
-    do{
-        n_marker++;
-        fscanf(f, "%s", s);
-    }while(!isdigit(s[0]));
-    
-    while(fscanf(f, "%s", s) != EOF){
-        if(!isdigit(s[0]))
-            n_individual++;
-    }
-    
-    fprintf(stderr, "Markers: %d\nIndividuals: %d\n", n_marker, n_individual);
     
     /* Struct memory allocation. */
-    if((g_t = (genotype*)malloc(sizeof(genotype))) == NULL){
+    if((g_t = (genotype*)calloc(1, sizeof(genotype))) == NULL){
         fprintf(stderr, "cannot allocate memory: genotype*\n");
-        fclose(f);
-        free_genotype(g_t);
+        unmap_file(mf);
         return NULL;
     }
     
-    
-    
-    /* Marker memory allocation. */
-    if((g_t->marker = (char**)malloc(n_marker * sizeof(char*))) == NULL){
-        fprintf(stderr, "cannot allocate memory: g.marker**\n");
-        fclose(f);
-        free_genotype(g_t);
-        return NULL;
-    }
-    for(i = 0; i < n_marker; i++){
-        if((g_t->marker[i] = (char*)malloc(sizeof(char) * 32)) == NULL){
-            fprintf(stderr, "cannot allocate memory: g.marker*\n");
-            fclose(f);
-            free_genotype(g_t);
-            return NULL;
-        }
-    }
-    
-    
-    
-    /* individual memory allocation. */
-    if((g_t->individual = (char**)malloc(n_individual * sizeof(char*))) == NULL){
-        fprintf(stderr, "cannot allocate memory: g.individual**\n");
-        fclose(f);
-        free_genotype(g_t);
-        return NULL;
-    }
-    for(i = 0; i < n_individual; i++){
-        if((g_t->individual[i] = (char*)malloc(sizeof(char) * 32)) == NULL){
-            fprintf(stderr, "cannot allocate memory: g.individual*\n");
-            fclose(f);
+    /* Binary cache: keep the mapping, names and matrix point into it. */
+    if(is_binary(mf, GENOTYPE_MAGIC)){
+        g_t->map = mf;
+        if(table_map(mf, fileName, &g_t->n_marker, &g_t->n_individual,
+                     &g_t->marker, &g_t->individual, &g_t->matrix, &g_t->ld) != 0){
             free_genotype(g_t);
             return NULL;
         }
     }
     
-    
-    
-    /* 2-D matrix memory allocation. */
-    if((g_t->matrix = (float**)malloc(n_marker * sizeof(float*))) == NULL){
-        fprintf(stderr, "cannot allocate memory: g.matrix**\n");
-        fclose(f);
-        free_genotype(g_t);
-        return NULL;
-    }
-    for(i = 0; i < n_marker; i++){
-        if((g_t->matrix[i] = (float*)malloc(n_individual * sizeof(float))) == NULL){
-            fprintf(stderr, "cannot allocate memory: g.matrix*\n");
-            fclose(f);
+    /* Text: marker names, individual names and matrix (column major order). */
+    else{
+        if(table_load(mf, fileName, n_threads, &g_t->n_marker, &g_t->n_individual,
+                      &g_t->marker, &g_t->individual, &g_t->matrix, &g_t->ld) != 0){
+            unmap_file(mf);
             free_genotype(g_t);
             return NULL;
         }
+        unmap_file(mf);
     }
     
-    
-    
-    /* Rewind file. */
-    if(fseek(f, 0, SEEK_SET) != 0)
-        fprintf(stderr, "could not rewind file");
-    
-    /* Skip first two entries. */
-    fscanf(f, "%*s %*s");
-    
-    /* Marker assignment. */
-    for(i = 0; i < n_marker; i++){
-        fscanf(f, "%s", s);
-        strcpy(g_t->marker[i], s);
-    }
-    
-    /* individual and matrix assignment (column major order). */
-    for(i = 0; i < n_individual; i++){
-        fscanf(f, "%s", s);
-        strcpy(g_t->individual[i], s);
-        
-        for(j = 0; j < n_marker; j++){
-            fscanf(f, "%f", &d);
-            g_t->matrix[j][i] = d;
-        }
-    }
-    
-    /* Other assignments. */
-    g_t->n_marker = n_marker;
-    g_t->n_individual = n_individual;
-    
-    /* Close file. */
-    fclose(f);
+    fprintf(stderr, "Markers: %d\nIndividuals: %d\nLoad time: %.3f s\n",
+            g_t->n_marker, g_t->n_individual, wall_time() - start);
     
     /* Return. */
     return g_t;
@@ -151,18 +764,28 @@ genotype* genotype_load(char* fileName){
 /*
  * genotype_store
  *   DESCRIPTION: Stores the genotype struct data into a
- *                text file in a specific format.
- *   INPUTS: fileName -- name of text file to be written to.
+ *                binary cache file in the format described in data.h.
+ *   INPUTS: fileName -- name of binary file to be written to.
  *           g_t -- pointer to genotype struct.
  *   OUTPUTS: Writes to fileName.
  *   RETURN VALUE: (0) on success, (1) on failure.
  *   SIDE EFFECTS: None.
  */
-/*
 int genotype_store(char* fileName, genotype* g_t){
-    return 1;
+    
+    double start = wall_time(); /* Store timer. */
+    
+    if(g_t == NULL)
+        return 1;
+    
+    if(table_store(fileName, GENOTYPE_MAGIC, 1, g_t->n_marker, g_t->n_individual,
+                   g_t->marker, g_t->individual, g_t->matrix, g_t->ld) != 0)
+        return 1;
+    
+    fprintf(stderr, "Stored \"%s\" in %.3f s\n", fileName, wall_time() - start);
+    
+    return 0;
 }
-*/
 
 /*
  * free_genotype
@@ -173,29 +796,13 @@ int genotype_store(char* fileName, genotype* g_t){
  *   SIDE EFFECTS: Deallocates a genotype struct.
  */
 void free_genotype(genotype* g_t){
-    int i = 0;                  /* Loop variable. */
-    
     if(g_t != NULL){
-        /* Outer free. */
-        if(g_t->marker != NULL){
-            /* Inner free. */
-            for(i = 0; i < g_t->n_marker; i++){
-                free(g_t->marker[i]);
-                g_t->marker[i] = NULL;
-            }
-        }
-        if(g_t->individual != NULL){
-            for(i = 0; i < g_t->n_individual; i++){
-                free(g_t->individual[i]);
-                g_t->individual[i] = NULL;
-            }
-        }
-        if(g_t->matrix != NULL){
-            for(i = 0; i < g_t->n_marker; i++){
-                free(g_t->matrix[i]);
-                g_t->matrix[i] = NULL;
-            }
-        }
+        free_name_table(g_t->marker);
+        free_name_table(g_t->individual);
+        if(!in_map(g_t->map, g_t->matrix))
+            free(g_t->matrix);
+        g_t->matrix = NULL;
+        unmap_file(g_t->map);
         free(g_t);
         g_t = NULL;
     }
@@ -206,142 +813,55 @@ void free_genotype(genotype* g_t){
 /*
  * phenotype_load
  *   DESCRIPTION: Creates and fills a phenotype struct by 
- *                passing in a text file of a specific format.
- *   INPUTS: fileName -- name of text file to be read.
+ *                passing in a text file of a specific format, or a
+ *                binary cache written by phenotype_store (detected by
+ *                its magic number and mapped without copying).
+ *   INPUTS: fileName  -- name of text or binary file to be read.
+ *           n_threads -- number of threads parsing a text file.
  *   OUTPUTS: None.
  *   RETURN VALUE: Pointer to newly allocated phenotype struct.
  *   SIDE EFFECTS: Allocates a phenotype struct.
  */
-phenotype* phenotype_load(char* fileName){
+phenotype* phenotype_load(char* fileName, int n_threads){
 
-    FILE* f = NULL;             /* File variable.         */
+    mapped_file* mf = NULL;     /* Mapped input file.     */
     phenotype* p_t = NULL;      /* Return argument.       */
-    char s[32];                 /* Temp variables.        */
-    float d = 0.0;
-    int i = 0;                  /* Loop variables.        */
-    int j = 0;
-    
-    int n_trait = -2;           /* Initial trait offset.  */
-    int n_individual = 1;            /* Initial individual offset.  */
-    
-    
+    double start = wall_time(); /* Load timer.            */
     
-    /* Open file error handling. */
-    if((f = fopen(fileName, "r")) == NULL){
-        fprintf(stderr, "file \"%s\" does not exist\n", fileName);
+    /* Map file. */
+    if((mf = map_file(fileName)) == NULL)
         return NULL;
-    }
-    
-    
-    
-    /* Intial counting to determine n_trait nad n_individual. */
-    /* Skip first entry. */
-    fscanf(f, "%*s");
-    
-    do{
-        n_trait++;
-        fscanf(f, "%s", s);
-    }while((!isdigit(s[0])) && (s[0] != '-'));
-    
-    while(fscanf(f, "%s", s) != EOF){
-        if((!isdigit(s[0])) && (s[0] != '-'))
-            n_individual++;
-    }
-    
-    fprintf(stderr, "Traits: %d\nIndividuals: %d\n", n_trait, n_individual);
     
     /* Struct memory allocation. */
-    if((p_t = (phenotype*)malloc(sizeof(phenotype))) == NULL){
+    if((p_t = (phenotype*)calloc(1, sizeof(phenotype))) == NULL){
         fprintf(stderr, "cannot allocate memory: phenotype*\n");
-        fclose(f);
-        free_phenotype(p_t);
+        unmap_file(mf);
         return NULL;
     }
     
-    
-    
-    /* trait memory allocation. */
-    if((p_t->trait = (char**)malloc(n_trait * sizeof(char*))) == NULL){
-        fprintf(stderr, "cannot allocate memory: p.trait**\n");
-        fclose(f);
-        free_phenotype(p_t);
-        return NULL;
-    }
-    for(i = 0; i < n_trait; i++){
-        if((p_t->trait[i] = (char*)malloc(sizeof(char) * 32)) == NULL){
-            fprintf(stderr, "cannot allocate memory: p.trait*\n");
-            fclose(f);
+    /* Binary cache: keep the mapping, names and matrix point into it. */
+    if(is_binary(mf, PHENOTYPE_MAGIC)){
+        p_t->map = mf;
+        if(table_map(mf, fileName, &p_t->n_trait, &p_t->n_individual,
+                     &p_t->trait, &p_t->individual, &p_t->matrix, &p_t->ld) != 0){
             free_phenotype(p_t);
             return NULL;
         }
     }
     
-    
-    /* individual memory allocation. */
-    if((p_t->individual = (char**)malloc(n_individual * sizeof(char*))) == NULL){
-        fprintf(stderr, "cannot allocate memory: p.individual**\n");
-        fclose(f);
-        free_phenotype(p_t);
-        return NULL;
-    }
-    for(i = 0; i < n_individual; i++){
-        if((p_t->individual[i] = (char*)malloc(sizeof(char) * 32)) == NULL){
-            fprintf(stderr, "cannot allocate memory: p.individual*\n");
-            fclose(f);
+    /* Text: trait names, individual names and matrix (column major order). */
+    else{
+        if(table_load(mf, fileName, n_threads, &p_t->n_trait, &p_t->n_individual,
+                      &p_t->trait, &p_t->individual, &p_t->matrix, &p_t->ld) != 0){
+            unmap_file(mf);
             free_phenotype(p_t);
             return NULL;
         }
+        unmap_file(mf);
     }
     
-    
-    /* 2-D matrix memory allocation. */
-    if((p_t->matrix = (float**)malloc(n_trait * sizeof(float*))) == NULL){
-        fprintf(stderr, "cannot allocate memory: p.matrix**\n");
-        fclose(f);
-        free_phenotype(p_t);
-        return NULL;
-    }
-    for(i = 0; i < n_trait; i++){
-        if((p_t->matrix[i] = (float*)malloc(n_individual * sizeof(float))) == NULL){
-            fprintf(stderr, "cannot allocate memory: p.matrix*\n");
-            fclose(f);
-            free_phenotype(p_t);
-            return NULL;
-        }
-    }
-    
-    
-    /* Rewind file. */
-    if(fseek(f, 0, SEEK_SET) != 0)
-        fprintf(stderr, "could not rewind file");
-    /* Skip first entry. */
-    fscanf(f, "%*s");
-    
-    
-    
-    /* Trait assignment. */
-    for(i = 0; i < n_trait; i++){
-        fscanf(f, "%s", s);
-        strcpy(p_t->trait[i], s);
-    }
-    
-    /* individual and matrix assignment (column major order). */
-    for(i = 0; i < n_individual; i++){
-        fscanf(f, "%s", s);
-        strcpy(p_t->individual[i], s);
-        
-        for(j = 0; j < n_trait; j++){
-            fscanf(f, "%f", &d);
-            p_t->matrix[j][i] = d;
-        }
-    }
-    
-    /* Other assignments. */
-    p_t->n_trait = n_trait;
-    p_t->n_individual = n_individual;
-    
-    /* Close file. */
-    fclose(f);
+    fprintf(stderr, "Traits: %d\nIndividuals: %d\nLoad time: %.3f s\n",
+            p_t->n_trait, p_t->n_individual, wall_time() - start);
     
     /* Return. */
     return p_t;
@@ -350,18 +870,105 @@ phenotype* phenotype_load(char* fileName){
 /*
  * phenotype_store
  *   DESCRIPTION: Stores the phenotype struct data into a
- *                text file in a specific format.
- *   INPUTS: fileName -- name of text file to be written to.
+ *                binary cache file in the format described in data.h.
+ *   INPUTS: fileName -- name of binary file to be written to.
  *           p_t -- pointer to phenotype struct.
  *   OUTPUTS: Writes to fileName.
  *   RETURN VALUE: (0) on success, (1) on failure.
  *   SIDE EFFECTS: None.
  */
-/*
 int phenotype_store(char* fileName, phenotype* p_t){
-    return 1;
+    
+    double start = wall_time(); /* Store timer. */
+    
+    if(p_t == NULL)
+        return 1;
+    
+    if(table_store(fileName, PHENOTYPE_MAGIC, 0, p_t->n_trait, p_t->n_individual,
+                   p_t->trait, p_t->individual, p_t->matrix, p_t->ld) != 0)
+        return 1;
+    
+    fprintf(stderr, "Stored \"%s\" in %.3f s\n", fileName, wall_time() - start);
+    
+    return 0;
+}
+
+/*
+ * phenotype_align
+ *   DESCRIPTION: Creates a phenotype struct whose rows follow a given
+ *                individual order, matching names through the hash index
+ *                in linear time. Individuals without a phenotype row get
+ *                NAN (missing) values.
+ *   INPUTS: p_t        -- pointer to phenotype struct.
+ *           individual -- target individual order (e.g. genotype's).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated phenotype struct.
+ *   SIDE EFFECTS: Allocates a phenotype struct.
+ */
+phenotype* phenotype_align(phenotype* p_t, name_table* individual){
+    
+    phenotype* a_t = NULL;      /* Return argument.         */
+    int* source = NULL;         /* Phenotype row of target. */
+    const char* name = NULL;
+    int n_missing = 0;
+    int i, j;                   /* Loop variables.          */
+    
+    if((a_t = (phenotype*)calloc(1, sizeof(phenotype))) == NULL ||
+       (source = (int*)malloc(individual->n_name * sizeof(int))) == NULL){
+        fprintf(stderr, "cannot allocate memory: aligned phenotype\n");
+        free(a_t);
+        return NULL;
+    }
+    
+    /* Row lookup. */
+    for(i = 0; i < individual->n_name; i++){
+        name = name_table_get(individual, i);
+        if((source[i] = name_table_find(p_t->individual, name, strlen(name))) < 0)
+            n_missing++;
+    }
+    
+    a_t->n_trait = p_t->n_trait;
+    a_t->n_individual = individual->n_name;
+    if((a_t->trait = name_table_create(p_t->n_trait, p_t->trait->size)) == NULL ||
+       (a_t->individual = name_table_create(individual->n_name, individual->size)) == NULL ||
+       (a_t->matrix = matrix_alloc(a_t->n_individual, a_t->n_trait, &a_t->ld)) == NULL){
+        fprintf(stderr, "cannot allocate memory: aligned phenotype\n");
+        free(source);
+        free_phenotype(a_t);
+        return NULL;
+    }
+    
+    /* Names. */
+    for(j = 0; j < p_t->n_trait; j++){
+        name = name_table_get(p_t->trait, j);
+        if(name_table_add(a_t->trait, name, strlen(name)) < 0){
+            free(source);
+            free_phenotype(a_t);
+            return NULL;
+        }
+    }
+    for(i = 0; i < individual->n_name; i++){
+        name = name_table_get(individual, i);
+        if(name_table_add(a_t->individual, name, strlen(name)) < 0){
+            free(source);
+            free_phenotype(a_t);
+            return NULL;
+        }
+    }
+    
+    /* Values (column major order). */
+    for(j = 0; j < p_t->n_trait; j++){
+        for(i = 0; i < a_t->n_individual; i++){
+            phenotype_column(a_t, j)[i] = (source[i] < 0) ? NAN : phenotype_column(p_t, j)[source[i]];
+        }
+    }
+    
+    if(n_missing > 0)
+        fprintf(stderr, "%d of %d individuals have no phenotype\n", n_missing, a_t->n_individual);
+    
+    free(source);
+    return a_t;
 }
-*/
 
 /*
  * free_phenotype
@@ -372,29 +979,13 @@ int phenotype_store(char* fileName, phenotype* p_t){
  *   SIDE EFFECTS: Deallocates a phenotype struct.
  */
 void free_phenotype(phenotype* p_t){
-    int i = 0;                  /* Loop variable. */
-    
     if(p_t != NULL){
-        /* Outer free. */
-        if(p_t->trait != NULL){
-            /* Inner free. */
-            for(i = 0; i < p_t->n_trait; i++){
-                free(p_t->trait[i]);
-                p_t->trait[i] = NULL;
-            }
-        }
-        if(p_t->individual != NULL){
-            for(i = 0; i < p_t->n_individual; i++){
-                free(p_t->individual[i]);
-                p_t->individual[i] = NULL;
-            }
-        }
-        if(p_t->matrix != NULL){
-            for(i = 0; i < p_t->n_trait; i++){
-                free(p_t->matrix[i]);
-                p_t->matrix[i] = NULL;
-            }
-        }
+        free_name_table(p_t->trait);
+        free_name_table(p_t->individual);
+        if(!in_map(p_t->map, p_t->matrix))
+            free(p_t->matrix);
+        p_t->matrix = NULL;
+        unmap_file(p_t->map);
         free(p_t);
         p_t = NULL;
     }
@@ -7,15 +7,68 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include "fastio.h"
+#include "names.h"
+
+/*
+ * Binary cache format (version 1, native byte order):
+ *   data_header            -- magic, version, encoding, dimensions and the
+ *                             offsets of the two blocks below.
+ *   name table             -- (n_col + n_row) uint64 offsets followed by the
+ *                             NUL-terminated column names, then row names.
+ *   matrix                 -- marker (column) major, starting on a page
+ *                             boundary. DATA_ENCODING_FLOAT stores each
+ *                             column as ld floats (ld padded to 16);
+ *                             DATA_ENCODING_DOSAGE stores each column as
+ *                             ld / 4 bytes of 2-bit codes (0, 1, 2 and
+ *                             3 for missing), four individuals per byte.
+ */
+#define GENOTYPE_MAGIC          "SEMSGEN"
+#define PHENOTYPE_MAGIC         "SEMSPHE"
+#define DATA_VERSION            1
+#define DATA_ENCODING_FLOAT     0
+#define DATA_ENCODING_DOSAGE    1
+
+/* Column alignment of genotype and phenotype matrices, in bytes. */
+#define MATRIX_ALIGN            64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t encoding;
+    uint64_t n_col;
+    uint64_t n_row;
+    uint64_t ld;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t matrix_offset;
+    uint64_t matrix_size;
+} data_header;
+
+/*
+ * data_column_size
+ *   DESCRIPTION: Bytes of one stored column in a binary cache.
+ */
+static inline uint64_t data_column_size(const data_header* h){
+    return (h->encoding == DATA_ENCODING_FLOAT) ? h->ld * sizeof(float) : h->ld / 4;
+}
+
+
 
 typedef struct {
     int n_marker;
     int n_individual;
+    int ld;                     /* Leading dimension of matrix.        */
+    
+    name_table* individual;
+    name_table* marker;
     
-    char** individual;
-    char** marker;
+    float* matrix;              /* n_individual x n_marker, col major. */
     
-    float** matrix;
+    mapped_file* map;           /* Backing binary file, NULL if owned. */
 } genotype;
 
 
@@ -23,31 +76,123 @@ typedef struct {
 typedef struct {
     int n_trait;
     int n_individual;
+    int ld;                     /* Leading dimension of matrix.        */
+    
+    name_table* individual;
+    name_table* trait;
     
-    char** individual;
-    char** trait;
+    float* matrix;              /* n_individual x n_trait, col major.  */
     
-    float** matrix;
+    mapped_file* map;           /* Backing binary file, NULL if owned. */
 } phenotype;
 
 
 
+/*
+ * text_header
+ *   DESCRIPTION: Finds the header of a text table: the first "<Tag>" line
+ *                that lists names (lines holding only a "<...>" tag are
+ *                skipped).
+ *   INPUTS: data     -- start of the text.
+ *           size     -- bytes of text.
+ *           fileName -- name of file, for error messages.
+ *           header   -- first name on the header line.
+ *           body     -- first data line.
+ *           n_col    -- number of names on the header line.
+ *   OUTPUTS: header, body, n_col
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: None.
+ */
+int text_header(const char* data, size_t size, char* fileName,
+                const char** header, const char** body, int* n_col);
+
+/*
+ * data_header_check
+ *   DESCRIPTION: Validates a binary cache header against the file size.
+ *   INPUTS: h         -- file header.
+ *           file_size -- size of the file in bytes.
+ *           fileName  -- name of file, for error messages.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) if the header is usable, (1) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+int data_header_check(const data_header* h, uint64_t file_size, char* fileName);
+
+/*
+ * data_names_wrap
+ *   DESCRIPTION: Validates the name table block of a binary cache and
+ *                creates column and row name tables over it.
+ *   INPUTS: h        -- file header.
+ *           names    -- the names block (h->names_size bytes).
+ *           fileName -- name of file, for error messages.
+ *           col      -- column names.
+ *           row      -- row names.
+ *   OUTPUTS: col, row
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates two name tables borrowing names.
+ */
+int data_names_wrap(const data_header* h, char* names, char* fileName,
+                    name_table** col, name_table** row);
+
+/*
+ * data_decode_dosage
+ *   DESCRIPTION: Expands one column of 2-bit dosage codes to floats.
+ *   INPUTS: code  -- packed codes, four individuals per byte.
+ *           n_row -- number of individuals.
+ *           out   -- n_row floats.
+ *   OUTPUTS: out
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void data_decode_dosage(const unsigned char* code, int n_row, float* out);
+
+/*
+ * matrix_alloc
+ *   DESCRIPTION: Allocates one column major matrix whose columns start on
+ *                64-byte boundaries. The padding rows are zeroed.
+ *   INPUTS: n_row -- number of rows.
+ *           n_col -- number of columns.
+ *           ld    -- leading dimension (n_row rounded up to 16).
+ *   OUTPUTS: ld
+ *   RETURN VALUE: Pointer to the matrix, NULL on failure. Release with free.
+ *   SIDE EFFECTS: Allocates memory.
+ */
+float* matrix_alloc(int n_row, int n_col, int* ld);
+
+
+
+/*
+ * genotype_column
+ *   DESCRIPTION: Returns the values of one marker for all individuals.
+ *   INPUTS: g_t -- pointer to genotype struct.
+ *           j   -- marker index.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to n_individual contiguous floats.
+ *   SIDE EFFECTS: None.
+ */
+static inline float* genotype_column(genotype* g_t, int j){
+    return g_t->matrix + (size_t)j * g_t->ld;
+}
+
 /*
  * genotype_load
  *   DESCRIPTION: Creates and fills a genotype struct by 
- *                passing in a text file of a specific format.
- *   INPUTS: fileName -- name of text file to be read.
+ *                passing in a text file of a specific format, or a
+ *                binary cache written by genotype_store (detected by
+ *                its magic number and mapped without copying).
+ *   INPUTS: fileName  -- name of text or binary file to be read.
+ *           n_threads -- number of threads parsing a text file.
  *   OUTPUTS: None.
  *   RETURN VALUE: Pointer to newly allocated genotype struct.
  *   SIDE EFFECTS: Allocates a genotype struct.
  */
-genotype* genotype_load(char* fileName);
+genotype* genotype_load(char* fileName, int n_threads);
 
 /*
  * genotype_store
  *   DESCRIPTION: Stores the genotype struct data into a
- *                text file in a specific format.
- *   INPUTS: fileName -- name of text file to be written to.
+ *                binary cache file in the format above.
+ *   INPUTS: fileName -- name of binary file to be written to.
  *           g_t -- pointer to genotype struct.
  *   OUTPUTS: fileName
  *   RETURN VALUE: (0) on success, (1) on failure.
@@ -67,22 +212,38 @@ void free_genotype(genotype* g_t);
 
 
 
+/*
+ * phenotype_column
+ *   DESCRIPTION: Returns the values of one trait for all individuals.
+ *   INPUTS: p_t -- pointer to phenotype struct.
+ *           j   -- trait index.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to n_individual contiguous floats.
+ *   SIDE EFFECTS: None.
+ */
+static inline float* phenotype_column(phenotype* p_t, int j){
+    return p_t->matrix + (size_t)j * p_t->ld;
+}
+
 /*
  * phenotype_load
  *   DESCRIPTION: Creates and fills a phenotype struct by 
- *                passing in a text file of a specific format.
- *   INPUTS: fileName -- name of text file to be read.
+ *                passing in a text file of a specific format, or a
+ *                binary cache written by phenotype_store (detected by
+ *                its magic number and mapped without copying).
+ *   INPUTS: fileName  -- name of text or binary file to be read.
+ *           n_threads -- number of threads parsing a text file.
  *   OUTPUTS: None.
  *   RETURN VALUE: Pointer to newly allocated phenotype struct.
  *   SIDE EFFECTS: Allocates a phenotype struct.
  */
-phenotype* phenotype_load(char* fileName);
+phenotype* phenotype_load(char* fileName, int n_threads);
 
 /*
  * phenotype_store
  *   DESCRIPTION: Stores the phenotype struct data into a
- *                text file in a specific format.
- *   INPUTS: fileName -- name of text file to be written to.
+ *                binary cache file in the format above.
+ *   INPUTS: fileName -- name of binary file to be written to.
  *           p_t -- pointer to phenotype struct.
  *   OUTPUTS: fileName
  *   RETURN VALUE: (0) on success, (1) on failure.
@@ -90,6 +251,20 @@ phenotype* phenotype_load(char* fileName);
  */
 int phenotype_store(char* fileName, phenotype* p_t);
 
+/*
+ * phenotype_align
+ *   DESCRIPTION: Creates a phenotype struct whose rows follow a given
+ *                individual order, matching names through the hash index
+ *                in linear time. Individuals without a phenotype row get
+ *                NAN (missing) values.
+ *   INPUTS: p_t        -- pointer to phenotype struct.
+ *           individual -- target individual order (e.g. genotype's).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated phenotype struct.
+ *   SIDE EFFECTS: Allocates a phenotype struct.
+ */
+phenotype* phenotype_align(phenotype* p_t, name_table* individual);
+
 /*
  * free_phenotype
  *   DESCRIPTION: Deallocates memory associated with a phenotype struct.
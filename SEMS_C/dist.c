@@ -0,0 +1,373 @@
+/* Distribution : Function Definition File */
+
+#include "dist.h"
+
+static int my_rank = 0;         /* Rank of this process.  */
+static int n_rank = 1;          /* Ranks of the run.      */
+static int started = 0;         /* Whether MPI is up.     */
+
+/*
+ * dist_init
+ *   DESCRIPTION: Initializes MPI and records the rank and size.
+ *   INPUTS: argc -- pointer to argument count.
+ *           argv -- pointer to argument vector.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Calls MPI_Init.
+ */
+int dist_init(int* argc, char*** argv){
+
+    if(MPI_Init(argc, argv) != MPI_SUCCESS){
+        fprintf(stderr, "cannot initialize MPI\n");
+        return 1;
+    }
+    started = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &n_rank);
+
+    return 0;
+}
+
+/*
+ * dist_rank
+ *   DESCRIPTION: Rank of this process, 0 before dist_init.
+ */
+int dist_rank(void){
+    return my_rank;
+}
+
+/*
+ * dist_size
+ *   DESCRIPTION: Number of ranks, 1 before dist_init.
+ */
+int dist_size(void){
+    return n_rank;
+}
+
+/*
+ * dist_finish
+ *   DESCRIPTION: Ends the run: MPI_Finalize on success, MPI_Abort of every
+ *                rank on failure, since the others may wait on this one.
+ *   INPUTS: status -- exit status of this rank.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: status
+ *   SIDE EFFECTS: Finalizes or aborts MPI.
+ */
+int dist_finish(int status){
+
+    if(!started)
+        return status;
+    if(status && n_rank > 1)
+        MPI_Abort(MPI_COMM_WORLD, status);
+    MPI_Finalize();
+    started = 0;
+
+    return status;
+}
+
+/*
+ * bcast_bytes
+ *   DESCRIPTION: Broadcasts a buffer of any size from rank 0.
+ */
+static void bcast_bytes(void* buf, size_t bytes){
+
+    char* p = (char*)buf;
+    size_t n = 0;
+
+    while(bytes > 0){
+        n = (bytes < DIST_CHUNK) ? bytes : DIST_CHUNK;
+        MPI_Bcast(p, (int)n, MPI_BYTE, 0, MPI_COMM_WORLD);
+        p += n;
+        bytes -= n;
+    }
+}
+
+/*
+ * send_bytes, recv_bytes
+ *   DESCRIPTION: Point-to-point transfer of a buffer of any size.
+ */
+static void send_bytes(const void* buf, size_t bytes, int to){
+
+    const char* p = (const char*)buf;
+    size_t n = 0;
+
+    while(bytes > 0){
+        n = (bytes < DIST_CHUNK) ? bytes : DIST_CHUNK;
+        MPI_Send(p, (int)n, MPI_BYTE, to, 0, MPI_COMM_WORLD);
+        p += n;
+        bytes -= n;
+    }
+}
+
+static void recv_bytes(void* buf, size_t bytes, int from){
+
+    char* p = (char*)buf;
+    size_t n = 0;
+
+    while(bytes > 0){
+        n = (bytes < DIST_CHUNK) ? bytes : DIST_CHUNK;
+        MPI_Recv(p, (int)n, MPI_BYTE, from, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        p += n;
+        bytes -= n;
+    }
+}
+
+/*
+ * bcast_names
+ *   DESCRIPTION: Broadcasts a name table from rank 0, packed as
+ *                NUL-terminated names back to back.
+ *   INPUTS: nt -- name table on rank 0, ignored elsewhere.
+ *   OUTPUTS: nt
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates a name_table on ranks other than 0.
+ */
+static int bcast_names(name_table** nt){
+
+    char* buf = NULL;           /* Packed names.    */
+    char* p = NULL;
+    unsigned long long size[2] = {0, 0};
+    size_t len = 0;
+    int status = 0;
+    int i = 0;                  /* Loop variable.   */
+
+    if(my_rank == 0){
+        size[0] = (unsigned long long)(*nt)->n_name;
+        for(i = 0; i < (*nt)->n_name; i++)
+            size[1] += strlen(name_table_get(*nt, i)) + 1;
+    }
+    MPI_Bcast(size, 2, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+
+    if((buf = (char*)malloc((size[1] > 0) ? (size_t)size[1] : 1)) == NULL){
+        fprintf(stderr, "cannot allocate memory: names\n");
+        return 1;
+    }
+    if(my_rank == 0){
+        for(i = 0, p = buf; i < (*nt)->n_name; i++, p += len){
+            len = strlen(name_table_get(*nt, i)) + 1;
+            memcpy(p, name_table_get(*nt, i), len);
+        }
+    }
+    bcast_bytes(buf, (size_t)size[1]);
+
+    if(my_rank != 0){
+        if((*nt = name_table_create((int)size[0], (size_t)size[1])) == NULL)
+            status = 1;
+        for(i = 0, p = buf; !status && i < (int)size[0]; i++, p += len + 1){
+            len = strlen(p);
+            if(name_table_add(*nt, p, len) < 0)
+                status = 1;
+        }
+    }
+    free(buf);
+
+    return status;
+}
+
+/*
+ * bcast_table
+ *   DESCRIPTION: Broadcasts the matrix of a genotype or phenotype from
+ *                rank 0, with its dimensions. Other ranks allocate it
+ *                with matrix_alloc.
+ *   INPUTS: n_row  -- rows.
+ *           n_col  -- columns.
+ *           ld     -- leading dimension.
+ *           matrix -- matrix on rank 0, ignored elsewhere.
+ *   OUTPUTS: n_row, n_col, ld, matrix
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates a matrix on ranks other than 0.
+ */
+static int bcast_table(int* n_row, int* n_col, int* ld, float** matrix){
+
+    int dim[4] = {0, 0, 0, 1};  /* Rows, columns, ld, same layout. */
+    int l = 0;
+    int j = 0;                  /* Loop variable. */
+
+    if(my_rank == 0){
+        dim[0] = *n_row;
+        dim[1] = *n_col;
+        dim[2] = *ld;
+    }
+    MPI_Bcast(dim, 3, MPI_INT, 0, MPI_COMM_WORLD);
+    *n_row = dim[0];
+    *n_col = dim[1];
+
+    if(my_rank != 0){
+        if((*matrix = matrix_alloc(dim[0], dim[1], &l)) == NULL){
+            fprintf(stderr, "cannot allocate memory: matrix\n");
+            return 1;
+        }
+        *ld = l;
+        dim[3] = (l == dim[2]);
+    }
+
+    /* One broadcast of the slab when every rank has its layout, else a column each. */
+    MPI_Allreduce(MPI_IN_PLACE, &dim[3], 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if(dim[3])
+        bcast_bytes(*matrix, (size_t)dim[2] * dim[1] * sizeof(float));
+    else
+        for(j = 0; j < dim[1]; j++)
+            bcast_bytes(*matrix + (size_t)j * *ld, (size_t)dim[0] * sizeof(float));
+
+    return 0;
+}
+
+/*
+ * dist_bcast_genotype
+ *   DESCRIPTION: Sends the genotype of rank 0 to every rank.
+ *   INPUTS: g -- genotype on rank 0, ignored elsewhere.
+ *   OUTPUTS: g
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates a genotype on ranks other than 0.
+ */
+int dist_bcast_genotype(genotype** g){
+
+    if(n_rank == 1)
+        return 0;
+    if(my_rank != 0 && (*g = (genotype*)calloc(1, sizeof(genotype))) == NULL){
+        fprintf(stderr, "cannot allocate memory: genotype*\n");
+        return 1;
+    }
+
+    return bcast_names(&(*g)->individual) ||
+           bcast_names(&(*g)->marker) ||
+           bcast_table(&(*g)->n_individual, &(*g)->n_marker, &(*g)->ld, &(*g)->matrix);
+}
+
+/*
+ * dist_bcast_phenotype
+ *   DESCRIPTION: Sends the phenotype of rank 0 to every rank.
+ *   INPUTS: p -- phenotype on rank 0, ignored elsewhere.
+ *   OUTPUTS: p
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates a phenotype on ranks other than 0.
+ */
+int dist_bcast_phenotype(phenotype** p){
+
+    if(n_rank == 1)
+        return 0;
+    if(my_rank != 0 && (*p = (phenotype*)calloc(1, sizeof(phenotype))) == NULL){
+        fprintf(stderr, "cannot allocate memory: phenotype*\n");
+        return 1;
+    }
+
+    return bcast_names(&(*p)->individual) ||
+           bcast_names(&(*p)->trait) ||
+           bcast_table(&(*p)->n_individual, &(*p)->n_trait, &(*p)->ld, &(*p)->matrix);
+}
+
+/*
+ * dist_to_root
+ *   DESCRIPTION: Moves a buffer filled by rank owner to rank 0. Buffers
+ *                must be moved in the same order on every rank.
+ *   INPUTS: buf   -- buffer.
+ *           bytes -- size of buffer.
+ *           owner -- rank that filled it.
+ *   OUTPUTS: buf (on rank 0)
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Sends or receives a message.
+ */
+int dist_to_root(void* buf, size_t bytes, int owner){
+
+    if(owner == 0)
+        return 0;
+    if(my_rank == owner)
+        send_bytes(buf, bytes, 0);
+    else if(my_rank == 0)
+        recv_bytes(buf, bytes, owner);
+
+    return 0;
+}
+
+/*
+ * dist_sum
+ *   DESCRIPTION: Sum of a count over the ranks.
+ *   INPUTS: v -- count of this rank.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Sum on every rank.
+ *   SIDE EFFECTS: Collective.
+ */
+long dist_sum(long v){
+
+    if(n_rank > 1)
+        MPI_Allreduce(MPI_IN_PLACE, &v, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    return v;
+}
+
+/*
+ * dist_agree
+ *   DESCRIPTION: Value of rank 0, for decisions every rank must share.
+ *   INPUTS: v -- value (used on rank 0).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: v of rank 0 on every rank.
+ *   SIDE EFFECTS: Collective.
+ */
+long dist_agree(long v){
+
+    if(n_rank > 1)
+        MPI_Bcast(&v, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+    return v;
+}
+
+/*
+ * dist_reduce_results
+ *   DESCRIPTION: Merges the result_set of every rank into the one of
+ *                rank 0 (heaps and hit lists, see result_merge).
+ *   INPUTS: s -- result_set of this rank, with the same traits, top and
+ *                threshold on every rank.
+ *   OUTPUTS: s (on rank 0)
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective; updates s on rank 0.
+ */
+int dist_reduce_results(result_set* s){
+
+    result_set* t = NULL;       /* Set of one other rank.  */
+    long head[3];               /* Hits, tests and status. */
+    int status = 0;
+    int r = 0;                  /* Loop variable.          */
+
+    if(n_rank == 1)
+        return s->status;
+
+    if(my_rank != 0){
+        head[0] = s->n_hit;
+        head[1] = s->n_test;
+        head[2] = s->status;
+        send_bytes(head, sizeof(head), 0);
+        send_bytes(s->n_heap, (size_t)s->n_trait * sizeof(int), 0);
+        if(s->top > 0)
+            send_bytes(s->heap, (size_t)s->n_trait * s->top * sizeof(result_entry), 0);
+        send_bytes(s->hit, (size_t)s->n_hit * sizeof(result_entry), 0);
+        return dist_sum(s->status) != 0;
+    }
+
+    if((t = result_set_create(s->n_trait, s->top, s->threshold)) == NULL)
+        return 1;
+    for(r = 1; r < n_rank && !status; r++){
+        recv_bytes(head, sizeof(head), r);
+        if(head[0] > t->max_hit){
+            free(t->hit);
+            t->max_hit = 0;
+            if((t->hit = (result_entry*)malloc(head[0] * sizeof(result_entry))) == NULL){
+                fprintf(stderr, "cannot allocate memory: result hits\n");
+                status = 1;
+                break;
+            }
+            t->max_hit = head[0];
+        }
+        recv_bytes(t->n_heap, (size_t)s->n_trait * sizeof(int), r);
+        if(s->top > 0)
+            recv_bytes(t->heap, (size_t)s->n_trait * s->top * sizeof(result_entry), r);
+        recv_bytes(t->hit, (size_t)head[0] * sizeof(result_entry), r);
+        t->n_hit = head[0];
+        t->n_test = head[1];
+        t->status = (int)head[2];
+        status |= result_merge(s, t);
+    }
+    free_result_set(t);
+    if(!status)
+        status = (dist_sum(s->status) != 0);
+
+    return status;
+}
@@ -0,0 +1,130 @@
+/* Distribution : Header File */
+
+#ifndef DIST_H
+#define DIST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "data.h"
+#include "names.h"
+#include "results.h"
+
+/* Bytes per MPI message of a large buffer (counts are int). */
+#define DIST_CHUNK (1 << 30)
+
+/*
+ * Work split over the ranks of MPI_COMM_WORLD. Rank 0 loads the genotype
+ * and phenotype and broadcasts them, since every rank's share of the pair
+ * space touches every marker. The single-marker scan deals chunks of
+ * markers round-robin and the pairwise scans deal tile pairs, so the
+ * pruned, uneven tiles spread evenly. With -top, each rank keeps its own
+ * result_set and dist_reduce_results merges them on rank 0; otherwise
+ * dist_to_root moves each result buffer to rank 0 in output order. Only
+ * rank 0 writes files and reports. A single process runs unchanged,
+ * with or without mpirun.
+ */
+
+
+
+/*
+ * dist_init
+ *   DESCRIPTION: Initializes MPI and records the rank and size.
+ *   INPUTS: argc -- pointer to argument count.
+ *           argv -- pointer to argument vector.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Calls MPI_Init.
+ */
+int dist_init(int* argc, char*** argv);
+
+/*
+ * dist_rank
+ *   DESCRIPTION: Rank of this process, 0 before dist_init.
+ */
+int dist_rank(void);
+
+/*
+ * dist_size
+ *   DESCRIPTION: Number of ranks, 1 before dist_init.
+ */
+int dist_size(void);
+
+/*
+ * dist_finish
+ *   DESCRIPTION: Ends the run: MPI_Finalize on success, MPI_Abort of every
+ *                rank on failure, since the others may wait on this one.
+ *   INPUTS: status -- exit status of this rank.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: status
+ *   SIDE EFFECTS: Finalizes or aborts MPI.
+ */
+int dist_finish(int status);
+
+/*
+ * dist_bcast_genotype
+ *   DESCRIPTION: Sends the genotype of rank 0 to every rank.
+ *   INPUTS: g -- genotype on rank 0, ignored elsewhere.
+ *   OUTPUTS: g
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates a genotype on ranks other than 0.
+ */
+int dist_bcast_genotype(genotype** g);
+
+/*
+ * dist_bcast_phenotype
+ *   DESCRIPTION: Sends the phenotype of rank 0 to every rank.
+ *   INPUTS: p -- phenotype on rank 0, ignored elsewhere.
+ *   OUTPUTS: p
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates a phenotype on ranks other than 0.
+ */
+int dist_bcast_phenotype(phenotype** p);
+
+/*
+ * dist_to_root
+ *   DESCRIPTION: Moves a buffer filled by rank owner to rank 0. Buffers
+ *                must be moved in the same order on every rank.
+ *   INPUTS: buf   -- buffer.
+ *           bytes -- size of buffer.
+ *           owner -- rank that filled it.
+ *   OUTPUTS: buf (on rank 0)
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Sends or receives a message.
+ */
+int dist_to_root(void* buf, size_t bytes, int owner);
+
+/*
+ * dist_sum
+ *   DESCRIPTION: Sum of a count over the ranks.
+ *   INPUTS: v -- count of this rank.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Sum on every rank.
+ *   SIDE EFFECTS: Collective.
+ */
+long dist_sum(long v);
+
+/*
+ * dist_agree
+ *   DESCRIPTION: Value of rank 0, for decisions every rank must share.
+ *   INPUTS: v -- value (used on rank 0).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: v of rank 0 on every rank.
+ *   SIDE EFFECTS: Collective.
+ */
+long dist_agree(long v);
+
+/*
+ * dist_reduce_results
+ *   DESCRIPTION: Merges the result_set of every rank into the one of
+ *                rank 0 (heaps and hit lists, see result_merge).
+ *   INPUTS: s -- result_set of this rank, with the same traits, top and
+ *                threshold on every rank.
+ *   OUTPUTS: s (on rank 0)
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective; updates s on rank 0.
+ */
+int dist_reduce_results(result_set* s);
+
+#endif
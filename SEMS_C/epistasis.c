@@ -0,0 +1,1091 @@
+/* Epistasis Scan : Function Definition File */
+
+#include "epistasis.h"
+#include "data.h"
+#include "dist.h"
+#include "fastio.h"
+
+/*
+ * square_columns
+ *   DESCRIPTION: out = x o x for n_col columns.
+ *   INPUTS: x     -- first column.
+ *           ldx   -- leading dimension of x.
+ *           n_row -- rows.
+ *           n_col -- columns.
+ *           ld    -- leading dimension of out.
+ *   OUTPUTS: out
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+static void square_columns(const float* x, int ldx, int n_row, int n_col, float* out, int ld){
+
+    const float* c = NULL;
+    int i, j;                   /* Loop variables. */
+
+    for(j = 0; j < n_col; j++){
+        c = x + (size_t)j * ldx;
+        for(i = 0; i < n_row; i++)
+            out[(size_t)j * ld + i] = c[i] * c[i];
+    }
+}
+
+/*
+ * scale_rows
+ *   DESCRIPTION: out = diag(s) * x for n_col columns.
+ *   INPUTS: x     -- first column.
+ *           ldx   -- leading dimension of x.
+ *           s     -- row scales.
+ *           n_row -- rows.
+ *           n_col -- columns.
+ *           ld    -- leading dimension of out.
+ *   OUTPUTS: out
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+static void scale_rows(const float* x, int ldx, const float* s, int n_row, int n_col, float* out, int ld){
+
+    const float* c = NULL;
+    int i, j;                   /* Loop variables. */
+
+    for(j = 0; j < n_col; j++){
+        c = x + (size_t)j * ldx;
+        for(i = 0; i < n_row; i++)
+            out[(size_t)j * ld + i] = s[i] * c[i];
+    }
+}
+
+/*
+ * tile_product
+ *   DESCRIPTION: s = a^T * b for an n_a by n_b tile, leading dimension ld.
+ */
+static void tile_product(const float* a, int lda, const float* b, int ldb,
+                         int n_row, int n_a, int n_b, float* s, int ld){
+    cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+                n_a, n_b, n_row,
+                1.0f,
+                a, lda,
+                b, ldb,
+                0.0f,
+                s, ld);
+}
+
+/*
+ * pack_dosages
+ *   DESCRIPTION: Packs the genotype for the popcount sums when every value
+ *                is a 0/1/2 dosage.
+ *   INPUTS: x        -- first marker column.
+ *           ldx      -- leading dimension of x.
+ *           n_marker -- number of markers.
+ *           n        -- number of individuals.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated bitgeno, NULL for other data
+ *                 (the sums then stay GEMMs).
+ *   SIDE EFFECTS: Allocates a bitgeno; writes to stderr.
+ */
+static bitgeno* pack_dosages(const float* x, int ldx, int n_marker, int n){
+
+    bitgeno* g = NULL;          /* Return argument. */
+
+    if(!bitgeno_is_dosage(x, ldx, n_marker, n))
+        return NULL;
+    if((g = bitgeno_create(x, ldx, n_marker, n)) != NULL && dist_rank() == 0)
+        fprintf(stderr, "Packed dosages: %.3g MB\n",
+                2.0 * n_marker * g->n_word * sizeof(uint64_t) / 1048576.0);
+
+    return g;
+}
+
+/* A tile pair and the strength of its best single markers. */
+typedef struct {
+    float score;
+    int pair;
+} tile_rank;
+
+/*
+ * stronger
+ *   DESCRIPTION: qsort order of tile_rank, strongest first.
+ */
+static int stronger(const void* x, const void* y){
+
+    const tile_rank* a = (const tile_rank*)x;
+    const tile_rank* b = (const tile_rank*)y;
+
+    if(a->score != b->score)
+        return (a->score < b->score) - (a->score > b->score);
+    return (a->pair > b->pair) - (a->pair < b->pair);
+}
+
+/*
+ * pair_bound_create
+ *   DESCRIPTION: Per-marker bounds and tile order of a pairwise scan.
+ *   INPUTS: x        -- first marker column.
+ *           ldx      -- leading dimension of x.
+ *           n_marker -- number of markers.
+ *           st       -- statistics of the markers.
+ *           y        -- centered traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated pair_bound, NULL on failure.
+ *   SIDE EFFECTS: Allocates a pair_bound; one pass over the genotype.
+ */
+pair_bound* pair_bound_create(const float* x, int ldx, int n_marker, const marker_stats* st,
+                              const scan_trait* y, int tile){
+
+    pair_bound* b = NULL;       /* Return argument.            */
+    tile_rank* rank = NULL;
+    float* strength = NULL;     /* Best |r| of each tile.      */
+    const float* c = NULL;
+    const float* ca = NULL;     /* Anchor of c.                */
+    const float* yc = NULL;
+    double sxy, w, r, dist, best;
+    size_t at = 0;
+    int n = y->n_individual;
+    int g0, g1;                 /* Group of markers.           */
+    int ti, tj, a, i, k;        /* Loop variables.             */
+
+    if((b = (pair_bound*)calloc(1, sizeof(pair_bound))) == NULL){
+        fprintf(stderr, "cannot allocate memory: pair_bound*\n");
+        return NULL;
+    }
+    b->n_marker = n_marker;
+    b->n_trait = y->n_trait;
+    b->lo = st->lo;
+    b->hi = st->hi;
+    b->tile = tile;
+    b->n_tile = (n_marker + tile - 1) / tile;
+    b->n_order = (long)b->n_tile * (b->n_tile + 1) / 2;
+
+    if((b->pd = (double*)malloc((size_t)n_marker * y->n_trait * sizeof(double))) == NULL ||
+       (b->nd = (double*)malloc((size_t)n_marker * y->n_trait * sizeof(double))) == NULL ||
+       (b->anchor = (int*)malloc(n_marker * sizeof(int))) == NULL ||
+       (b->order = (int*)malloc(b->n_order * sizeof(int))) == NULL ||
+       (rank = (tile_rank*)malloc(b->n_order * sizeof(tile_rank))) == NULL ||
+       (strength = (float*)calloc(b->n_tile, sizeof(float))) == NULL){
+        fprintf(stderr, "cannot allocate memory: pair_bound*\n");
+        free(rank);
+        free(strength);
+        free_pair_bound(b);
+        return NULL;
+    }
+
+    /* Anchor: the member of the group nearest the others in L1. */
+    for(g0 = 0; g0 < n_marker; g0 += EPISTASIS_GROUP){
+        g1 = (g0 + EPISTASIS_GROUP < n_marker) ? g0 + EPISTASIS_GROUP : n_marker;
+        best = INFINITY;
+        for(k = g0; k < g1; k++){
+            ca = x + (size_t)k * ldx;
+            dist = 0.0;
+            for(a = g0; a < g1; a++){
+                c = x + (size_t)a * ldx;
+                for(i = 0; i < n; i++)
+                    dist += fabs((double)c[i] - ca[i]);
+            }
+            if(dist < best){
+                best = dist;
+                b->anchor[g0] = k;
+            }
+        }
+        for(a = g0 + 1; a < g1; a++)
+            b->anchor[a] = b->anchor[g0];
+    }
+
+    for(a = 0; a < n_marker; a++){
+        c = x + (size_t)a * ldx;
+        ca = x + (size_t)b->anchor[a] * ldx;
+        for(k = 0; k < y->n_trait; k++){
+            yc = y->yc + (size_t)k * y->ld;
+            at = (size_t)k * n_marker + a;
+            b->pd[at] = b->nd[at] = 0.0;
+            sxy = 0.0;
+            for(i = 0; i < n; i++){
+                w = ((double)c[i] - ca[i]) * yc[i];
+                if(w > 0.0)
+                    b->pd[at] += w;
+                else
+                    b->nd[at] -= w;
+                sxy += (double)c[i] * yc[i];
+            }
+            /* Rough |r| of the marker alone, only to order the tiles. */
+            r = (st->css[a] > 0.0 && y->syy[k] > 0.0) ? fabs(sxy) / sqrt(st->css[a] * y->syy[k]) : 0.0;
+            if(r > strength[a / tile])
+                strength[a / tile] = (float)r;
+        }
+    }
+
+    at = 0;
+    for(ti = 0; ti < b->n_tile; ti++){
+        for(tj = ti; tj < b->n_tile; tj++, at++){
+            rank[at].score = strength[ti] + strength[tj];
+            rank[at].pair = ti * b->n_tile + tj;
+        }
+    }
+    qsort(rank, b->n_order, sizeof(tile_rank), stronger);
+    for(at = 0; at < (size_t)b->n_order; at++)
+        b->order[at] = rank[at].pair;
+
+    free(rank);
+    free(strength);
+
+    return b;
+}
+
+/*
+ * free_pair_bound
+ *   DESCRIPTION: Deallocates memory associated with a pair_bound.
+ *   INPUTS: b -- pointer to pair_bound.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a pair_bound (lo and hi stay with the
+ *                 marker_stats).
+ */
+void free_pair_bound(pair_bound* b){
+    if(b != NULL){
+        free(b->pd);
+        free(b->nd);
+        free(b->anchor);
+        free(b->order);
+        free(b);
+    }
+}
+
+/*
+ * gather_anchors
+ *   DESCRIPTION: Copies the anchors of the groups of a tile, scaled by s
+ *                unless s is NULL.
+ *   INPUTS: e     -- pointer to epistasis.
+ *           first -- first marker of the tile.
+ *           n_col -- markers of the tile.
+ *           s     -- row scales, NULL for none.
+ *           out   -- one column per group, leading dimension y->ld.
+ *   OUTPUTS: out
+ *   RETURN VALUE: Number of groups.
+ *   SIDE EFFECTS: None.
+ */
+static int gather_anchors(const epistasis* e, int first, int n_col, const float* s, float* out){
+
+    const float* c = NULL;
+    float* o = NULL;
+    int n_group = (n_col + EPISTASIS_GROUP - 1) / EPISTASIS_GROUP;
+    int g, i;                   /* Loop variables. */
+
+    for(g = 0; g < n_group; g++){
+        c = e->x + (size_t)e->bound->anchor[first + g * EPISTASIS_GROUP] * e->ldx;
+        o = out + (size_t)g * e->y->ld;
+        if(s == NULL)
+            memcpy(o, c, e->n_individual * sizeof(float));
+        else
+            for(i = 0; i < e->n_individual; i++)
+                o[i] = s[i] * c[i];
+    }
+
+    return n_group;
+}
+
+/*
+ * live_rows
+ *   DESCRIPTION: Rows of the tile with a pair whose bound lets trait k
+ *                reach need. Pairs that scan_fit rejects as constant are
+ *                left out. For a pair with centered sum of squares css and
+ *                |sxy| <= u, |t| = |sxy| sqrt(df / (css syy - sxy^2)) is at
+ *                most u sqrt(df / (css syy - u^2)).
+ *   INPUTS: e      -- pointer to epistasis (s1, s2 and the anchor terms
+ *                     sa of the tile filled).
+ *           k      -- trait.
+ *           i0, j0 -- first markers of the tiles.
+ *           n_i    -- markers of the row tile.
+ *           n_j    -- markers of the column tile.
+ *           diag   -- whether the tiles are the same.
+ *           need   -- |t| to reach.
+ *   OUTPUTS: e->live -- the rows, in order.
+ *   RETURN VALUE: Number of rows.
+ *   SIDE EFFECTS: None.
+ */
+static int live_rows(epistasis* e, int k, int i0, int j0, int n_i, int n_j, int diag, double need){
+
+    const pair_bound* bd = e->bound;
+    const double* pd = bd->pd + (size_t)k * bd->n_marker;
+    const double* nd = bd->nd + (size_t)k * bd->n_marker;
+    const float* lo = bd->lo;
+    const float* hi = bd->hi;
+    double n = e->y->n[k];
+    double syy = e->y->syy[k];
+    double df = n - 2.0;
+    double n2 = need * need;
+    double sx, sxx, css, u;
+    size_t s = 0;               /* Position in a tile sum. */
+    int n_live = 0;
+    int a, b, ga, gb, ca;       /* Loop variables.         */
+
+    for(a = 0; a < n_i; a++){
+        ga = i0 + a;
+        ca = bd->anchor[ga];
+        for(b = diag ? a + 1 : 0; b < n_j; b++){
+            gb = j0 + b;
+            s = (size_t)b * e->tile + a;
+            sx = e->s1[s];
+            sxx = e->s2[s];
+            css = sxx - sx * sx / n;
+            if(!(css > EPISTASIS_TOL * sxx))
+                continue;
+
+            u = fabs(e->sa[(size_t)(b / EPISTASIS_GROUP) * e->tile + a / EPISTASIS_GROUP])
+              + fmax(hi[gb] * pd[ga] - lo[gb] * nd[ga], hi[gb] * nd[ga] - lo[gb] * pd[ga])
+              + fmax(hi[ca] * pd[gb] - lo[ca] * nd[gb], hi[ca] * nd[gb] - lo[ca] * pd[gb]);
+
+            /* u^2 df / (css syy - u^2) >= need^2 */
+            if(u * u * df >= n2 * (css * syy - u * u)){
+                e->live[n_live++] = a;
+                break;
+            }
+        }
+    }
+
+    return n_live;
+}
+
+/*
+ * epistasis_create
+ *   DESCRIPTION: Sets up a pairwise scan over an in-memory genotype slab.
+ *   INPUTS: x        -- first marker column.
+ *           ldx      -- leading dimension of x.
+ *           n_marker -- number of markers.
+ *           st       -- statistics of the markers.
+ *           y        -- centered traits (also gives the individuals).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated epistasis, NULL on failure.
+ *   SIDE EFFECTS: Allocates tile buffers.
+ */
+epistasis* epistasis_create(const float* x, int ldx, int n_marker, const marker_stats* st,
+                            scan_trait* y, int tile){
+
+    epistasis* e = NULL;        /* Return argument. */
+    size_t tile2 = (size_t)tile * tile;
+    int ld = 0;
+    int k = 0;                  /* Loop variable.   */
+
+    if((e = (epistasis*)calloc(1, sizeof(epistasis))) == NULL){
+        fprintf(stderr, "cannot allocate memory: epistasis*\n");
+        return NULL;
+    }
+    e->x = x;
+    e->ldx = ldx;
+    e->n_marker = n_marker;
+    e->n_individual = y->n_individual;
+    e->st = st;
+    e->y = y;
+    e->tile = tile;
+    e->n_tile = (n_marker + tile - 1) / tile;
+
+    if((e->aa = matrix_alloc(y->n_individual, tile, &ld)) == NULL ||
+       (e->bb = matrix_alloc(y->n_individual, tile, &ld)) == NULL ||
+       (e->bw = matrix_alloc(y->n_individual, tile, &ld)) == NULL ||
+       (e->s1 = (float*)malloc(tile2 * sizeof(float))) == NULL ||
+       (e->s2 = (float*)malloc(tile2 * sizeof(float))) == NULL ||
+       (e->s3 = (float*)malloc(tile2 * sizeof(float))) == NULL ||
+       (e->r = (scan_result*)malloc(tile2 * y->n_trait * sizeof(scan_result))) == NULL ||
+       (e->ai = matrix_alloc(y->n_individual, tile / EPISTASIS_GROUP, &ld)) == NULL ||
+       (e->aj = matrix_alloc(y->n_individual, tile / EPISTASIS_GROUP, &ld)) == NULL ||
+       (e->sa = (float*)malloc(tile2 * sizeof(float))) == NULL ||
+       (e->xl = matrix_alloc(y->n_individual, tile, &ld)) == NULL ||
+       (e->live = (int*)malloc(tile * sizeof(int))) == NULL ||
+       (e->slot = (int*)malloc(tile * sizeof(int))) == NULL ||
+       (e->need = (double*)calloc(y->n_trait, sizeof(double))) == NULL ||
+       (e->work = (uint64_t*)malloc(2 * (size_t)bitgeno_words(y->n_individual) * sizeof(uint64_t))) == NULL ||
+       (y->w != NULL &&
+        (e->mask = (uint64_t*)malloc((size_t)y->n_trait * bitgeno_words(y->n_individual) * sizeof(uint64_t))) == NULL)){
+        fprintf(stderr, "cannot allocate memory: epistasis tiles\n");
+        free_epistasis(e);
+        return NULL;
+    }
+    for(k = 0; y->w != NULL && k < y->n_trait; k++)
+        bitgeno_mask(y->w + (size_t)k * y->ld, y->n_individual,
+                     e->mask + (size_t)k * bitgeno_words(y->n_individual));
+
+    return e;
+}
+
+/*
+ * epistasis_tile
+ *   DESCRIPTION: Fits every pair of tile pair (ti, tj), ti <= tj, for
+ *                every trait, p-values included. With e->bound, rows
+ *                whose bound is below e->need of a trait are not fitted.
+ *   INPUTS: e  -- pointer to epistasis.
+ *           ti -- row tile.
+ *           tj -- column tile.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Fills e->r (pairs outside the upper triangle and pruned
+ *                 pairs get NAN).
+ */
+void epistasis_tile(epistasis* e, int ti, int tj){
+
+    scan_trait* y = e->y;
+    int n = e->n_individual;
+    int i0 = ti * e->tile;
+    int j0 = tj * e->tile;
+    int n_i = (e->n_marker - i0 < e->tile) ? e->n_marker - i0 : e->tile;
+    int n_j = (e->n_marker - j0 < e->tile) ? e->n_marker - j0 : e->tile;
+    const float* xi = e->x + (size_t)i0 * e->ldx;
+    const float* xj = e->x + (size_t)j0 * e->ldx;
+    scan_result* r = NULL;
+    long n_tile_pair = (ti == tj) ? (long)n_i * (n_i - 1) / 2 : (long)n_i * n_j;
+    size_t s = 0;               /* Position in a tile sum. */
+    int n_gi = 0;               /* Anchor groups per tile. */
+    int n_gj = 0;
+    int n_live = 0;             /* Rows fitted per trait.  */
+    int a, b, k;                /* Loop variables.         */
+
+    if(e->bits == NULL){
+        square_columns(xi, e->ldx, n, n_i, e->aa, y->ld);
+        square_columns(xj, e->ldx, n, n_j, e->bb, y->ld);
+    }
+
+    /* Complete traits share the first two sums. */
+    if(y->w == NULL && e->bits != NULL)
+        bitgeno_tile(e->bits, i0, n_i, j0, n_j, NULL, e->work, e->s1, e->s2, e->tile);
+    else if(y->w == NULL){
+        tile_product(xi, e->ldx, xj, e->ldx, n, n_i, n_j, e->s1, e->tile);
+        tile_product(e->aa, y->ld, e->bb, y->ld, n, n_i, n_j, e->s2, e->tile);
+    }
+
+    for(k = 0; k < y->n_trait; k++){
+        if(y->w != NULL && e->bits != NULL)
+            bitgeno_tile(e->bits, i0, n_i, j0, n_j, e->mask + (size_t)k * e->bits->n_word, e->work,
+                         e->s1, e->s2, e->tile);
+        else if(y->w != NULL){
+            scale_rows(xj, e->ldx, y->w + (size_t)k * y->ld, n, n_j, e->bw, y->ld);
+            tile_product(xi, e->ldx, e->bw, y->ld, n, n_i, n_j, e->s1, e->tile);
+            scale_rows(e->bb, y->ld, y->w + (size_t)k * y->ld, n, n_j, e->bw, y->ld);
+            tile_product(e->aa, y->ld, e->bw, y->ld, n, n_i, n_j, e->s2, e->tile);
+        }
+
+        /*
+         * Anchor terms first: the rows whose bound cannot reach the need of
+         * the trait drop out of its X_I^T * diag(yc) * X_J product.
+         */
+        n_live = n_i;
+        if(e->bound != NULL && e->need[k] > 0.0){
+            if(n_gi == 0)
+                n_gi = gather_anchors(e, i0, n_i, NULL, e->ai);
+            n_gj = gather_anchors(e, j0, n_j, y->yc + (size_t)k * y->ld, e->aj);
+            tile_product(e->ai, y->ld, e->aj, y->ld, n, n_gi, n_gj, e->sa, e->tile);
+            n_live = live_rows(e, k, i0, j0, n_i, n_j, ti == tj, e->need[k] * (1.0 - EPISTASIS_SLACK));
+        }
+        for(a = 0; a < e->tile; a++)
+            e->slot[a] = (n_live == n_i && a < n_i) ? a : -1;
+        for(a = 0; a < n_live && n_live < n_i; a++){
+            e->slot[e->live[a]] = a;
+            memcpy(e->xl + (size_t)a * y->ld, xi + (size_t)e->live[a] * e->ldx, n * sizeof(float));
+        }
+
+        if(n_live > 0){
+            scale_rows(xj, e->ldx, y->yc + (size_t)k * y->ld, n, n_j, e->bw, y->ld);
+            if(n_live == n_i)
+                tile_product(xi, e->ldx, e->bw, y->ld, n, n_i, n_j, e->s3, e->tile);
+            else
+                tile_product(e->xl, y->ld, e->bw, y->ld, n, n_live, n_j, e->s3, e->tile);
+        }
+
+        for(a = 0; a < e->tile; a++){
+            if(a < n_i && e->slot[a] < 0)
+                e->n_pruned += (ti == tj) ? n_j - a - 1 : n_j;
+            for(b = 0; b < e->tile; b++){
+                r = e->r + ((size_t)a * e->tile + b) * y->n_trait + k;
+                if(a >= n_i || b >= n_j || (ti == tj && b <= a) || e->slot[a] < 0){
+                    r->intercept = r->slope = r->se = r->t = r->p = r->nlog10p = NAN;
+                    continue;
+                }
+                s = (size_t)b * e->tile + a;
+                scan_fit(y->n[k], e->s1[s], e->s2[s], e->s3[(size_t)b * e->tile + e->slot[a]],
+                         y->mean[k], y->syy[k], EPISTASIS_TOL, r);
+            }
+        }
+        scan_test_trait(y, k, e->tile * e->tile, e->r);
+    }
+
+    e->n_pair += n_tile_pair;
+}
+
+/*
+ * write_pair
+ *   DESCRIPTION: Writes one test of markers a and b and trait k in the
+ *                scan_write format, naming the pair "a*b".
+ */
+static void write_pair(FILE* f, const scan_result* r, int a, int b, int k,
+                       const scan_trait* y, const name_table* marker, const name_table* trait){
+
+    char p[TDIST_PVALUE_CHARS];
+
+    fprintf(f, "%s*%s\t%s\t%g\t%g\t%g\t%g\t%s\t%g\n",
+            name_table_get(marker, a), name_table_get(marker, b),
+            name_table_get(trait, y->index[k]),
+            r->intercept, r->slope, r->se, r->t,
+            tdist_format_pvalue(p, r->p, r->nlog10p), r->nlog10p);
+}
+
+/*
+ * epistasis_write
+ *   DESCRIPTION: Writes the results of a tile pair in the scan_write
+ *                format, naming each pair "a*b".
+ *   INPUTS: e      -- pointer to epistasis.
+ *           r      -- results of tile pair (ti, tj), laid out as e->r.
+ *           f      -- output stream.
+ *           ti, tj -- tile pair of r.
+ *           marker -- marker names.
+ *           trait  -- trait names of the phenotype.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to f.
+ */
+void epistasis_write(const epistasis* e, const scan_result* r, FILE* f, int ti, int tj,
+                     const name_table* marker, const name_table* trait){
+
+    const scan_trait* y = e->y;
+    const scan_result* q = NULL;
+    int i0 = ti * e->tile;
+    int j0 = tj * e->tile;
+    int a, b, k;                /* Loop variables. */
+
+    for(a = 0; a < e->tile && i0 + a < e->n_marker; a++){
+        for(b = (ti == tj) ? a + 1 : 0; b < e->tile && j0 + b < e->n_marker; b++){
+            q = r + ((size_t)a * e->tile + b) * y->n_trait;
+            for(k = 0; k < y->n_trait; k++){
+                if(y->threshold > 0.0 && !(q[k].p <= y->threshold))
+                    continue;
+                write_pair(f, &q[k], i0 + a, j0 + b, k, y, marker, trait);
+            }
+        }
+    }
+}
+
+/*
+ * prune_report
+ *   DESCRIPTION: Writes the share of pair tests the bounds skipped.
+ */
+static void prune_report(long n_pruned, long n_test){
+    fprintf(stderr, "Pruned: %ld of %ld pair tests (%.1f%%)\n",
+            n_pruned, n_test, (n_test > 0) ? 100.0 * n_pruned / n_test : 0.0);
+}
+
+/* Threads and tile pairs of a pairwise scan. */
+typedef struct {
+    sched* sd;
+    epistasis** e;              /* Tile buffers of each thread.        */
+    result_set** s;             /* Kept tests of each thread (collect). */
+    pair_bound* bound;          /* Shared by the threads, read only.   */
+    bitgeno* bits;
+    int n_threads;
+
+    const int* pair;            /* Tile pairs ti * n_tile + tj.        */
+    int* own;                   /* Lexicographic order (scan).         */
+    int n_tile;
+    long first;                 /* Task t is pair[first + t * step].   */
+    long step;
+    long base;                  /* First tile pair of the batch (scan). */
+    scan_result* out;           /* Results of each pair of the batch.  */
+    int* kept;                  /* With a threshold, out holds only the
+                                   tests at or below it, and kept their
+                                   places in e->r (scan).              */
+    int* n_kept;                /* Tests kept of each pair of the batch. */
+    const double* start;        /* |t| the tests already kept need.    */
+    const double* hit;          /* Critical |t| of the hit list.       */
+} epistasis_run;
+
+/*
+ * run_open
+ *   DESCRIPTION: Sets up the scheduler, the tile buffers of every thread
+ *                and the shared packed dosages and bounds of a scan.
+ *   INPUTS: w         -- zeroed epistasis_run.
+ *           x         -- first marker column.
+ *           ldx       -- leading dimension of x.
+ *           n_marker  -- number of markers.
+ *           st        -- statistics of the markers.
+ *           y         -- centered traits (read only).
+ *           n_threads -- number of threads.
+ *           tile      -- markers per tile side.
+ *           bounded   -- whether to build the bounds.
+ *   OUTPUTS: w
+ *   RETURN VALUE: (0) on success, (1) on failure (run_close still frees).
+ *   SIDE EFFECTS: Allocates the members of w.
+ */
+static int run_open(epistasis_run* w, const float* x, int ldx, int n_marker, const marker_stats* st,
+                    scan_trait* y, int n_threads, int tile, int bounded){
+
+    int k = 0;                  /* Loop variable. */
+
+    w->n_threads = (n_threads < 1) ? 1 : n_threads;
+    w->n_tile = (n_marker + tile - 1) / tile;
+    if((w->sd = sched_create(w->n_threads)) == NULL)
+        return 1;
+    if((w->e = (epistasis**)calloc(w->n_threads, sizeof(epistasis*))) == NULL){
+        fprintf(stderr, "cannot allocate memory: epistasis threads\n");
+        return 1;
+    }
+    if(bounded && (w->bound = pair_bound_create(x, ldx, n_marker, st, y, tile)) == NULL)
+        return 1;
+    w->bits = pack_dosages(x, ldx, n_marker, y->n_individual);
+    for(k = 0; k < w->n_threads; k++){
+        if((w->e[k] = epistasis_create(x, ldx, n_marker, st, y, tile)) == NULL)
+            return 1;
+        w->e[k]->bound = w->bound;
+        w->e[k]->bits = w->bits;
+    }
+
+    return 0;
+}
+
+/*
+ * run_close
+ *   DESCRIPTION: Deallocates the members of an epistasis_run.
+ */
+static void run_close(epistasis_run* w){
+
+    int k = 0;                  /* Loop variable. */
+
+    for(k = 0; w->e != NULL && k < w->n_threads; k++)
+        free_epistasis(w->e[k]);
+    for(k = 0; w->s != NULL && k < w->n_threads; k++)
+        free_result_set(w->s[k]);
+    free(w->e);
+    free(w->s);
+    free(w->own);
+    free(w->out);
+    free(w->kept);
+    free(w->n_kept);
+    free_pair_bound(w->bound);
+    free_bitgeno(w->bits);
+    free_sched(w->sd);
+}
+
+/*
+ * run_report
+ *   DESCRIPTION: Writes the pairs, time and pruning of a scan over every
+ *                rank, and the load of the threads of rank 0.
+ *   INPUTS: w     -- epistasis_run after the scan.
+ *           y     -- traits.
+ *           start -- wall_time at the start of the scan.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Collective; writes to stderr on rank 0.
+ */
+static void run_report(const epistasis_run* w, const scan_trait* y, double start){
+
+    double elapsed = 0.0;
+    long n_pair = 0;
+    long n_pruned = 0;
+    int k = 0;                  /* Loop variable. */
+
+    for(k = 0; k < w->n_threads; k++){
+        n_pair += w->e[k]->n_pair;
+        n_pruned += w->e[k]->n_pruned;
+    }
+    n_pair = dist_sum(n_pair);
+    n_pruned = dist_sum(n_pruned);
+    k = (int)dist_sum(w->n_threads);
+    elapsed = wall_time() - start;
+    if(dist_rank() == 0){
+        fprintf(stderr, "Pairs: %ld x %d traits on %d threads over %d ranks\n"
+                "Epistasis time: %.3f s (%.3g pairs/s)\n", n_pair, y->n_trait, k,
+                dist_size(), elapsed, (elapsed > 0.0) ? n_pair / elapsed : 0.0);
+        if(w->bound != NULL)
+            prune_report(n_pruned, n_pair * y->n_trait);
+        sched_report(w->sd, stderr);
+    }
+}
+
+/*
+ * keep_tile
+ *   DESCRIPTION: Copies the tests of the last tile that epistasis_write
+ *                would write, with their places in e->r.
+ *   INPUTS: e      -- pointer to epistasis.
+ *           ti, tj -- tile pair of e->r.
+ *   OUTPUTS: out   -- tests kept.
+ *            index -- place of each in e->r.
+ *   RETURN VALUE: Number of tests kept.
+ *   SIDE EFFECTS: None.
+ */
+static int keep_tile(const epistasis* e, int ti, int tj, scan_result* out, int* index){
+
+    const scan_trait* y = e->y;
+    const scan_result* q = NULL;
+    int i0 = ti * e->tile;
+    int j0 = tj * e->tile;
+    int n = 0;
+    int a, b, k;                /* Loop variables. */
+
+    for(a = 0; a < e->tile && i0 + a < e->n_marker; a++){
+        for(b = (ti == tj) ? a + 1 : 0; b < e->tile && j0 + b < e->n_marker; b++){
+            q = e->r + ((size_t)a * e->tile + b) * y->n_trait;
+            for(k = 0; k < y->n_trait; k++){
+                if(!(q[k].p <= y->threshold))
+                    continue;
+                out[n] = q[k];
+                index[n++] = (a * e->tile + b) * y->n_trait + k;
+            }
+        }
+    }
+
+    return n;
+}
+
+/*
+ * write_kept
+ *   DESCRIPTION: epistasis_write for the n tests of tile pair (ti, tj)
+ *                kept by keep_tile.
+ */
+static void write_kept(const epistasis* e, const scan_result* r, const int* index, int n,
+                       FILE* f, int ti, int tj, const name_table* marker, const name_table* trait){
+
+    int n_trait = e->y->n_trait;
+    int i = 0;                  /* Loop variable. */
+
+    for(i = 0; i < n; i++)
+        write_pair(f, &r[i], ti * e->tile + index[i] / n_trait / e->tile,
+                   tj * e->tile + index[i] / n_trait % e->tile, index[i] % n_trait,
+                   e->y, marker, trait);
+}
+
+/*
+ * scan_task
+ *   DESCRIPTION: Task of epistasis_scan: fits one tile pair of the batch
+ *                and copies its results, or with a threshold the tests
+ *                it keeps, to the batch buffer.
+ */
+static void scan_task(void* arg, int thread, long task){
+
+    epistasis_run* w = (epistasis_run*)arg;
+    epistasis* e = w->e[thread];
+    size_t n_r = (size_t)e->tile * e->tile * e->y->n_trait;
+    long p = w->first + task * w->step;
+
+    epistasis_tile(e, w->pair[p] / w->n_tile, w->pair[p] % w->n_tile);
+    if(w->kept != NULL)
+        w->n_kept[p - w->base] = keep_tile(e, w->pair[p] / w->n_tile, w->pair[p] % w->n_tile,
+                                           w->out + (size_t)(p - w->base) * n_r,
+                                           w->kept + (size_t)(p - w->base) * n_r);
+    else
+        memcpy(w->out + (size_t)(p - w->base) * n_r, e->r, n_r * sizeof(scan_result));
+}
+
+/*
+ * epistasis_scan
+ *   DESCRIPTION: Visits every tile pair ti <= tj on n_threads threads and
+ *                writes the results in order, reporting pairs per second.
+ *                Tile pairs go in batches of EPISTASIS_BATCH per thread;
+ *                within a batch, the scheduler balances the uneven tiles.
+ *   INPUTS: x         -- first marker column.
+ *           ldx       -- leading dimension of x.
+ *           n_marker  -- number of markers.
+ *           st        -- statistics of the markers.
+ *           y         -- centered traits (read only).
+ *           n_threads -- number of threads.
+ *           tile      -- markers per tile side, a multiple of
+ *                        EPISTASIS_GROUP.
+ *           f         -- output stream.
+ *           marker    -- marker names.
+ *           trait     -- trait names of the phenotype.
+ *           ck        -- checkpoint to resume from and save to, NULL for
+ *                        none.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f and stderr; updates ck.
+ */
+int epistasis_scan(const float* x, int ldx, int n_marker, const marker_stats* st,
+                   scan_trait* y, int n_threads, int tile, FILE* f,
+                   const name_table* marker, const name_table* trait, checkpoint* ck){
+
+    epistasis_run w;
+    double start = wall_time(); /* Scan timer.       */
+    size_t n_r = (size_t)tile * tile * y->n_trait;
+    long n_order = 0;
+    long batch = 0;             /* Tile pairs per batch. */
+    long p0, p1, p;             /* Tile pair counters.   */
+    size_t q = 0;               /* Start of pair p in the batch. */
+    int owner = 0;              /* Rank of pair p.       */
+    int rank = dist_rank();
+    int n_rank = dist_size();
+    int failed = 0;             /* Rank 0 cannot checkpoint f. */
+    int status = 1;
+    int ti, tj, k;              /* Loop variables.       */
+
+    memset(&w, 0, sizeof(w));
+    /* Only a threshold allows pruning. */
+    if(run_open(&w, x, ldx, n_marker, st, y, n_threads, tile, y->threshold > 0.0))
+        goto done;
+    for(k = 0; w.bound != NULL && k < w.n_threads; k++)
+        memcpy(w.e[k]->need, y->t_crit, y->n_trait * sizeof(double));
+
+    n_order = (long)w.n_tile * (w.n_tile + 1) / 2;
+    batch = (long)EPISTASIS_BATCH * w.n_threads;
+    if((w.own = (int*)malloc(((n_order > 0) ? n_order : 1) * sizeof(int))) == NULL ||
+       (w.out = (scan_result*)malloc(batch * n_r * sizeof(scan_result))) == NULL ||
+       (y->threshold > 0.0 &&
+        ((w.kept = (int*)malloc(batch * n_r * sizeof(int))) == NULL ||
+         (w.n_kept = (int*)calloc(batch, sizeof(int))) == NULL))){
+        fprintf(stderr, "cannot allocate memory: epistasis batch\n");
+        goto done;
+    }
+    for(ti = 0, p = 0; ti < w.n_tile; ti++)
+        for(tj = ti; tj < w.n_tile; tj++)
+            w.own[p++] = ti * w.n_tile + tj;
+    w.pair = w.own;
+    w.step = n_rank;
+
+    /* Tile pairs are dealt round-robin over the ranks; rank 0 writes them in order. */
+    for(p0 = (ck != NULL && ck->stage == CHECKPOINT_PAIRS) ? ck->done : 0; p0 < n_order; p0 += batch){
+        p1 = (p0 + batch < n_order) ? p0 + batch : n_order;
+        w.base = p0;
+        w.first = p0 + ((rank - p0 % n_rank) + n_rank) % n_rank;
+        if(sched_run(w.sd, (p1 > w.first) ? (p1 - w.first + n_rank - 1) / n_rank : 0, scan_task, &w))
+            goto done;
+        for(p = p0; p < p1; p++){
+            q = (size_t)(p - p0) * n_r;
+            owner = (int)(p % n_rank);
+            ti = w.pair[p] / w.n_tile;
+            tj = w.pair[p] % w.n_tile;
+            if(w.kept == NULL){
+                if(dist_to_root(w.out + q, n_r * sizeof(scan_result), owner))
+                    goto done;
+                if(rank == 0)
+                    epistasis_write(w.e[0], w.out + q, f, ti, tj, marker, trait);
+            }
+            /* With a threshold, only the tests at or below it leave the owner. */
+            else{
+                if(dist_to_root(&w.n_kept[p - p0], sizeof(int), owner) ||
+                   dist_to_root(w.kept + q, w.n_kept[p - p0] * sizeof(int), owner) ||
+                   dist_to_root(w.out + q, w.n_kept[p - p0] * sizeof(scan_result), owner))
+                    goto done;
+                if(rank == 0)
+                    write_kept(w.e[0], w.out + q, w.kept + q, w.n_kept[p - p0], f, ti, tj, marker, trait);
+            }
+        }
+
+        /* The batches so far are the bytes of f written so far. */
+        if(ck != NULL && p1 < n_order && dist_agree(checkpoint_due(ck))){
+            if(rank == 0){
+                if(fflush(f) != 0 || (ck->offset = ftell(f)) < 0){
+                    fprintf(stderr, "cannot checkpoint the output\n");
+                    failed = 1;
+                }
+                ck->stage = CHECKPOINT_PAIRS;
+                ck->done = p1;
+            }
+            if(dist_agree(failed || checkpoint_save(ck)))
+                goto done;
+        }
+    }
+
+    run_report(&w, y, start);
+    status = 0;
+
+done:
+    run_close(&w);
+
+    return status;
+}
+
+/*
+ * collect_tile
+ *   DESCRIPTION: Offers the results of the last tile to a result_set.
+ *   INPUTS: e      -- pointer to epistasis.
+ *           ti, tj -- tile pair of e->r.
+ *           s      -- result_set.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s.
+ */
+static void collect_tile(const epistasis* e, int ti, int tj, result_set* s){
+
+    const scan_result* r = NULL;
+    int n_trait = e->y->n_trait;
+    int i0 = ti * e->tile;
+    int j0 = tj * e->tile;
+    int a, b, k;                /* Loop variables. */
+
+    for(a = 0; a < e->tile && i0 + a < e->n_marker; a++){
+        for(b = (ti == tj) ? a + 1 : 0; b < e->tile && j0 + b < e->n_marker; b++){
+            r = e->r + ((size_t)a * e->tile + b) * n_trait;
+            for(k = 0; k < n_trait; k++)
+                result_add(s, i0 + a, j0 + b, k, &r[k]);
+        }
+    }
+}
+
+/*
+ * collect_task
+ *   DESCRIPTION: Task of epistasis_collect: one tile pair of the bound
+ *                order. Before the tile, the need of a trait is the |t| a
+ *                test needs to enter the thread's heap (no less than
+ *                start) or the hit list.
+ */
+static void collect_task(void* arg, int thread, long task){
+
+    epistasis_run* w = (epistasis_run*)arg;
+    epistasis* e = w->e[thread];
+    result_set* s = w->s[thread];
+    long p = w->first + task * w->step;
+    int ti = w->pair[p] / w->n_tile;
+    int tj = w->pair[p] % w->n_tile;
+    int k = 0;                  /* Loop variable. */
+
+    for(k = 0; k < s->n_trait; k++)
+        e->need[k] = fmin(fmax(result_floor(s, k), w->start[k]), w->hit[k]);
+    epistasis_tile(e, ti, tj);
+    collect_tile(e, ti, tj, s);
+}
+
+/*
+ * collect_checkpoint
+ *   DESCRIPTION: Saves the tests kept so far by every thread and rank,
+ *                with the tile pairs of the bound order they account for.
+ *   INPUTS: w    -- epistasis_run of the scan.
+ *           out  -- result_set of the scan.
+ *           ck   -- checkpoint.
+ *           done -- tile pairs finished.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective; updates ck on rank 0.
+ */
+static int collect_checkpoint(const epistasis_run* w, const result_set* out, checkpoint* ck, long done){
+
+    result_set* snap = NULL;    /* Merge of out and the thread sets. */
+    int status = 0;
+    int k = 0;                  /* Loop variable. */
+
+    if((snap = result_set_create(out->n_trait, out->top, out->threshold)) == NULL)
+        return 1;
+    status |= result_merge(snap, out);
+    for(k = 0; k < w->n_threads; k++)
+        status |= result_merge(snap, w->s[k]);
+    snap->status |= status;
+    status = dist_reduce_results(snap);
+    if(dist_rank() == 0 && !status){
+        free_result_set(ck->kept);
+        ck->kept = snap;
+        snap = NULL;
+        ck->stage = CHECKPOINT_PAIRS;
+        ck->done = done;
+        ck->offset = 0;
+        status = checkpoint_save(ck);
+    }
+    free_result_set(snap);
+
+    return dist_agree(status) != 0;
+}
+
+/*
+ * epistasis_collect
+ *   DESCRIPTION: Visits every tile pair ti <= tj on n_threads threads and
+ *                keeps the top tests and hits in out instead of writing
+ *                every pair. Tile pairs go strongest first through the
+ *                scheduler, and the rows of a tile whose bound is below
+ *                the |t| a trait needs are not fitted. Each thread has its
+ *                own tile buffers and result_set, so the threads share
+ *                nothing they write until the sets are merged after the
+ *                run.
+ *   INPUTS: x         -- first marker column.
+ *           ldx       -- leading dimension of x.
+ *           n_marker  -- number of markers.
+ *           st        -- statistics of the markers.
+ *           y         -- centered traits (read only).
+ *           n_threads -- number of threads.
+ *           tile      -- markers per tile side, a multiple of
+ *                        EPISTASIS_GROUP.
+ *           out       -- result_set to add to.
+ *           ck        -- checkpoint to resume from and save to, NULL for
+ *                        none.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Updates out; writes to stderr; updates ck.
+ */
+int epistasis_collect(const float* x, int ldx, int n_marker, const marker_stats* st,
+                      scan_trait* y, int n_threads, int tile, result_set* out, checkpoint* ck){
+
+    epistasis_run w;
+    double* need = NULL;        /* Start and hit |t| of the traits.  */
+    double start = wall_time(); /* Scan timer.      */
+    int rank = dist_rank();
+    int n_rank = dist_size();
+    long n_order = 0;
+    long round = 0;             /* Tile pairs between checkpoints. */
+    long p0, p1;                /* Tile pair counters.   */
+    int status = 1;
+    int k = 0;                  /* Loop variable.   */
+
+    memset(&w, 0, sizeof(w));
+    if(run_open(&w, x, ldx, n_marker, st, y, n_threads, tile, 1))
+        goto done;
+    if((need = (double*)malloc(2 * (size_t)y->n_trait * sizeof(double))) == NULL ||
+       (w.s = (result_set**)calloc(w.n_threads, sizeof(result_set*))) == NULL){
+        fprintf(stderr, "cannot allocate memory: epistasis thresholds\n");
+        goto done;
+    }
+    /* Tests already kept in out (the single markers) settle the start. */
+    for(k = 0; k < y->n_trait; k++){
+        need[k] = (out->top > 0) ? result_floor(out, k) : INFINITY;
+        need[y->n_trait + k] = (out->threshold > 0.0) ? y->t_crit[k] : INFINITY;
+    }
+    for(k = 0; k < w.n_threads; k++)
+        if((w.s[k] = result_set_create(out->n_trait, out->top, out->threshold)) == NULL)
+            goto done;
+    w.start = need;
+    w.hit = need + y->n_trait;
+
+    /*
+     * This rank's share of the bound order: pairs rank, rank + n_rank, ...
+     * With checkpoints, in rounds of EPISTASIS_ROUND per thread.
+     */
+    n_order = w.bound->n_order;
+    w.pair = w.bound->order;
+    w.step = n_rank;
+    round = (ck != NULL) ? EPISTASIS_ROUND * dist_sum(w.n_threads) : n_order;
+    for(p0 = (ck != NULL && ck->stage == CHECKPOINT_PAIRS) ? ck->done : 0; p0 < n_order; p0 += round){
+        p1 = (p0 + round < n_order) ? p0 + round : n_order;
+        w.first = p0 + ((rank - p0 % n_rank) + n_rank) % n_rank;
+        if(sched_run(w.sd, (p1 > w.first) ? (p1 - w.first + n_rank - 1) / n_rank : 0, collect_task, &w))
+            goto done;
+        if(ck != NULL && p1 < n_order && dist_agree(checkpoint_due(ck)) &&
+           collect_checkpoint(&w, out, ck, p1))
+            goto done;
+    }
+
+    status = 0;
+    for(k = 0; k < w.n_threads; k++)
+        status |= result_merge(out, w.s[k]);
+    run_report(&w, y, start);
+
+done:
+    run_close(&w);
+    free(need);
+
+    return status;
+}
+
+/*
+ * free_epistasis
+ *   DESCRIPTION: Deallocates memory associated with an epistasis.
+ *   INPUTS: e -- pointer to epistasis.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates an epistasis (x and y are untouched).
+ */
+void free_epistasis(epistasis* e){
+    if(e != NULL){
+        free(e->aa);
+        free(e->bb);
+        free(e->bw);
+        free(e->s1);
+        free(e->s2);
+        free(e->s3);
+        free(e->r);
+        free(e->ai);
+        free(e->aj);
+        free(e->sa);
+        free(e->xl);
+        free(e->live);
+        free(e->slot);
+        free(e->need);
+        free(e->mask);
+        free(e->work);
+        free(e);
+    }
+}
@@ -0,0 +1,282 @@
+/* Epistasis Scan : Header File */
+
+#ifndef EPISTASIS_H
+#define EPISTASIS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "mkl.h"
+#include "bitgeno.h"
+#include "checkpoint.h"
+#include "markerstats.h"
+#include "names.h"
+#include "results.h"
+#include "scan.h"
+#include "scheduler.h"
+
+/*
+ * Default markers per tile side; a pair of tiles stays in cache. The side
+ * is a run option (-tile), a multiple of EPISTASIS_GROUP.
+ */
+#define EPISTASIS_TILE 64
+
+/* Tile pairs per thread that a full scan computes before writing them. */
+#define EPISTASIS_BATCH 16
+
+/* Tile pairs per thread between the checkpoints of a collecting scan. */
+#define EPISTASIS_ROUND 256
+
+/* Relative size below which a product column counts as constant. */
+#define EPISTASIS_TOL 1e-5
+
+/*
+ * Relative margin a tile bound must stay below the needed |t| by, so that
+ * float rounding of the tile sums never prunes a test that would pass.
+ */
+#define EPISTASIS_SLACK 1e-3
+
+/* Markers per anchor group; groups of neighbouring markers share an anchor. */
+#define EPISTASIS_GROUP 2
+
+/*
+ * Bounds of the pairwise statistics of a set of traits. Every marker a has
+ * an anchor alpha, the member of its group of EPISTASIS_GROUP neighbours
+ * nearest the others, so d_a = x_a - x_alpha is small where markers are in
+ * LD. For
+ * a pair (a, b) with anchors (alpha, beta),
+ *     x_a o x_b = x_alpha o x_beta + d_a o x_b + x_alpha o d_b,
+ * and with pd[a], nd[a] the sums of the positive and negative parts of
+ * d_a o yc for trait k and every x_b in [lo[b], hi[b]] (from the marker
+ * statistics),
+ *     |(d_a o yc)^T x_b| <= max(hi_b pd_a - lo_b nd_a, hi_b nd_a - lo_b pd_a).
+ * So |(x_a o x_b)^T yc| is at most the exact anchor term plus two of these.
+ * A tile pair needs the anchor terms of its EPISTASIS_TILE / EPISTASIS_GROUP
+ * anchors per side, a small product next to the tile's own; with the exact
+ * centered sum of squares of x_a o x_b from the trait-free tile sums, that
+ * bounds |t| of every pair of the tile, and the rows of tile I with no
+ * pair that can reach the |t| a trait needs leave that trait's product.
+ * order lists the tile pairs by
+ * decreasing strength of their best single markers, so strong tiles come
+ * first and running thresholds rise early.
+ */
+typedef struct {
+    int n_marker;
+    int n_trait;
+    double* pd;                 /* pd[k * n_marker + a]                */
+    double* nd;
+    const float* lo;            /* Smallest and largest value of each  */
+    const float* hi;            /* marker, in the marker_stats.        */
+    int* anchor;                /* Anchor of each marker.              */
+    int tile;                   /* Markers per tile side.              */
+    int n_tile;
+    int* order;                 /* Tile pairs ti * n_tile + tj, ti <= tj. */
+    long n_order;
+} pair_bound;
+
+/*
+ * Pairwise scan of y = intercept + slope * (x_a o x_b) for every pair of
+ * markers a < b. Product columns are never formed: for a tile pair
+ * (I, J) of marker blocks, the sums the single-predictor fit needs are
+ *     sum   x_a x_b       = X_I^T * X_J
+ *     sum  (x_a x_b)^2    = (X_I o X_I)^T * (X_J o X_J)
+ *     sum   x_a x_b yc    = X_I^T * diag(yc) * X_J
+ * so a tile pair costs three GEMMs (two more per trait when trait values
+ * are missing). When every genotype value is a 0/1/2 dosage, the first two
+ * sums are exact popcounts over a bitgeno instead, masked by the observed
+ * individuals of a trait where values are missing. Only tiles with I <= J
+ * are visited, and only a < b within diagonal tiles.
+ */
+typedef struct {
+    const float* x;             /* Genotype slab.                      */
+    int ldx;
+    int n_marker;
+    int n_individual;
+    const marker_stats* st;     /* Statistics of the markers of x.     */
+    scan_trait* y;              /* Centered traits.                    */
+    int tile;                   /* Markers per tile side.              */
+    int n_tile;                 /* Tiles per side.                     */
+
+    float* aa;                  /* X_I o X_I                           */
+    float* bb;                  /* X_J o X_J                           */
+    float* bw;                  /* X_J (or X_J o X_J) scaled by rows.  */
+    float* s1;                  /* Tile sums, tile squared.            */
+    float* s2;
+    float* s3;
+    scan_result* r;             /* Tile results, r[(a * tile + b) * n_trait + t]. */
+    float* ai;                  /* Anchors of tile I.                  */
+    float* aj;                  /* Anchors of tile J scaled by yc.     */
+    float* sa;                  /* Anchor terms of the tile pair.      */
+    float* xl;                  /* Rows of tile I a trait still needs. */
+    int* live;                  /* Their markers in the tile.          */
+    int* slot;                  /* Column of each row in xl, -1: none. */
+
+    const bitgeno* bits;        /* Packed dosages, NULL for none.      */
+    uint64_t* mask;             /* Observed individuals of each trait,
+                                   NULL when no value is missing.      */
+    uint64_t* work;             /* Masked planes of one marker.        */
+
+    const pair_bound* bound;    /* Tile bounds, NULL for none.         */
+    double* need;              /* |t| a test of each trait must reach
+                                   to be kept, 0 for every test.       */
+
+    long n_pair;                /* Pairs fitted so far.                */
+    long n_pruned;              /* Pair tests skipped by the bound.    */
+} epistasis;
+
+
+
+/*
+ * pair_bound_create
+ *   DESCRIPTION: Per-marker bounds and tile order of a pairwise scan.
+ *   INPUTS: x        -- first marker column.
+ *           ldx      -- leading dimension of x.
+ *           n_marker -- number of markers.
+ *           st       -- statistics of the markers.
+ *           y        -- centered traits.
+ *           tile     -- markers per tile side.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated pair_bound, NULL on failure.
+ *   SIDE EFFECTS: Allocates a pair_bound; one pass over the genotype.
+ */
+pair_bound* pair_bound_create(const float* x, int ldx, int n_marker, const marker_stats* st,
+                              const scan_trait* y, int tile);
+
+/*
+ * free_pair_bound
+ *   DESCRIPTION: Deallocates memory associated with a pair_bound.
+ *   INPUTS: b -- pointer to pair_bound.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a pair_bound (lo and hi stay with the
+ *                 marker_stats).
+ */
+void free_pair_bound(pair_bound* b);
+
+/*
+ * epistasis_create
+ *   DESCRIPTION: Sets up a pairwise scan over an in-memory genotype slab.
+ *   INPUTS: x        -- first marker column.
+ *           ldx      -- leading dimension of x.
+ *           n_marker -- number of markers.
+ *           st       -- statistics of the markers.
+ *           y        -- centered traits (also gives the individuals).
+ *           tile     -- markers per tile side, a multiple of
+ *                       EPISTASIS_GROUP.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated epistasis, NULL on failure.
+ *   SIDE EFFECTS: Allocates tile buffers.
+ */
+epistasis* epistasis_create(const float* x, int ldx, int n_marker, const marker_stats* st,
+                            scan_trait* y, int tile);
+
+/*
+ * epistasis_tile
+ *   DESCRIPTION: Fits every pair of tile pair (ti, tj), ti <= tj, for
+ *                every trait, p-values included. With e->bound, rows
+ *                whose bound is below e->need of a trait are not fitted.
+ *   INPUTS: e  -- pointer to epistasis.
+ *           ti -- row tile.
+ *           tj -- column tile.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Fills e->r (pairs outside the upper triangle and pruned
+ *                 pairs get NAN).
+ */
+void epistasis_tile(epistasis* e, int ti, int tj);
+
+/*
+ * epistasis_write
+ *   DESCRIPTION: Writes the results of a tile pair in the scan_write
+ *                format, naming each pair "a*b".
+ *   INPUTS: e      -- pointer to epistasis.
+ *           r      -- results of tile pair (ti, tj), laid out as e->r.
+ *           f      -- output stream.
+ *           ti, tj -- tile pair of r.
+ *           marker -- marker names.
+ *           trait  -- trait names of the phenotype.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to f.
+ */
+void epistasis_write(const epistasis* e, const scan_result* r, FILE* f, int ti, int tj,
+                     const name_table* marker, const name_table* trait);
+
+/*
+ * epistasis_scan
+ *   DESCRIPTION: Visits every tile pair ti <= tj on n_threads threads and
+ *                writes the results in order, reporting pairs per second.
+ *                With a threshold, rows of a tile whose bound is below the
+ *                critical |t| are skipped. Tile pairs go through the
+ *                scheduler in batches of EPISTASIS_BATCH per thread. With
+ *                several MPI ranks, tile pairs are dealt round-robin and
+ *                rank 0 receives and writes them in order; with a
+ *                threshold, a rank sends only the tests at or below it.
+ *   INPUTS: x         -- first marker column.
+ *           ldx       -- leading dimension of x.
+ *           n_marker  -- number of markers.
+ *           st        -- statistics of the markers.
+ *           y         -- centered traits (read only).
+ *           n_threads -- number of threads.
+ *           tile      -- markers per tile side, a multiple of
+ *                        EPISTASIS_GROUP.
+ *           f         -- output stream (rank 0).
+ *           marker    -- marker names.
+ *           trait     -- trait names of the phenotype.
+ *           ck        -- checkpoint to resume from and save to, NULL for
+ *                        none. A checkpoint holds the batches written and
+ *                        the bytes of f they take.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f and stderr; updates ck.
+ */
+int epistasis_scan(const float* x, int ldx, int n_marker, const marker_stats* st,
+                   scan_trait* y, int n_threads, int tile, FILE* f,
+                   const name_table* marker, const name_table* trait, checkpoint* ck);
+
+/*
+ * epistasis_collect
+ *   DESCRIPTION: Visits every tile pair ti <= tj on n_threads threads and
+ *                keeps the top tests and hits in out instead of writing
+ *                every pair. Tile pairs go strongest first through the
+ *                work-stealing scheduler, and the rows of a tile whose
+ *                bound is below the |t| a trait needs to enter the
+ *                thread's heap (or out's, whichever is higher) or the hit
+ *                list are not fitted. Each thread has its own tile buffers
+ *                and result_set, so the threads share nothing they write
+ *                until the sets are merged after the run. With several MPI
+ *                ranks, tile pairs are dealt round-robin over the ranks
+ *                and each rank adds its share to its own out, for
+ *                dist_reduce_results.
+ *   INPUTS: x         -- first marker column.
+ *           ldx       -- leading dimension of x.
+ *           n_marker  -- number of markers.
+ *           st        -- statistics of the markers.
+ *           y         -- centered traits (read only).
+ *           n_threads -- number of threads.
+ *           tile      -- markers per tile side, a multiple of
+ *                        EPISTASIS_GROUP.
+ *           out       -- result_set to add to.
+ *           ck        -- checkpoint to resume from and save to, NULL for
+ *                        none. Tile pairs then go in rounds of
+ *                        EPISTASIS_ROUND per thread, and a checkpoint
+ *                        holds the rounds done and the tests kept by
+ *                        every rank so far, which a resumed run starts
+ *                        from in out of rank 0.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Updates out; writes to stderr; updates ck.
+ */
+int epistasis_collect(const float* x, int ldx, int n_marker, const marker_stats* st,
+                      scan_trait* y, int n_threads, int tile, result_set* out, checkpoint* ck);
+
+/*
+ * free_epistasis
+ *   DESCRIPTION: Deallocates memory associated with an epistasis.
+ *   INPUTS: e -- pointer to epistasis.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates an epistasis (x and y are untouched).
+ */
+void free_epistasis(epistasis* e);
+
+#endif
@@ -0,0 +1,259 @@
+/* Fast Input : Function Definition File */
+
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fastio.h"
+
+/* Longest token handed to the strtod fallback. */
+#define MAX_NUMBER_LEN 64
+
+/* Exactly representable powers of ten. */
+static const double pow10_table[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * map_file
+ *   DESCRIPTION: Maps a whole file into memory. The mapping is private
+ *                copy-on-write, so writes never reach the file.
+ *   INPUTS: fileName -- name of file to be mapped.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated mapped_file struct, NULL on failure.
+ *   SIDE EFFECTS: Allocates a mapped_file struct and creates a mapping.
+ */
+mapped_file* map_file(char* fileName){
+
+    int fd = -1;                /* File descriptor.  */
+    struct stat st;             /* File status.      */
+    mapped_file* m = NULL;      /* Return argument.  */
+    void* data = NULL;
+
+    /* Open file error handling. */
+    if((fd = open(fileName, O_RDONLY)) < 0){
+        fprintf(stderr, "file \"%s\" does not exist\n", fileName);
+        return NULL;
+    }
+
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        fprintf(stderr, "file \"%s\" is empty or unreadable\n", fileName);
+        close(fd);
+        return NULL;
+    }
+
+    if((data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) == MAP_FAILED){
+        fprintf(stderr, "cannot map file \"%s\"\n", fileName);
+        close(fd);
+        return NULL;
+    }
+
+    /* The mapping stays valid after the descriptor is closed. */
+    close(fd);
+
+    /* Files are read front to back. */
+    posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    if((m = (mapped_file*)malloc(sizeof(mapped_file))) == NULL){
+        fprintf(stderr, "cannot allocate memory: mapped_file*\n");
+        munmap(data, (size_t)st.st_size);
+        return NULL;
+    }
+
+    m->data = (char*)data;
+    m->size = (size_t)st.st_size;
+
+    return m;
+}
+
+/*
+ * unmap_file
+ *   DESCRIPTION: Releases a mapping created by map_file.
+ *   INPUTS: m -- pointer to mapped_file struct.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Unmaps the file and deallocates the struct.
+ */
+void unmap_file(mapped_file* m){
+    if(m != NULL){
+        if(m->data != NULL)
+            munmap(m->data, m->size);
+        free(m);
+    }
+}
+
+/*
+ * wall_time
+ *   DESCRIPTION: Reads a monotonic clock, used for reporting load and scan times.
+ *   INPUTS: None.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Time in seconds.
+ *   SIDE EFFECTS: None.
+ */
+double wall_time(void){
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/*
+ * fnv1a
+ *   DESCRIPTION: Adds bytes to a 64-bit FNV-1a hash, the one hash of
+ *                names, marker columns, cache and checkpoint fingerprints.
+ *   INPUTS: h     -- hash so far (FNV1A_SEED to start).
+ *           data  -- bytes.
+ *           bytes -- number of bytes.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: New hash.
+ *   SIDE EFFECTS: None.
+ */
+uint64_t fnv1a(uint64_t h, const void* data, size_t bytes){
+
+    const unsigned char* p = (const unsigned char*)data;
+    size_t i;                   /* Loop variable. */
+
+    for(i = 0; i < bytes; i++){
+        h ^= p[i];
+        h *= FNV1A_PRIME;
+    }
+
+    return h;
+}
+
+/*
+ * parse_float_slow
+ *   DESCRIPTION: strtod fallback for tokens the fast path does not handle
+ *                (long mantissas, large exponents, inf).
+ *   INPUTS: p   -- start of the token.
+ *           end -- end of the token.
+ *           out -- parsed value.
+ *   OUTPUTS: out
+ *   RETURN VALUE: Pointer just past the token, NULL if it is not a number.
+ *   SIDE EFFECTS: None.
+ */
+static const char* parse_float_slow(const char* p, const char* end, float* out){
+
+    char s[MAX_NUMBER_LEN];     /* NUL-terminated copy of the token. */
+    char* stop = NULL;
+    size_t len = (size_t)(end - p);
+
+    if(len == 0 || len >= MAX_NUMBER_LEN)
+        return NULL;
+
+    memcpy(s, p, len);
+    s[len] = '\0';
+
+    *out = (float)strtod(s, &stop);
+    if(stop != s + len)
+        return NULL;
+
+    return end;
+}
+
+/*
+ * parse_float
+ *   DESCRIPTION: Parses one decimal number starting at p without scanf.
+ *                Plain decimals with up to 19 significant digits take a
+ *                fast path; anything else falls back to strtod. "NA",
+ *                "NaN" and "." are read as NAN (missing).
+ *   INPUTS: p   -- start of the token.
+ *           end -- end of the buffer.
+ *           out -- parsed value.
+ *   OUTPUTS: out
+ *   RETURN VALUE: Pointer just past the token, NULL if it is not a number.
+ *   SIDE EFFECTS: None.
+ */
+const char* parse_float(const char* p, const char* end, float* out){
+
+    const char* start = p;          /* Token bounds.               */
+    const char* stop = skip_token(p, end);
+    unsigned long long mant = 0;    /* Decimal mantissa.           */
+    int digits = 0;                 /* Significant digits read.    */
+    int seen = 0;                   /* Mantissa digits read at all. */
+    int scale = 0;                  /* Power of ten of mantissa.   */
+    int expo = 0;                   /* Explicit exponent.          */
+    int neg = 0;
+    int eneg = 0;
+    double d = 0.0;
+
+    /* Missing values. */
+    if((stop - p == 2 && p[0] == 'N' && p[1] == 'A') ||
+       (stop - p == 3 && (p[0] == 'N' || p[0] == 'n') && (p[1] == 'a' || p[1] == 'A') &&
+        (p[2] == 'N' || p[2] == 'n')) ||
+       (stop - p == 1 && p[0] == '.')){
+        *out = NAN;
+        return stop;
+    }
+
+    if(p < stop && (*p == '-' || *p == '+')){
+        neg = (*p == '-');
+        p++;
+    }
+
+    if(p == stop)
+        return NULL;
+
+    /* Integer part. Leading zeros do not count as significant digits. */
+    while(p < stop && *p >= '0' && *p <= '9'){
+        if(digits < 19){
+            mant = mant * 10 + (unsigned long long)(*p - '0');
+            if(mant != 0)
+                digits++;
+        }
+        else
+            scale++;
+        seen++;
+        p++;
+    }
+
+    /* Fraction part. */
+    if(p < stop && *p == '.'){
+        p++;
+        while(p < stop && *p >= '0' && *p <= '9'){
+            if(digits < 19){
+                mant = mant * 10 + (unsigned long long)(*p - '0');
+                if(mant != 0)
+                    digits++;
+                scale--;
+            }
+            seen++;
+            p++;
+        }
+    }
+
+    /* A number needs a digit before any exponent ("e5", "-.", ".e3"). */
+    if(seen == 0)
+        return NULL;
+
+    /* Exponent part. */
+    if(p < stop && (*p == 'e' || *p == 'E')){
+        p++;
+        if(p < stop && (*p == '-' || *p == '+')){
+            eneg = (*p == '-');
+            p++;
+        }
+        if(p == stop)
+            return parse_float_slow(start, stop, out);
+        while(p < stop && *p >= '0' && *p <= '9'){
+            if(expo < 10000)
+                expo = expo * 10 + (*p - '0');
+            p++;
+        }
+        scale += eneg ? -expo : expo;
+    }
+
+    /* Trailing garbage or values outside the exact range go the slow way. */
+    if(p != stop || digits >= 19 || scale > 22 || scale < -22)
+        return parse_float_slow(start, stop, out);
+
+    d = (double)mant;
+    d = (scale < 0) ? d / pow10_table[-scale] : d * pow10_table[scale];
+    *out = (float)(neg ? -d : d);
+
+    return stop;
+}
@@ -0,0 +1,126 @@
+/* Fast Input : Header File */
+
+#ifndef FASTIO_H
+#define FASTIO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* FNV-1a offset basis and prime. */
+#define FNV1A_SEED  14695981039346656037ULL
+#define FNV1A_PRIME 1099511628211ULL
+
+typedef struct {
+    char* data;
+    size_t size;
+} mapped_file;
+
+
+
+/*
+ * map_file
+ *   DESCRIPTION: Maps a whole file into memory. The mapping is private
+ *                copy-on-write, so writes never reach the file.
+ *   INPUTS: fileName -- name of file to be mapped.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated mapped_file struct, NULL on failure.
+ *   SIDE EFFECTS: Allocates a mapped_file struct and creates a mapping.
+ */
+mapped_file* map_file(char* fileName);
+
+/*
+ * unmap_file
+ *   DESCRIPTION: Releases a mapping created by map_file.
+ *   INPUTS: m -- pointer to mapped_file struct.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Unmaps the file and deallocates the struct.
+ */
+void unmap_file(mapped_file* m);
+
+/*
+ * wall_time
+ *   DESCRIPTION: Reads a monotonic clock, used for reporting load and scan times.
+ *   INPUTS: None.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Time in seconds.
+ *   SIDE EFFECTS: None.
+ */
+double wall_time(void);
+
+/*
+ * fnv1a
+ *   DESCRIPTION: Adds bytes to a 64-bit FNV-1a hash, the one hash of
+ *                names, marker columns, cache and checkpoint fingerprints.
+ *   INPUTS: h     -- hash so far (FNV1A_SEED to start).
+ *           data  -- bytes.
+ *           bytes -- number of bytes.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: New hash.
+ *   SIDE EFFECTS: None.
+ */
+uint64_t fnv1a(uint64_t h, const void* data, size_t bytes);
+
+/*
+ * parse_float
+ *   DESCRIPTION: Parses one decimal number starting at p without scanf.
+ *                Plain decimals with up to 19 significant digits take a
+ *                fast path; anything else falls back to strtod. "NA",
+ *                "NaN" and "." are read as NAN (missing).
+ *   INPUTS: p   -- start of the token.
+ *           end -- end of the buffer.
+ *           out -- parsed value.
+ *   OUTPUTS: out
+ *   RETURN VALUE: Pointer just past the token, NULL if it is not a number.
+ *   SIDE EFFECTS: None.
+ */
+const char* parse_float(const char* p, const char* end, float* out);
+
+/*
+ * is_eol / is_blank
+ *   DESCRIPTION: Character classes used by the text loaders. Both CR and
+ *                LF end a line, so CR, LF and CRLF files all load.
+ */
+static inline int is_eol(char c){
+    return c == '\n' || c == '\r';
+}
+
+static inline int is_blank(char c){
+    return c == ' ' || c == '\t';
+}
+
+/*
+ * skip_blank
+ *   DESCRIPTION: Advances past spaces and tabs, stopping at a line end.
+ */
+static inline const char* skip_blank(const char* p, const char* end){
+    while(p < end && is_blank(*p))
+        p++;
+    return p;
+}
+
+/*
+ * skip_token
+ *   DESCRIPTION: Advances to the first blank or line end after p.
+ */
+static inline const char* skip_token(const char* p, const char* end){
+    while(p < end && !is_blank(*p) && !is_eol(*p))
+        p++;
+    return p;
+}
+
+/*
+ * next_line
+ *   DESCRIPTION: Advances to the first character of the next line.
+ */
+static inline const char* next_line(const char* p, const char* end){
+    while(p < end && !is_eol(*p))
+        p++;
+    while(p < end && is_eol(*p))
+        p++;
+    return p;
+}
+
+#endif
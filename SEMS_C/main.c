@@ -1,20 +1,262 @@
 #include <stdio.h>
 #include "args.h"
+#include "checkpoint.h"
+#include "collapse.h"
 #include "data.h"
-#include "ols_alg.h"
+#include "dist.h"
+#include "epistasis.h"
+#include "fastio.h"
+#include "markerstats.h"
+#include "permute.h"
+#include "pfit.h"
+#include "results.h"
+#include "scan.h"
+#include "stepwise.h"
+#include "stream.h"
 
-#define NUM_TEST 100
-#define PHEN_NUM 0
+/* Markers per result buffer in memory mode. */
+#define SCAN_CHUNK 1024
 
-int main(int argc, char** argv){
+/*
+ * open_output
+ *   DESCRIPTION: Opens the result table and writes its header.
+ *   INPUTS: fileName -- name of output file.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: FILE pointer, NULL on failure.
+ *   SIDE EFFECTS: Creates or truncates the file.
+ */
+static FILE* open_output(char* fileName){
+
+    FILE* f = NULL;
+
+    if((f = fopen(fileName, "w")) == NULL){
+        fprintf(stderr, "cannot open file \"%s\"\n", fileName);
+        return NULL;
+    }
+    scan_write_header(f);
+
+    return f;
+}
+
+/*
+ * trait_set
+ *   DESCRIPTION: Centers the traits selected with -trait (all by default).
+ *   INPUTS: my_args -- parsed arguments.
+ *           p       -- aligned phenotype.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated scan_trait, NULL on failure.
+ *   SIDE EFFECTS: Allocates a scan_trait.
+ */
+static scan_trait* trait_set(args* my_args, phenotype* p){
+
+    scan_trait* y = NULL;       /* Return argument. */
+    int* index = NULL;
+    int n_index = 0;
+
+    if((index = parse_index_set(my_args->traitSet, p->n_trait, &n_index)) == NULL)
+        return NULL;
+    y = scan_trait_create(p->matrix, p->ld, p->n_individual, index, n_index);
+    free(index);
+
+    if(y != NULL){
+        scan_set_threshold(y, my_args->threshold);
+        if(dist_rank() == 0)
+            fprintf(stderr, "Scanned traits: %d\n", y->n_trait);
+    }
+
+    return y;
+}
+
+/*
+ * run_fingerprint
+ *   DESCRIPTION: Fingerprint of the data and options that the progress in
+ *                a checkpoint depends on. Threads and ranks are left out:
+ *                the progress counts tile pairs of an order that does not
+ *                depend on them.
+ *   INPUTS: my_args -- parsed arguments.
+ *           g       -- genotype.
+ *           st      -- marker statistics.
+ *           reduced -- markers of the pairwise scan, NULL for all.
+ *           y       -- centered traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Fingerprint.
+ *   SIDE EFFECTS: None.
+ */
+static uint64_t run_fingerprint(args* my_args, const genotype* g, const marker_stats* st,
+                                const collapse* reduced, const scan_trait* y){
+
+    uint64_t h = FNV1A_SEED;
+    int head[10] = {g->n_marker, g->n_individual, y->n_trait, my_args->epistasis, my_args->tile,
+                    my_args->top, my_args->max_terms, my_args->stepwiseFile != NULL,
+                    (reduced != NULL) ? reduced->n_kept : -1, my_args->ld_window};
+    size_t size[2] = {sizeof(long), sizeof(result_entry)};
+    double level[3] = {my_args->threshold, my_args->stepwise_threshold, my_args->ld_r2};
+    int k = 0;                  /* Loop variable. */
+
+    h = fnv1a(h, head, sizeof(head));
+    h = fnv1a(h, size, sizeof(size));
+    h = fnv1a(h, level, sizeof(level));
+    h = fnv1a(h, y->index, y->n_trait * sizeof(int));
+    /* Tile pairs count over the markers kept, not just how many. */
+    if(reduced != NULL)
+        h = fnv1a(h, reduced->kept, reduced->n_kept * sizeof(int));
+    h = fnv1a(h, st->sum, g->n_marker * sizeof(double));
+    h = fnv1a(h, st->sumsq, g->n_marker * sizeof(double));
+    for(k = 0; k < y->n_trait; k++)
+        h = fnv1a(h, y->yc + (size_t)k * y->ld, y->n_individual * sizeof(float));
+
+    return h;
+}
+
+/*
+ * stream_scan
+ *   DESCRIPTION: Streaming mode: scans the genotype file block_markers
+ *                markers at a time, so only two blocks are ever in memory.
+ *   INPUTS: my_args -- parsed arguments.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes the result table.
+ */
+static int stream_scan(args* my_args){
+
+    marker_stream* ms = NULL;
+    marker_block* b = NULL;
+    phenotype* my_phenotype = NULL;
+    phenotype* aligned = NULL;
+    scan_trait* y = NULL;
+    scan_result* r = NULL;
+    result_set* best = NULL;
+    FILE* out = NULL;
+    double start = 0.0;         /* Scan timer. */
+    int status = 1;
+
+    if((ms = marker_stream_open(my_args->genotypeFile, my_args->block_markers)) == NULL){
+        fprintf(stderr, "NULL: marker stream\n");
+        return 1;
+    }
+
+    if((my_phenotype = phenotype_load(my_args->phenotypeFile, my_args->n_threads)) == NULL ||
+       (aligned = phenotype_align(my_phenotype, ms->individual)) == NULL){
+        fprintf(stderr, "NULL: my_phenotype\n");
+        goto done;
+    }
+    if((y = trait_set(my_args, aligned)) == NULL)
+        goto done;
+    if((r = (scan_result*)malloc((size_t)ms->block_markers * y->n_trait * sizeof(scan_result))) == NULL){
+        fprintf(stderr, "cannot allocate memory: scan_result*\n");
+        goto done;
+    }
+    if(my_args->top > 0 &&
+       (best = result_set_create(y->n_trait, my_args->top, my_args->threshold)) == NULL)
+        goto done;
+    if((out = open_output(my_args->outputFile)) == NULL)
+        goto done;
+
+    start = wall_time();
+    while((b = marker_stream_next(ms)) != NULL){
+        scan_single(b->matrix, b->ld, b->n_marker, NULL, 0, y, r);
+        if(best != NULL)
+            result_add_scan(best, b->first, b->n_marker, r);
+        else
+            scan_write(out, ms->marker, b->first, b->n_marker, aligned->trait, y, r);
+    }
+    status = ms->status;
+    fprintf(stderr, "Scan time: %.3f s\n", wall_time() - start);
+    if(best != NULL && !status)
+        status = result_write(best, out, ms->marker, aligned->trait, y);
+
+done:
+    if(out != NULL)
+        fclose(out);
+    free_result_set(best);
+    free(r);
+    free_scan_trait(y);
+    free_phenotype(aligned);
+    free_phenotype(my_phenotype);
+    marker_stream_close(ms);
+
+    return status;
+}
+
+/*
+ * permutation_mode
+ *   DESCRIPTION: Permutation mode: writes the empirical thresholds of the
+ *                traits selected with -trait instead of the scan.
+ *   INPUTS: my_args -- parsed arguments.
+ *           g       -- genotype.
+ *           st      -- marker statistics of g.
+ *           p       -- aligned phenotype.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes the threshold table.
+ */
+static int permutation_mode(args* my_args, genotype* g, const marker_stats* st, phenotype* p){
+
+    double levels[PERMUTE_N_ALPHA] = PERMUTE_ALPHA;
+    permutation* pm = NULL;
+    FILE* out = NULL;
+    int* index = NULL;
+    int n_index = 0;
+    int status = 1;
+
+    if((index = parse_index_set(my_args->traitSet, p->n_trait, &n_index)) == NULL)
+        return 1;
+    if((pm = permutation_create(g->matrix, g->ld, g->n_marker, g->n_individual, st,
+                                my_args->n_perm, my_args->seed)) == NULL)
+        goto done;
+    if((out = fopen(my_args->outputFile, "w")) == NULL){
+        fprintf(stderr, "cannot open file \"%s\"\n", my_args->outputFile);
+        goto done;
+    }
+
+    if(my_args->threshold > 0.0)
+        status = permutation_run(pm, p->matrix, p->ld, index, n_index, &my_args->threshold, 1,
+                                 out, p->trait);
+    else
+        status = permutation_run(pm, p->matrix, p->ld, index, n_index, levels, PERMUTE_N_ALPHA,
+                                 out, p->trait);
+
+done:
+    if(out != NULL)
+        fclose(out);
+    free_permutation(pm);
+    free(index);
+
+    return status;
+}
+
+/*
+ * run
+ *   DESCRIPTION: One rank's share of the run. Rank 0 loads the data and
+ *                writes every file; the scans are split over the ranks.
+ *   INPUTS: argc -- argument count.
+ *           argv -- argument vector.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes the output files on rank 0.
+ */
+static int run(int argc, char** argv){
 
     /* Initialize structs. */
     args* my_args = NULL;
     genotype* my_genotype = NULL;
+    marker_stats* my_stats = NULL;
+    collapse* reduced = NULL;
     phenotype* my_phenotype = NULL;
+    phenotype* aligned = NULL;
+    scan_trait* y = NULL;
+    scan_result* r = NULL;
+    stepwise* model = NULL;
+    result_set* best = NULL;
+    checkpoint* ck = NULL;
+    FILE* out = NULL;
     
-    float z[NUM_TEST][2];   /* Result array.   */
-    int i;                  /* Loop variables. */
+    double start = 0.0;     /* Scan timer.       */
+    int n = 0;              /* Markers in chunk. */
+    int rank = dist_rank();
+    int n_rank = dist_size();
+    int stage = CHECKPOINT_NONE;    /* Stage to resume at. */
+    int i, c;               /* Loop variables.   */
     
     
     
@@ -22,6 +264,19 @@ int main(int argc, char** argv){
     if((my_args = get_params(argc, argv)) == NULL)
         return 1;
     
+    /* Streaming mode: never holds the whole genotype in memory. */
+    if(my_args->block_markers > 0){
+        i = (rank == 0) ? stream_scan(my_args) : 0;
+        free_params(my_args);
+        return i;
+    }
+    
+    /* Convert and permutation modes run on rank 0 alone. */
+    if(rank > 0 && (my_args->convertFile != NULL || my_args->n_perm > 0)){
+        free_params(my_args);
+        return 0;
+    }
+    
     
     
     /* Print file names. */
@@ -32,12 +287,46 @@ int main(int argc, char** argv){
     
     
     
-    /* Load genotype. */
-    if((my_genotype = genotype_load(my_args->genotypeFile)) == NULL){
+    /* Load genotype on rank 0. */
+    if(rank == 0 &&
+       (my_genotype = genotype_load(my_args->genotypeFile, my_args->n_threads)) == NULL){
         fprintf(stderr, "NULL: my_genotype\n");
         return 1;
     }
     
+    /* Convert mode: write the binary cache and its statistics, and stop. */
+    if(my_args->convertFile != NULL){
+        i = genotype_store(my_args->convertFile, my_genotype) ||
+            marker_stats_save(my_args->convertFile, my_genotype);
+        free_genotype(my_genotype);
+        free_params(my_args);
+        return i;
+    }
+    
+    /* Per-marker sums, read from next to a binary cache when present. */
+    if(rank == 0 &&
+       (my_stats = marker_stats_open(my_args->genotypeFile, my_genotype)) == NULL){
+        fprintf(stderr, "NULL: marker statistics\n");
+        return 1;
+    }
+    
+    /* Every rank's share of the pairs reads every marker. */
+    if((my_args->n_perm == 0 && dist_bcast_genotype(&my_genotype)) ||
+       (rank > 0 &&
+        (my_stats = marker_stats_create(my_genotype->matrix, my_genotype->ld, my_genotype->n_marker,
+                                        my_genotype->n_individual)) == NULL)){
+        fprintf(stderr, "NULL: my_genotype\n");
+        return 1;
+    }
+    
+    /* Pairwise scan on one representative per set of duplicate or LD markers. */
+    if(my_args->collapseFile != NULL &&
+       ((reduced = collapse_create(my_genotype, my_stats, my_args->ld_r2, my_args->ld_window)) == NULL ||
+        (rank == 0 && collapse_write(reduced, my_args->collapseFile, my_genotype->marker)))){
+        fprintf(stderr, "NULL: collapse\n");
+        return 1;
+    }
+    
     /* Print genotype. */
     /*
     printf("\nGenotype File: %s\nNumber of Individuals: %d\nNumber of Markers: %d\n",
@@ -46,12 +335,12 @@ int main(int argc, char** argv){
     printf("\nGenotype Data:\n");
     
     for(i = 0; i < my_genotype->n_marker; i++)
-        printf("%s ", my_genotype->marker[i]);
+        printf("%s ", name_table_get(my_genotype->marker, i));
     printf("\n");
     for(i = 0; i < my_genotype->n_individual; i++){
-        printf("%s ", my_genotype->individual[i]);
+        printf("%s ", name_table_get(my_genotype->individual, i));
         for(j = 0; j < my_genotype->n_marker; j++)
-            printf("%f ", my_genotype->matrix[j][i]);
+            printf("%f ", genotype_column(my_genotype, j)[i]);
         printf("\n");
     }
     printf("\n");
@@ -59,8 +348,22 @@ int main(int argc, char** argv){
     
     
     
-    /* Load phenotype. */
-    if((my_phenotype = phenotype_load(my_args->phenotypeFile)) == NULL){
+    /* Load phenotype on rank 0. */
+    if(rank == 0 &&
+       (my_phenotype = phenotype_load(my_args->phenotypeFile, my_args->n_threads)) == NULL){
+        fprintf(stderr, "NULL: my_phenotype\n");
+        return 1;
+    }
+    
+    /* Match phenotype rows to genotype individuals by name. */
+    if(rank == 0 &&
+       (aligned = phenotype_align(my_phenotype, my_genotype->individual)) == NULL){
+        fprintf(stderr, "NULL: aligned phenotype\n");
+        return 1;
+    }
+    free_phenotype(my_phenotype);
+    my_phenotype = aligned;
+    if(my_args->n_perm == 0 && dist_bcast_phenotype(&my_phenotype)){
         fprintf(stderr, "NULL: my_phenotype\n");
         return 1;
     }
@@ -73,12 +376,12 @@ int main(int argc, char** argv){
     printf("\nPhenotype Data:\n");
     
     for(i = 0; i < my_phenotype->n_trait; i++)
-        printf("%s ", my_phenotype->trait[i]);
+        printf("%s ", name_table_get(my_phenotype->trait, i));
     printf("\n");
     for(i = 0; i < my_phenotype->n_individual; i++){
-        printf("%s ", my_phenotype->individual[i]);
+        printf("%s ", name_table_get(my_phenotype->individual, i));
         for(j = 0; j < my_phenotype->n_trait; j++)
-            printf("%f ", my_phenotype->matrix[j][i]);
+            printf("%f ", phenotype_column(my_phenotype, j)[i]);
         printf("\n");
     }
     printf("\n");
@@ -86,26 +389,180 @@ int main(int argc, char** argv){
 
     
     
-    /* Print ols analysis. */
+    /* Permutation mode: thresholds instead of the scan. */
+    if(my_args->n_perm > 0){
+        i = permutation_mode(my_args, my_genotype, my_stats, my_phenotype);
+        free_marker_stats(my_stats);
+        free_genotype(my_genotype);
+        free_phenotype(my_phenotype);
+        free_params(my_args);
+        return i;
+    }
     
-    printf("\nLeast Squares Regression Analysis:\n\n");
+    /* Single-marker scan of every marker against every selected trait. */
+    if((y = trait_set(my_args, my_phenotype)) == NULL ||
+       (r = (scan_result*)malloc((size_t)SCAN_CHUNK * y->n_trait * sizeof(scan_result))) == NULL){
+        fprintf(stderr, "NULL: scan\n");
+        return 1;
+    }
     
-    for(i = 0; i < NUM_TEST; i++){
-        printf("Marker %d, Trait %d\n", i, PHEN_NUM);
-        
-        ols_regression_analysis(my_genotype->matrix[i], my_phenotype->matrix[PHEN_NUM], z[i], 
-                                my_genotype->n_individual, 1, 1);
-
-        printf("a: %f\nb: %f\n\n", z[i][1], z[i][0]);
+    /* Progress of the pairwise scan and stepwise selection; -resume goes on from it. */
+    if(my_args->checkpointFile != NULL &&
+       ((ck = checkpoint_create(my_args->checkpointFile,
+                                (rank == 0) ? run_fingerprint(my_args, my_genotype, my_stats, reduced, y) : 0)) == NULL ||
+        (my_args->resume && checkpoint_resume(ck)))){
+        fprintf(stderr, "NULL: checkpoint\n");
+        return 1;
     }
+    if(ck != NULL)
+        stage = ck->stage;
+    
+    /* A resumed full table is cut back to the pairs the checkpoint accounts for. */
+    if(rank == 0 && stage < CHECKPOINT_STEPWISE &&
+       (out = (stage == CHECKPOINT_PAIRS && my_args->top == 0) ?
+              checkpoint_reopen(my_args->outputFile, ck->offset) :
+              open_output(my_args->outputFile)) == NULL){
+        fprintf(stderr, "NULL: scan\n");
+        return 1;
+    }
+    
+    /* With -top, only the best tests and the hits are kept and written. */
+    if(my_args->top > 0 && stage == CHECKPOINT_PAIRS && rank == 0){
+        best = ck->kept;
+        ck->kept = NULL;
+    }
+    else if(my_args->top > 0 && stage < CHECKPOINT_STEPWISE &&
+            (best = result_set_create(y->n_trait, my_args->top, my_args->threshold)) == NULL){
+        fprintf(stderr, "NULL: result_set\n");
+        return 1;
+    }
+    
+    /* Chunks are dealt round-robin over the ranks; rank 0 writes them in order. */
+    start = wall_time();
+    for(i = 0, c = 0; stage == CHECKPOINT_NONE && i < my_genotype->n_marker; i += SCAN_CHUNK, c++){
+        n = (my_genotype->n_marker - i < SCAN_CHUNK) ? my_genotype->n_marker - i : SCAN_CHUNK;
+        if(c % n_rank == rank){
+            scan_single(genotype_column(my_genotype, i), my_genotype->ld, n, my_stats, i, y, r);
+            if(best != NULL)
+                result_add_scan(best, i, n, r);
+        }
+        if(best == NULL){
+            dist_to_root(r, (size_t)n * y->n_trait * sizeof(scan_result), c % n_rank);
+            if(rank == 0)
+                scan_write(out, my_genotype->marker, i, n, my_phenotype->trait, y, r);
+        }
+    }
+    if(rank == 0 && stage == CHECKPOINT_NONE)
+        fprintf(stderr, "Scan time: %.3f s\n", wall_time() - start);
+    
+    /* Pairwise scan, appended to the same table. */
+    if(my_args->epistasis && stage < CHECKPOINT_STEPWISE && best != NULL){
+        if((reduced != NULL) ?
+           epistasis_collect(reduced->matrix, reduced->ld, reduced->n_kept, reduced->st,
+                             y, my_args->n_threads, my_args->tile, best, ck) :
+           epistasis_collect(my_genotype->matrix, my_genotype->ld, my_genotype->n_marker, my_stats,
+                             y, my_args->n_threads, my_args->tile, best, ck)){
+            fprintf(stderr, "NULL: epistasis\n");
+            return 1;
+        }
+        if(reduced != NULL)
+            result_rename_pairs(best, reduced->kept);
+    }
+    else if(my_args->epistasis && stage < CHECKPOINT_STEPWISE){
+        if((reduced != NULL) ?
+           epistasis_scan(reduced->matrix, reduced->ld, reduced->n_kept, reduced->st,
+                          y, my_args->n_threads, my_args->tile, out, reduced->marker,
+                          my_phenotype->trait, ck) :
+           epistasis_scan(my_genotype->matrix, my_genotype->ld, my_genotype->n_marker, my_stats,
+                          y, my_args->n_threads, my_args->tile, out, my_genotype->marker,
+                          my_phenotype->trait, ck)){
+            fprintf(stderr, "NULL: epistasis\n");
+            return 1;
+        }
+    }
+    if(best != NULL){
+        if(dist_reduce_results(best) ||
+           (rank == 0 && result_write(best, out, my_genotype->marker, my_phenotype->trait, y))){
+            fprintf(stderr, "NULL: results\n");
+            return 1;
+        }
+        if(rank == 0)
+            fprintf(stderr, "Tests: %ld, kept: %ld hits and %d per trait\n",
+                    best->n_test, best->n_hit, best->top);
+        free_result_set(best);
+    }
+    if(out != NULL && fclose(out) != 0){
+        fprintf(stderr, "cannot write file \"%s\"\n", my_args->outputFile);
+        return 1;
+    }
+    
+    /* The table is complete: a resumed run goes on with stepwise selection. */
+    if(ck != NULL && my_args->stepwiseFile != NULL && stage < CHECKPOINT_STEPWISE){
+        free_result_set(ck->kept);
+        ck->kept = NULL;
+        checkpoint_model(ck, 0, 0);
+        ck->stage = CHECKPOINT_STEPWISE;
+        ck->done = ck->offset = 0;
+        if(checkpoint_save(ck)){
+            fprintf(stderr, "NULL: checkpoint\n");
+            return 1;
+        }
+    }
+    
+    /* Large final models are fitted over every rank; the others wait for them. */
+    if(rank > 0 && my_args->stepwiseFile != NULL &&
+       pfit_serve(my_genotype->matrix, my_genotype->ld, my_genotype->n_individual)){
+        fprintf(stderr, "NULL: stepwise\n");
+        return 1;
+    }
+    
+    /* Forward stepwise model of each trait, on rank 0. */
+    if(rank == 0 && my_args->stepwiseFile != NULL){
+        if((out = (stage == CHECKPOINT_STEPWISE && ck->offset > 0) ?
+                  checkpoint_reopen(my_args->stepwiseFile, ck->offset) :
+                  fopen(my_args->stepwiseFile, "w")) == NULL){
+            fprintf(stderr, "cannot open file \"%s\"\n", my_args->stepwiseFile);
+            return 1;
+        }
+        if((model = stepwise_create(my_genotype->matrix, my_genotype->ld, my_genotype->n_marker,
+                                    my_genotype->n_individual, my_stats,
+                                    (my_args->max_terms > 0) ? my_args->max_terms : my_genotype->n_marker)) == NULL ||
+           stepwise_run(model, y, my_args->stepwise_threshold, out,
+                        my_genotype->marker, my_phenotype->trait, ck)){
+            fprintf(stderr, "NULL: stepwise\n");
+            return 1;
+        }
+        pfit_done();
+        free_stepwise(model);
+        fclose(out);
+    }
+    
+    
+    
+    /* Finished: nothing left to resume. */
+    if(ck != NULL)
+        checkpoint_finish(ck);
     
     
     
     /* Free structs. */
+    free_checkpoint(ck);
+    free_collapse(reduced);
+    free_marker_stats(my_stats);
     free_genotype(my_genotype);
     free_phenotype(my_phenotype);
+    free_scan_trait(y);
+    free(r);
     free_params(my_args);
     
     return 0;
 }
 
+int main(int argc, char** argv){
+
+    if(dist_init(&argc, &argv))
+        return 1;
+
+    return dist_finish(run(argc, argv));
+}
+
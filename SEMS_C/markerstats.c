@@ -0,0 +1,354 @@
+/* Marker Statistics : Function Definition File */
+
+#include <sys/stat.h>
+#include "markerstats.h"
+#include "fastio.h"
+
+/*
+ * stats_name
+ *   DESCRIPTION: "<fileName><suffix>" in a new string.
+ *   INPUTS: fileName -- base name.
+ *           suffix   -- suffix.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Newly allocated string, NULL on failure.
+ *   SIDE EFFECTS: Allocates memory.
+ */
+static char* stats_name(const char* fileName, const char* suffix){
+
+    char* s = NULL;             /* Return argument. */
+
+    if((s = (char*)malloc(strlen(fileName) + strlen(suffix) + 1)) == NULL){
+        fprintf(stderr, "cannot allocate memory: file name\n");
+        return NULL;
+    }
+    strcpy(s, fileName);
+    strcat(s, suffix);
+
+    return s;
+}
+
+/*
+ * stats_alloc
+ *   DESCRIPTION: Allocates an uninitialized marker_stats.
+ *   INPUTS: n_marker     -- number of markers.
+ *           n_individual -- number of individuals.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stats, NULL on failure.
+ *   SIDE EFFECTS: Allocates a marker_stats.
+ */
+static marker_stats* stats_alloc(int n_marker, int n_individual){
+
+    marker_stats* st = NULL;    /* Return argument. */
+
+    if((st = (marker_stats*)calloc(1, sizeof(marker_stats))) == NULL){
+        fprintf(stderr, "cannot allocate memory: marker_stats*\n");
+        return NULL;
+    }
+    st->n_marker = n_marker;
+    st->n_individual = n_individual;
+
+    if((st->sum = (double*)malloc(n_marker * sizeof(double))) == NULL ||
+       (st->sumsq = (double*)malloc(n_marker * sizeof(double))) == NULL ||
+       (st->css = (double*)malloc(n_marker * sizeof(double))) == NULL ||
+       (st->freq = (float*)malloc(n_marker * sizeof(float))) == NULL ||
+       (st->lo = (float*)malloc(n_marker * sizeof(float))) == NULL ||
+       (st->hi = (float*)malloc(n_marker * sizeof(float))) == NULL ||
+       (st->n_missing = (int*)malloc(n_marker * sizeof(int))) == NULL){
+        fprintf(stderr, "cannot allocate memory: marker_stats*\n");
+        free_marker_stats(st);
+        return NULL;
+    }
+
+    return st;
+}
+
+/*
+ * marker_stats_create
+ *   DESCRIPTION: Computes the statistics of a genotype slab in one pass.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stats, NULL on failure.
+ *   SIDE EFFECTS: Allocates a marker_stats.
+ */
+marker_stats* marker_stats_create(const float* x, int ldx, int n_marker, int n_individual){
+
+    marker_stats* st = NULL;    /* Return argument. */
+    const float* c = NULL;      /* Current column.  */
+    double sx, sxx;
+    float lo, hi;
+    int n_obs = 0;
+    int i, j;                   /* Loop variables.  */
+
+    if((st = stats_alloc(n_marker, n_individual)) == NULL)
+        return NULL;
+
+    for(j = 0; j < n_marker; j++){
+        c = x + (size_t)j * ldx;
+        sx = sxx = 0.0;
+        lo = INFINITY;
+        hi = -INFINITY;
+        n_obs = 0;
+        for(i = 0; i < n_individual; i++){
+            if(isnan(c[i]))
+                continue;
+            sx += c[i];
+            sxx += (double)c[i] * c[i];
+            if(c[i] < lo)
+                lo = c[i];
+            if(c[i] > hi)
+                hi = c[i];
+            n_obs++;
+        }
+        st->sum[j] = sx;
+        st->sumsq[j] = sxx;
+        st->css[j] = (n_obs > 0) ? sxx - sx * sx / n_obs : 0.0;
+        st->freq[j] = (n_obs > 0) ? (float)(sx / n_obs / 2.0) : NAN;
+        st->lo[j] = (n_obs > 0) ? lo : NAN;
+        st->hi[j] = (n_obs > 0) ? hi : NAN;
+        st->n_missing[j] = n_individual - n_obs;
+    }
+
+    return st;
+}
+
+/*
+ * marker_stats_fingerprint
+ *   DESCRIPTION: Fingerprint of a binary genotype cache.
+ *   INPUTS: fileName    -- name of the cache.
+ *           fingerprint -- FNV-1a hash of its header, size and mtime.
+ *   OUTPUTS: fingerprint
+ *   RETURN VALUE: (0) on success, (1) if the file cannot be read.
+ *   SIDE EFFECTS: None.
+ */
+int marker_stats_fingerprint(char* fileName, uint64_t* fingerprint){
+
+    FILE* f = NULL;
+    struct stat sb;
+    data_header h;
+    uint64_t v = 0;
+    uint64_t hash = FNV1A_SEED;
+
+    if(stat(fileName, &sb) != 0 || (f = fopen(fileName, "rb")) == NULL)
+        return 1;
+    memset(&h, 0, sizeof(h));
+    if(fread(&h, sizeof(h), 1, f) != 1){
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    hash = fnv1a(hash, &h, sizeof(h));
+    v = (uint64_t)sb.st_size;
+    hash = fnv1a(hash, &v, sizeof(v));
+    v = (uint64_t)sb.st_mtim.tv_sec;
+    hash = fnv1a(hash, &v, sizeof(v));
+    v = (uint64_t)sb.st_mtim.tv_nsec;
+    hash = fnv1a(hash, &v, sizeof(v));
+
+    /* 0 stands for no source. */
+    *fingerprint = (hash != 0) ? hash : 1;
+
+    return 0;
+}
+
+/*
+ * marker_stats_store
+ *   DESCRIPTION: Writes the statistics file in the format above, through a
+ *                temporary file renamed into place.
+ *   INPUTS: fileName -- name of statistics file.
+ *           st       -- pointer to marker_stats.
+ *   OUTPUTS: fileName
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to fileName.
+ */
+int marker_stats_store(char* fileName, const marker_stats* st){
+
+    FILE* f = NULL;
+    char* tmpFile = NULL;
+    marker_stats_header h;
+    size_t n = (size_t)st->n_marker;
+    int status = 1;
+
+    if((tmpFile = stats_name(fileName, ".tmp")) == NULL)
+        return 1;
+    if((f = fopen(tmpFile, "wb")) == NULL){
+        fprintf(stderr, "cannot open file \"%s\"\n", tmpFile);
+        free(tmpFile);
+        return 1;
+    }
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MARKERSTATS_MAGIC, strlen(MARKERSTATS_MAGIC) + 1);
+    h.version = MARKERSTATS_VERSION;
+    h.fingerprint = st->fingerprint;
+    h.n_marker = (uint64_t)st->n_marker;
+    h.n_individual = (uint64_t)st->n_individual;
+
+    if(fwrite(&h, sizeof(h), 1, f) == 1 &&
+       fwrite(st->sum, sizeof(double), n, f) == n &&
+       fwrite(st->sumsq, sizeof(double), n, f) == n &&
+       fwrite(st->css, sizeof(double), n, f) == n &&
+       fwrite(st->freq, sizeof(float), n, f) == n &&
+       fwrite(st->lo, sizeof(float), n, f) == n &&
+       fwrite(st->hi, sizeof(float), n, f) == n &&
+       fwrite(st->n_missing, sizeof(int), n, f) == n)
+        status = 0;
+    if(fclose(f) != 0)
+        status = 1;
+
+    if(status == 0 && rename(tmpFile, fileName) != 0)
+        status = 1;
+    if(status != 0){
+        fprintf(stderr, "cannot write file \"%s\"\n", fileName);
+        remove(tmpFile);
+    }
+    free(tmpFile);
+
+    return status;
+}
+
+/*
+ * marker_stats_load
+ *   DESCRIPTION: Reads a statistics file if it matches the cache.
+ *   INPUTS: fileName     -- name of statistics file.
+ *           fingerprint  -- fingerprint of the cache.
+ *           n_marker     -- markers of the cache.
+ *           n_individual -- individuals of the cache.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stats, NULL if the
+ *                 file is missing, stale or damaged.
+ *   SIDE EFFECTS: Allocates a marker_stats.
+ */
+marker_stats* marker_stats_load(char* fileName, uint64_t fingerprint, int n_marker, int n_individual){
+
+    FILE* f = NULL;
+    marker_stats* st = NULL;    /* Return argument. */
+    marker_stats_header h;
+    size_t n = (size_t)n_marker;
+
+    if((f = fopen(fileName, "rb")) == NULL)
+        return NULL;
+    if(fread(&h, sizeof(h), 1, f) != 1 ||
+       memcmp(h.magic, MARKERSTATS_MAGIC, strlen(MARKERSTATS_MAGIC) + 1) != 0 ||
+       h.version != MARKERSTATS_VERSION || h.fingerprint != fingerprint ||
+       h.n_marker != (uint64_t)n_marker || h.n_individual != (uint64_t)n_individual){
+        fclose(f);
+        return NULL;
+    }
+
+    if((st = stats_alloc(n_marker, n_individual)) != NULL){
+        st->fingerprint = fingerprint;
+        if(fread(st->sum, sizeof(double), n, f) != n ||
+           fread(st->sumsq, sizeof(double), n, f) != n ||
+           fread(st->css, sizeof(double), n, f) != n ||
+           fread(st->freq, sizeof(float), n, f) != n ||
+           fread(st->lo, sizeof(float), n, f) != n ||
+           fread(st->hi, sizeof(float), n, f) != n ||
+           fread(st->n_missing, sizeof(int), n, f) != n){
+            free_marker_stats(st);
+            st = NULL;
+        }
+    }
+    fclose(f);
+
+    return st;
+}
+
+/*
+ * marker_stats_open
+ *   DESCRIPTION: Statistics of a loaded genotype: read from
+ *                "<genotypeFile>.stats" for a binary cache when it
+ *                matches, else computed (and stored there for a cache).
+ *   INPUTS: genotypeFile -- name of genotype file.
+ *           g            -- genotype loaded from it.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stats, NULL on failure.
+ *   SIDE EFFECTS: Allocates a marker_stats; may write the statistics
+ *                 file; writes to stderr.
+ */
+marker_stats* marker_stats_open(char* genotypeFile, genotype* g){
+
+    marker_stats* st = NULL;    /* Return argument. */
+    char* statsFile = NULL;
+    uint64_t fingerprint = 0;
+    double start = wall_time(); /* Stats timer.     */
+    int cached = 0;             /* Binary cache with a fingerprint. */
+
+    if(g->map != NULL && marker_stats_fingerprint(genotypeFile, &fingerprint) == 0){
+        if((statsFile = stats_name(genotypeFile, MARKERSTATS_SUFFIX)) == NULL)
+            return NULL;
+        cached = 1;
+        if((st = marker_stats_load(statsFile, fingerprint, g->n_marker, g->n_individual)) != NULL){
+            fprintf(stderr, "Marker statistics: read \"%s\" in %.3f s\n", statsFile, wall_time() - start);
+            free(statsFile);
+            return st;
+        }
+    }
+
+    if((st = marker_stats_create(g->matrix, g->ld, g->n_marker, g->n_individual)) != NULL){
+        fprintf(stderr, "Marker statistics: %.3f s\n", wall_time() - start);
+        st->fingerprint = fingerprint;
+        if(cached && marker_stats_store(statsFile, st) == 0)
+            fprintf(stderr, "Stored \"%s\"\n", statsFile);
+    }
+    free(statsFile);
+
+    return st;
+}
+
+/*
+ * marker_stats_save
+ *   DESCRIPTION: Computes the statistics of a genotype and stores them
+ *                next to the binary cache it was just written to.
+ *   INPUTS: cacheFile -- name of binary cache written by genotype_store.
+ *           g         -- genotype.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes "<cacheFile>.stats".
+ */
+int marker_stats_save(char* cacheFile, genotype* g){
+
+    marker_stats* st = NULL;
+    char* statsFile = NULL;
+    int status = 1;
+
+    if((st = marker_stats_create(g->matrix, g->ld, g->n_marker, g->n_individual)) == NULL ||
+       (statsFile = stats_name(cacheFile, MARKERSTATS_SUFFIX)) == NULL)
+        goto done;
+    if(marker_stats_fingerprint(cacheFile, &st->fingerprint) != 0){
+        fprintf(stderr, "cannot read file \"%s\"\n", cacheFile);
+        goto done;
+    }
+    if((status = marker_stats_store(statsFile, st)) == 0)
+        fprintf(stderr, "Stored \"%s\"\n", statsFile);
+
+done:
+    free(statsFile);
+    free_marker_stats(st);
+
+    return status;
+}
+
+/*
+ * free_marker_stats
+ *   DESCRIPTION: Deallocates memory associated with a marker_stats.
+ *   INPUTS: st -- pointer to marker_stats.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a marker_stats.
+ */
+void free_marker_stats(marker_stats* st){
+    if(st != NULL){
+        free(st->sum);
+        free(st->sumsq);
+        free(st->css);
+        free(st->freq);
+        free(st->lo);
+        free(st->hi);
+        free(st->n_missing);
+        free(st);
+    }
+}
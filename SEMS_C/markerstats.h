@@ -0,0 +1,146 @@
+/* Marker Statistics : Header File */
+
+#ifndef MARKERSTATS_H
+#define MARKERSTATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "data.h"
+
+/*
+ * Statistics file (version 1, native byte order), written next to a binary
+ * genotype cache as "<cache>.stats":
+ *   marker_stats_header    -- magic, version, fingerprint of the cache and
+ *                             dimensions.
+ *   sum, sumsq, css        -- n_marker doubles each.
+ *   freq, lo, hi           -- n_marker floats each.
+ *   n_missing              -- n_marker int32.
+ * The fingerprint hashes the cache's data_header, size and modification
+ * time, so a rewritten cache never picks up old statistics.
+ */
+#define MARKERSTATS_MAGIC       "SEMSSTA"
+#define MARKERSTATS_VERSION     1
+#define MARKERSTATS_SUFFIX      ".stats"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t fingerprint;
+    uint64_t n_marker;
+    uint64_t n_individual;
+} marker_stats_header;
+
+/*
+ * Per-marker summaries over the observed (non-missing) individuals, which
+ * do not depend on the trait or the model. The scans take the sums of
+ * complete markers from here instead of a pass over the column per trait
+ * set, permutation batch or stepwise start; markers with missing values
+ * keep the scans' own sums.
+ */
+typedef struct {
+    int n_marker;
+    int n_individual;
+    uint64_t fingerprint;       /* Source cache, 0 for none.           */
+
+    double* sum;                /* Sum of x.                           */
+    double* sumsq;              /* Sum of x^2.                         */
+    double* css;                /* Centered sum of squares of x.       */
+    float* freq;                /* Allele frequency, mean(x) / 2.      */
+    float* lo;                  /* Smallest and largest value.         */
+    float* hi;
+    int* n_missing;             /* Missing values.                     */
+} marker_stats;
+
+
+
+/*
+ * marker_stats_create
+ *   DESCRIPTION: Computes the statistics of a genotype slab in one pass.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stats, NULL on failure.
+ *   SIDE EFFECTS: Allocates a marker_stats.
+ */
+marker_stats* marker_stats_create(const float* x, int ldx, int n_marker, int n_individual);
+
+/*
+ * marker_stats_fingerprint
+ *   DESCRIPTION: Fingerprint of a binary genotype cache.
+ *   INPUTS: fileName    -- name of the cache.
+ *           fingerprint -- FNV-1a hash of its header, size and mtime.
+ *   OUTPUTS: fingerprint
+ *   RETURN VALUE: (0) on success, (1) if the file cannot be read.
+ *   SIDE EFFECTS: None.
+ */
+int marker_stats_fingerprint(char* fileName, uint64_t* fingerprint);
+
+/*
+ * marker_stats_store
+ *   DESCRIPTION: Writes the statistics file in the format above, through a
+ *                temporary file renamed into place.
+ *   INPUTS: fileName -- name of statistics file.
+ *           st       -- pointer to marker_stats.
+ *   OUTPUTS: fileName
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to fileName.
+ */
+int marker_stats_store(char* fileName, const marker_stats* st);
+
+/*
+ * marker_stats_load
+ *   DESCRIPTION: Reads a statistics file if it matches the cache.
+ *   INPUTS: fileName     -- name of statistics file.
+ *           fingerprint  -- fingerprint of the cache.
+ *           n_marker     -- markers of the cache.
+ *           n_individual -- individuals of the cache.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stats, NULL if the
+ *                 file is missing, stale or damaged.
+ *   SIDE EFFECTS: Allocates a marker_stats.
+ */
+marker_stats* marker_stats_load(char* fileName, uint64_t fingerprint, int n_marker, int n_individual);
+
+/*
+ * marker_stats_open
+ *   DESCRIPTION: Statistics of a loaded genotype: read from
+ *                "<genotypeFile>.stats" for a binary cache when it
+ *                matches, else computed (and stored there for a cache).
+ *   INPUTS: genotypeFile -- name of genotype file.
+ *           g            -- genotype loaded from it.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stats, NULL on failure.
+ *   SIDE EFFECTS: Allocates a marker_stats; may write the statistics
+ *                 file; writes to stderr.
+ */
+marker_stats* marker_stats_open(char* genotypeFile, genotype* g);
+
+/*
+ * marker_stats_save
+ *   DESCRIPTION: Computes the statistics of a genotype and stores them
+ *                next to the binary cache it was just written to.
+ *   INPUTS: cacheFile -- name of binary cache written by genotype_store.
+ *           g         -- genotype.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes "<cacheFile>.stats".
+ */
+int marker_stats_save(char* cacheFile, genotype* g);
+
+/*
+ * free_marker_stats
+ *   DESCRIPTION: Deallocates memory associated with a marker_stats.
+ *   INPUTS: st -- pointer to marker_stats.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a marker_stats.
+ */
+void free_marker_stats(marker_stats* st);
+
+#endif
@@ -0,0 +1,229 @@
+/* Name Table : Function Definition File */
+
+#include "names.h"
+#include "fastio.h"
+
+/*
+ * name_equal
+ *   DESCRIPTION: Compares stored name i with s[0..len).
+ */
+static int name_equal(const name_table* nt, int i, const char* s, size_t len){
+    const char* t = name_table_get(nt, i);
+
+    return strncmp(t, s, len) == 0 && t[len] == '\0';
+}
+
+/*
+ * index_insert
+ *   DESCRIPTION: Inserts position i into the hash index with linear
+ *                probing, unless an equal name is already indexed.
+ */
+static void index_insert(name_table* nt, int i){
+    const char* s = name_table_get(nt, i);
+    size_t len = strlen(s);
+    size_t mask = (size_t)nt->n_slot - 1;
+    size_t k = (size_t)fnv1a(FNV1A_SEED, s, len) & mask;
+
+    while(nt->slot[k] >= 0){
+        if(name_equal(nt, nt->slot[k], s, len))
+            return;
+        k = (k + 1) & mask;
+    }
+    nt->slot[k] = i;
+}
+
+/*
+ * index_build
+ *   DESCRIPTION: (Re)builds the hash index for at least n_min names.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ */
+static int index_build(name_table* nt, int n_min){
+    int n_slot = 16;
+    int* slot = NULL;
+    int i = 0;
+
+    while(n_slot < 2 * n_min)
+        n_slot *= 2;
+
+    if((slot = (int*)malloc(n_slot * sizeof(int))) == NULL){
+        fprintf(stderr, "cannot allocate memory: name index\n");
+        return 1;
+    }
+    for(i = 0; i < n_slot; i++)
+        slot[i] = -1;
+
+    free(nt->slot);
+    nt->slot = slot;
+    nt->n_slot = n_slot;
+    for(i = 0; i < nt->n_name; i++)
+        index_insert(nt, i);
+
+    return 0;
+}
+
+/*
+ * name_table_create
+ *   DESCRIPTION: Creates an empty name table.
+ *   INPUTS: n_hint    -- expected number of names.
+ *           size_hint -- expected total bytes of names.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated name_table, NULL on failure.
+ *   SIDE EFFECTS: Allocates a name_table.
+ */
+name_table* name_table_create(int n_hint, size_t size_hint){
+
+    name_table* nt = NULL;      /* Return argument. */
+
+    if(n_hint < 16)
+        n_hint = 16;
+    if(size_hint < 256)
+        size_hint = 256;
+
+    if((nt = (name_table*)calloc(1, sizeof(name_table))) == NULL){
+        fprintf(stderr, "cannot allocate memory: name_table*\n");
+        return NULL;
+    }
+    nt->buffer = (char*)malloc(size_hint);
+    nt->buffer_capacity = size_hint;
+    nt->offset = (uint64_t*)malloc(n_hint * sizeof(uint64_t));
+    nt->capacity = n_hint;
+    
+    if(nt->buffer == NULL || nt->offset == NULL || index_build(nt, n_hint) != 0){
+        fprintf(stderr, "cannot allocate memory: name_table*\n");
+        free_name_table(nt);
+        return NULL;
+    }
+
+    return nt;
+}
+
+/*
+ * name_table_wrap
+ *   DESCRIPTION: Creates a name table over names that live elsewhere
+ *                (a mapped binary cache) and builds its hash index.
+ *   INPUTS: buffer -- base that offsets are relative to.
+ *           offset -- offsets of n NUL-terminated names.
+ *           n      -- number of names.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated name_table, NULL on failure.
+ *   SIDE EFFECTS: Allocates a name_table; buffer and offset are borrowed.
+ */
+name_table* name_table_wrap(char* buffer, uint64_t* offset, int n){
+
+    name_table* nt = NULL;      /* Return argument. */
+
+    if((nt = (name_table*)calloc(1, sizeof(name_table))) == NULL){
+        fprintf(stderr, "cannot allocate memory: name_table*\n");
+        return NULL;
+    }
+    nt->buffer = buffer;
+    nt->offset = offset;
+    nt->n_name = n;
+
+    if(index_build(nt, n) != 0){
+        free_name_table(nt);
+        return NULL;
+    }
+
+    return nt;
+}
+
+/*
+ * name_table_add
+ *   DESCRIPTION: Appends a name. Names that are already present are
+ *                stored again but the index keeps the first position.
+ *   INPUTS: nt  -- pointer to name_table (not borrowed).
+ *           s   -- name, not necessarily NUL-terminated.
+ *           len -- length of name.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Position of the new name, -1 on failure.
+ *   SIDE EFFECTS: May grow the buffer, offsets and index.
+ */
+int name_table_add(name_table* nt, const char* s, size_t len){
+
+    char* buffer = NULL;        /* Grown arrays. */
+    uint64_t* offset = NULL;
+    size_t buffer_capacity = 0;
+    int capacity = 0;
+
+    if(nt->buffer_capacity == 0){
+        fprintf(stderr, "cannot add names to a borrowed name table\n");
+        return -1;
+    }
+
+    /* Grow the buffer. */
+    if(nt->size + len + 1 > nt->buffer_capacity){
+        buffer_capacity = 2 * nt->buffer_capacity;
+        while(nt->size + len + 1 > buffer_capacity)
+            buffer_capacity *= 2;
+        if((buffer = (char*)realloc(nt->buffer, buffer_capacity)) == NULL){
+            fprintf(stderr, "cannot allocate memory: name buffer\n");
+            return -1;
+        }
+        nt->buffer = buffer;
+        nt->buffer_capacity = buffer_capacity;
+    }
+
+    /* Grow the offsets and the index. */
+    if(nt->n_name == nt->capacity){
+        capacity = 2 * nt->capacity;
+        if((offset = (uint64_t*)realloc(nt->offset, capacity * sizeof(uint64_t))) == NULL){
+            fprintf(stderr, "cannot allocate memory: name offsets\n");
+            return -1;
+        }
+        nt->offset = offset;
+        nt->capacity = capacity;
+    }
+    if(2 * (nt->n_name + 1) > nt->n_slot && index_build(nt, nt->n_name + 1) != 0)
+        return -1;
+
+    memcpy(nt->buffer + nt->size, s, len);
+    nt->buffer[nt->size + len] = '\0';
+    nt->offset[nt->n_name] = nt->size;
+    nt->size += len + 1;
+    index_insert(nt, nt->n_name);
+
+    return nt->n_name++;
+}
+
+/*
+ * name_table_find
+ *   DESCRIPTION: Looks a name up in the hash index.
+ *   INPUTS: nt  -- pointer to name_table.
+ *           s   -- name, not necessarily NUL-terminated.
+ *           len -- length of name.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Position of the name, -1 if absent.
+ *   SIDE EFFECTS: None.
+ */
+int name_table_find(const name_table* nt, const char* s, size_t len){
+
+    size_t mask = (size_t)nt->n_slot - 1;
+    size_t k = (size_t)fnv1a(FNV1A_SEED, s, len) & mask;
+
+    while(nt->slot[k] >= 0){
+        if(name_equal(nt, nt->slot[k], s, len))
+            return nt->slot[k];
+        k = (k + 1) & mask;
+    }
+    return -1;
+}
+
+/*
+ * free_name_table
+ *   DESCRIPTION: Deallocates memory associated with a name_table.
+ *   INPUTS: nt -- pointer to name_table.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a name_table (borrowed names are untouched).
+ */
+void free_name_table(name_table* nt){
+    if(nt != NULL){
+        if(nt->buffer_capacity != 0)
+            free(nt->buffer);
+        if(nt->capacity != 0)
+            free(nt->offset);
+        free(nt->slot);
+        free(nt);
+    }
+}
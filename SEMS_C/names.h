@@ -0,0 +1,100 @@
+/* Name Table : Header File */
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * Interned marker, trait or individual names: every name is stored
+ * NUL-terminated in one buffer and addressed by its offset, and an
+ * open-addressing hash index maps names back to their position.
+ * A table can also borrow its buffer and offsets from a mapped binary
+ * cache, in which case only the index is allocated.
+ */
+typedef struct {
+    int n_name;
+    int capacity;               /* Offsets allocated, 0 if borrowed.   */
+
+    char* buffer;               /* Names back to back.                 */
+    size_t size;                /* Bytes used in buffer.               */
+    size_t buffer_capacity;     /* Bytes allocated, 0 if borrowed.     */
+    uint64_t* offset;           /* Start of each name in buffer.       */
+
+    int* slot;                  /* Hash index: name position or -1.    */
+    int n_slot;                 /* Power of two, at least 2 * n_name.  */
+} name_table;
+
+
+
+/*
+ * name_table_create
+ *   DESCRIPTION: Creates an empty name table.
+ *   INPUTS: n_hint    -- expected number of names.
+ *           size_hint -- expected total bytes of names.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated name_table, NULL on failure.
+ *   SIDE EFFECTS: Allocates a name_table.
+ */
+name_table* name_table_create(int n_hint, size_t size_hint);
+
+/*
+ * name_table_wrap
+ *   DESCRIPTION: Creates a name table over names that live elsewhere
+ *                (a mapped binary cache) and builds its hash index.
+ *   INPUTS: buffer -- base that offsets are relative to.
+ *           offset -- offsets of n NUL-terminated names.
+ *           n      -- number of names.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated name_table, NULL on failure.
+ *   SIDE EFFECTS: Allocates a name_table; buffer and offset are borrowed.
+ */
+name_table* name_table_wrap(char* buffer, uint64_t* offset, int n);
+
+/*
+ * name_table_add
+ *   DESCRIPTION: Appends a name. Names that are already present are
+ *                stored again but the index keeps the first position.
+ *   INPUTS: nt  -- pointer to name_table (not borrowed).
+ *           s   -- name, not necessarily NUL-terminated.
+ *           len -- length of name.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Position of the new name, -1 on failure.
+ *   SIDE EFFECTS: May grow the buffer, offsets and index.
+ */
+int name_table_add(name_table* nt, const char* s, size_t len);
+
+/*
+ * name_table_find
+ *   DESCRIPTION: Looks a name up in the hash index.
+ *   INPUTS: nt  -- pointer to name_table.
+ *           s   -- name, not necessarily NUL-terminated.
+ *           len -- length of name.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Position of the name, -1 if absent.
+ *   SIDE EFFECTS: None.
+ */
+int name_table_find(const name_table* nt, const char* s, size_t len);
+
+/*
+ * name_table_get
+ *   DESCRIPTION: Returns the i-th name.
+ */
+static inline const char* name_table_get(const name_table* nt, int i){
+    return nt->buffer + nt->offset[i];
+}
+
+/*
+ * free_name_table
+ *   DESCRIPTION: Deallocates memory associated with a name_table.
+ *   INPUTS: nt -- pointer to name_table.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a name_table (borrowed names are untouched).
+ */
+void free_name_table(name_table* nt);
+
+#endif
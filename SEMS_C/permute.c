@@ -0,0 +1,278 @@
+/* Permutation Test : Function Definition File */
+
+#include "permute.h"
+#include "data.h"
+#include "fastio.h"
+
+/* splitmix64 increment (2^64 / golden ratio). */
+#define PERMUTE_GAMMA 0x9E3779B97F4A7C15ULL
+
+/*
+ * splitmix64
+ *   DESCRIPTION: Output function of splitmix64; counter c gives the c-th
+ *                value of the stream without stepping through the others.
+ *   INPUTS: c -- counter.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: 64 random bits.
+ *   SIDE EFFECTS: None.
+ */
+static uint64_t splitmix64(uint64_t c){
+    c = (c ^ (c >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    c = (c ^ (c >> 27)) * 0x94D049BB133111EBULL;
+    return c ^ (c >> 31);
+}
+
+/*
+ * descending
+ *   DESCRIPTION: qsort order for floats, largest first, NAN last.
+ */
+static int descending(const void* a, const void* b){
+
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+
+    if(isnan(x))
+        return !isnan(y);
+    if(isnan(y))
+        return -1;
+    return (x < y) - (x > y);
+}
+
+/*
+ * permute_shuffle
+ *   DESCRIPTION: Fisher-Yates shuffle of n values with the splitmix64
+ *                stream of counter (seed, stream).
+ *   INPUTS: v      -- values.
+ *           n      -- number of values.
+ *           seed   -- user seed.
+ *           stream -- permutation counter.
+ *   OUTPUTS: v
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void permute_shuffle(float* v, int n, uint64_t seed, uint64_t stream){
+
+    uint64_t base = splitmix64(seed + splitmix64(stream * PERMUTE_GAMMA + PERMUTE_GAMMA));
+    uint64_t u = 0;
+    float tmp = 0.0f;
+    int i, j;                   /* Loop variables. */
+
+    for(i = n - 1; i > 0; i--){
+        /* j uniform in [0, i]: high 32 bits scaled by i + 1. */
+        u = splitmix64(base + (uint64_t)i * PERMUTE_GAMMA);
+        j = (int)(((u >> 32) * (uint64_t)(i + 1)) >> 32);
+        tmp = v[i];
+        v[i] = v[j];
+        v[j] = tmp;
+    }
+}
+
+/*
+ * permutation_create
+ *   DESCRIPTION: Sets up n_perm permutations per trait over an in-memory
+ *                genotype slab.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *           st           -- marker statistics, NULL for none.
+ *           n_perm       -- permutations per trait.
+ *           seed         -- random seed.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated permutation, NULL on failure.
+ *   SIDE EFFECTS: Allocates a permutation.
+ */
+permutation* permutation_create(const float* x, int ldx, int n_marker, int n_individual,
+                                const marker_stats* st, int n_perm, uint64_t seed){
+
+    permutation* pm = NULL;     /* Return argument. */
+
+    if((pm = (permutation*)calloc(1, sizeof(permutation))) == NULL){
+        fprintf(stderr, "cannot allocate memory: permutation*\n");
+        return NULL;
+    }
+    pm->x = x;
+    pm->ldx = ldx;
+    pm->n_marker = n_marker;
+    pm->n_individual = n_individual;
+    pm->st = st;
+    pm->n_perm = n_perm;
+    pm->seed = seed;
+
+    if((pm->max_t = (float*)malloc(n_perm * sizeof(float))) == NULL ||
+       (pm->r = (scan_result*)malloc((size_t)PERMUTE_CHUNK * PERMUTE_BATCH * sizeof(scan_result))) == NULL ||
+       (pm->value = (float*)malloc(n_individual * sizeof(float))) == NULL ||
+       (pm->work = (float*)malloc(n_individual * sizeof(float))) == NULL ||
+       (pm->observed = (int*)malloc(n_individual * sizeof(int))) == NULL ||
+       (pm->index = (int*)malloc(PERMUTE_BATCH * sizeof(int))) == NULL){
+        fprintf(stderr, "cannot allocate memory: permutation*\n");
+        free_permutation(pm);
+        return NULL;
+    }
+
+    return pm;
+}
+
+/*
+ * permutation_trait
+ *   DESCRIPTION: Largest |t| over the markers of every permutation of one
+ *                trait column.
+ *   INPUTS: pm     -- pointer to permutation.
+ *           y      -- trait columns (NAN for missing).
+ *           ldy    -- leading dimension of y.
+ *           column -- trait to permute.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Fills pm->max_t and pm->dist.
+ */
+int permutation_trait(permutation* pm, const float* y, int ldy, int column){
+
+    scan_trait* yp = NULL;      /* Permuted copies of the trait. */
+    const scan_result* rj = NULL;
+    float* yc = NULL;
+    float t = 0.0f;
+    int n_batch = (pm->n_perm < PERMUTE_BATCH) ? pm->n_perm : PERMUTE_BATCH;
+    int n_obs = 0;
+    int n = 0;                  /* Markers in chunk.             */
+    int b0, b, j0, j, i;        /* Loop variables.               */
+
+    /*
+     * Every copy has the same observed individuals, mean and sum of
+     * squares; only the order of the centered values changes.
+     */
+    for(b = 0; b < n_batch; b++)
+        pm->index[b] = column;
+    if((yp = scan_trait_create(y, ldy, pm->n_individual, pm->index, n_batch)) == NULL)
+        return 1;
+    scan_skip_pvalues(yp);
+    pm->dist = yp->dist[0];
+
+    for(i = 0; i < pm->n_individual; i++){
+        if(!isnan(y[(size_t)column * ldy + i])){
+            pm->observed[n_obs] = i;
+            pm->value[n_obs++] = yp->yc[i];
+        }
+    }
+
+    for(b0 = 0; b0 < pm->n_perm; b0 += n_batch){
+        for(b = 0; b < n_batch; b++){
+            yc = yp->yc + (size_t)b * yp->ld;
+            memcpy(pm->work, pm->value, n_obs * sizeof(float));
+            permute_shuffle(pm->work, n_obs, pm->seed, ((uint64_t)column << 32) | (uint64_t)(b0 + b));
+            for(i = 0; i < n_obs; i++)
+                yc[pm->observed[i]] = pm->work[i];
+            if(b0 + b < pm->n_perm)
+                pm->max_t[b0 + b] = 0.0f;
+        }
+
+        for(j0 = 0; j0 < pm->n_marker; j0 += PERMUTE_CHUNK){
+            n = (pm->n_marker - j0 < PERMUTE_CHUNK) ? pm->n_marker - j0 : PERMUTE_CHUNK;
+            scan_single(pm->x + (size_t)j0 * pm->ldx, pm->ldx, n, pm->st, j0, yp, pm->r);
+            for(j = 0; j < n; j++){
+                rj = pm->r + (size_t)j * n_batch;
+                for(b = 0; b < n_batch && b0 + b < pm->n_perm; b++){
+                    t = fabsf(rj[b].t);
+                    if(t > pm->max_t[b0 + b])
+                        pm->max_t[b0 + b] = t;
+                }
+            }
+        }
+    }
+
+    free_scan_trait(yp);
+
+    return 0;
+}
+
+/*
+ * permutation_threshold
+ *   DESCRIPTION: Empirical |t| threshold at level alpha of the last trait.
+ *   INPUTS: pm    -- pointer to permutation.
+ *           alpha -- significance level in (0, 1).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Threshold of |t|.
+ *   SIDE EFFECTS: Sorts pm->max_t.
+ */
+float permutation_threshold(permutation* pm, double alpha){
+
+    int i = (int)floor(alpha * pm->n_perm);
+
+    qsort(pm->max_t, pm->n_perm, sizeof(float), descending);
+
+    return pm->max_t[(i < pm->n_perm) ? i : pm->n_perm - 1];
+}
+
+/*
+ * permutation_write_header
+ *   DESCRIPTION: Writes the column names of the permutation_run table.
+ */
+void permutation_write_header(FILE* f){
+    fprintf(f, "Trait\tPermutations\tAlpha\tT\tP\tNegLog10P\n");
+}
+
+/*
+ * permutation_run
+ *   DESCRIPTION: Writes one line per trait and level: trait name, number
+ *                of permutations, alpha, the |t| threshold and its
+ *                nominal p-value and -log10 p-value.
+ *   INPUTS: pm      -- pointer to permutation.
+ *           y       -- trait columns (NAN for missing).
+ *           ldy     -- leading dimension of y.
+ *           index   -- trait columns to permute.
+ *           n_trait -- number of traits.
+ *           alpha   -- significance levels.
+ *           n_alpha -- number of levels.
+ *           f       -- output stream.
+ *           trait   -- trait names.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f and stderr.
+ */
+int permutation_run(permutation* pm, const float* y, int ldy, const int* index, int n_trait,
+                    const double* alpha, int n_alpha, FILE* f, const name_table* trait){
+
+    double start = wall_time(); /* Permutation timer. */
+    double elapsed = 0.0;
+    float t = 0.0f;
+    float p = 0.0f;
+    float q = 0.0f;
+    int k, a;                   /* Loop variables.    */
+
+    permutation_write_header(f);
+    for(k = 0; k < n_trait; k++){
+        if(permutation_trait(pm, y, ldy, index[k]))
+            return 1;
+        for(a = 0; a < n_alpha; a++){
+            t = permutation_threshold(pm, alpha[a]);
+            tdist_pvalue(&pm->dist, &t, 1, &p, &q);
+            fprintf(f, "%s\t%d\t%g\t%g\t%g\t%g\n",
+                    name_table_get(trait, index[k]), pm->n_perm, alpha[a], t, p, q);
+        }
+    }
+
+    elapsed = wall_time() - start;
+    fprintf(stderr, "Permutations: %d x %d traits\nPermutation time: %.3f s (%.3g scans/s)\n",
+            pm->n_perm, n_trait, elapsed, (elapsed > 0.0) ? (double)pm->n_perm * n_trait / elapsed : 0.0);
+
+    return 0;
+}
+
+/*
+ * free_permutation
+ *   DESCRIPTION: Deallocates memory associated with a permutation.
+ *   INPUTS: pm -- pointer to permutation.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a permutation (x is untouched).
+ */
+void free_permutation(permutation* pm){
+    if(pm != NULL){
+        free(pm->max_t);
+        free(pm->r);
+        free(pm->value);
+        free(pm->work);
+        free(pm->observed);
+        free(pm->index);
+        free(pm);
+    }
+}
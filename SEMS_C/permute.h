@@ -0,0 +1,148 @@
+/* Permutation Test : Header File */
+
+#ifndef PERMUTE_H
+#define PERMUTE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "markerstats.h"
+#include "names.h"
+#include "scan.h"
+
+/* Permuted traits per X^T * Yc product. */
+#define PERMUTE_BATCH 256
+
+/* Markers per result buffer. */
+#define PERMUTE_CHUNK 1024
+
+/* Significance levels reported when -threshold is not given. */
+#define PERMUTE_N_ALPHA 3
+#define PERMUTE_ALPHA   {0.01, 0.05, 0.10}
+
+/*
+ * Empirical genome-wide thresholds of one trait at a time. Permutation b of
+ * the trait shuffles its observed values among its observed individuals
+ * with a Fisher-Yates shuffle driven by splitmix64 at counter
+ * (seed, trait, b), so any permutation can be reproduced on its own. A
+ * batch of PERMUTE_BATCH permuted traits is centered once and scanned with
+ * the multi-trait X^T * Yc product of scan_single, and only the largest
+ * |t| over the markers is kept per permutation. The threshold at level
+ * alpha is the (floor(alpha * n_perm) + 1)-th largest of these maxima.
+ */
+typedef struct {
+    const float* x;             /* Genotype slab.                      */
+    int ldx;
+    int n_marker;
+    int n_individual;
+    const marker_stats* st;     /* Marker statistics, NULL for none.   */
+    int n_perm;
+    uint64_t seed;
+
+    float* max_t;               /* Largest |t| of each permutation.    */
+    scan_result* r;             /* PERMUTE_CHUNK x PERMUTE_BATCH results. */
+    float* value;               /* Observed centered values.           */
+    float* work;                /* The values being shuffled.          */
+    int* observed;              /* Their individuals.                  */
+    int* index;                 /* Trait column, PERMUTE_BATCH times.  */
+    tdist dist;                 /* t distribution of the last trait.   */
+} permutation;
+
+
+
+/*
+ * permute_shuffle
+ *   DESCRIPTION: Fisher-Yates shuffle of n values with the splitmix64
+ *                stream of counter (seed, stream).
+ *   INPUTS: v      -- values.
+ *           n      -- number of values.
+ *           seed   -- user seed.
+ *           stream -- permutation counter.
+ *   OUTPUTS: v
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void permute_shuffle(float* v, int n, uint64_t seed, uint64_t stream);
+
+/*
+ * permutation_create
+ *   DESCRIPTION: Sets up n_perm permutations per trait over an in-memory
+ *                genotype slab.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *           st           -- marker statistics, NULL for none.
+ *           n_perm       -- permutations per trait.
+ *           seed         -- random seed.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated permutation, NULL on failure.
+ *   SIDE EFFECTS: Allocates a permutation.
+ */
+permutation* permutation_create(const float* x, int ldx, int n_marker, int n_individual,
+                                const marker_stats* st, int n_perm, uint64_t seed);
+
+/*
+ * permutation_trait
+ *   DESCRIPTION: Largest |t| over the markers of every permutation of one
+ *                trait column.
+ *   INPUTS: pm     -- pointer to permutation.
+ *           y      -- trait columns (NAN for missing).
+ *           ldy    -- leading dimension of y.
+ *           column -- trait to permute.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Fills pm->max_t and pm->dist.
+ */
+int permutation_trait(permutation* pm, const float* y, int ldy, int column);
+
+/*
+ * permutation_threshold
+ *   DESCRIPTION: Empirical |t| threshold at level alpha of the last trait.
+ *   INPUTS: pm    -- pointer to permutation.
+ *           alpha -- significance level in (0, 1).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Threshold of |t|.
+ *   SIDE EFFECTS: Sorts pm->max_t.
+ */
+float permutation_threshold(permutation* pm, double alpha);
+
+/*
+ * permutation_write_header
+ *   DESCRIPTION: Writes the column names of the permutation_run table.
+ */
+void permutation_write_header(FILE* f);
+
+/*
+ * permutation_run
+ *   DESCRIPTION: Writes one line per trait and level: trait name, number
+ *                of permutations, alpha, the |t| threshold and its
+ *                nominal p-value and -log10 p-value.
+ *   INPUTS: pm      -- pointer to permutation.
+ *           y       -- trait columns (NAN for missing).
+ *           ldy     -- leading dimension of y.
+ *           index   -- trait columns to permute.
+ *           n_trait -- number of traits.
+ *           alpha   -- significance levels.
+ *           n_alpha -- number of levels.
+ *           f       -- output stream.
+ *           trait   -- trait names.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f and stderr.
+ */
+int permutation_run(permutation* pm, const float* y, int ldy, const int* index, int n_trait,
+                    const double* alpha, int n_alpha, FILE* f, const name_table* trait);
+
+/*
+ * free_permutation
+ *   DESCRIPTION: Deallocates memory associated with a permutation.
+ *   INPUTS: pm -- pointer to permutation.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a permutation (x is untouched).
+ */
+void free_permutation(permutation* pm);
+
+#endif
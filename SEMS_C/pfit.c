@@ -0,0 +1,282 @@
+/* Distributed Fit : Function Definition File */
+
+#include "pfit.h"
+#include "dist.h"
+#include "fastio.h"
+
+/*
+ * global_index
+ *   DESCRIPTION: Global row (or column) of local row l of a block-cyclic
+ *                layout whose first block is on process 0.
+ */
+static MKL_INT global_index(MKL_INT l, MKL_INT nb, MKL_INT me, MKL_INT n_proc){
+    return ((l / nb) * n_proc + me) * nb + l % nb;
+}
+
+/*
+ * pfit_fit
+ *   DESCRIPTION: The collective fit of a model on every rank: psgels on
+ *                the block-cyclic design, pstrtri on its R, and the
+ *                coefficients, squared row norms of R^(-1) and residual
+ *                sum of squares summed over the grid.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_individual -- rows of x.
+ *           w            -- weights of the trait, NULL if none missing.
+ *           yc           -- centered trait, 0 where missing.
+ *           term         -- marker of each term, -1: intercept.
+ *           n_term       -- terms.
+ *   OUTPUTS: out -- coefficients (n_term), squared row norms of R^(-1)
+ *                   (n_term) and the residual sum of squares, on every
+ *                   rank.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective.
+ */
+static int pfit_fit(const float* x, int ldx, int n_individual, const float* w, const float* yc,
+                    const int* term, int n_term, double* out){
+
+    MKL_INT ctxt = 0, zero = 0, one = 1, minus_one = -1;
+    MKL_INT n_prow = 0, n_pcol = 0, my_prow = 0, my_pcol = 0;
+    MKL_INT m = n_individual, p = n_term, nb = PFIT_BLOCK;
+    MKL_INT desc_a[9], desc_b[9];
+    MKL_INT m_loc = 0, n_loc = 0, b_loc = 0, lld = 1;
+    MKL_INT lwork = 0, info = 0;
+    MKL_INT i, j, il, jl;       /* Loop variables.                     */
+    float* a = NULL;            /* Local blocks of the design.         */
+    float* b = NULL;            /* Local blocks of y, then of Q^T * y. */
+    float* work = NULL;
+    float query = 0.0f;
+    const float* c = NULL;      /* Column of a term.                   */
+    int n_rank = dist_size();
+    int status = 1;
+
+    /* The tallest grid with at least as many rows as columns. */
+    n_pcol = (MKL_INT)sqrt((double)n_rank);
+    while(n_rank % n_pcol != 0)
+        n_pcol--;
+    n_prow = n_rank / n_pcol;
+    blacs_get_(&minus_one, &zero, &ctxt);
+    blacs_gridinit_(&ctxt, "R", &n_prow, &n_pcol);
+    blacs_gridinfo_(&ctxt, &n_prow, &n_pcol, &my_prow, &my_pcol);
+
+    memset(out, 0, (2 * (size_t)n_term + 1) * sizeof(double));
+    m_loc = numroc_(&m, &nb, &my_prow, &zero, &n_prow);
+    n_loc = numroc_(&p, &nb, &my_pcol, &zero, &n_pcol);
+    b_loc = numroc_(&one, &nb, &my_pcol, &zero, &n_pcol);
+    lld = (m_loc > 1) ? m_loc : 1;
+    descinit_(desc_a, &m, &p, &nb, &nb, &zero, &zero, &ctxt, &lld, &info);
+    if(info == 0)
+        descinit_(desc_b, &m, &one, &nb, &nb, &zero, &zero, &ctxt, &lld, &info);
+    if(info != 0){
+        fprintf(stderr, "descinit: info = %lld\n", (long long)info);
+        goto done;
+    }
+    if((a = (float*)malloc(((m_loc * n_loc > 0) ? m_loc * n_loc : 1) * sizeof(float))) == NULL ||
+       (b = (float*)calloc((m_loc * b_loc > 0) ? m_loc * b_loc : 1, sizeof(float))) == NULL){
+        fprintf(stderr, "cannot allocate memory: distributed design\n");
+        goto done;
+    }
+
+    /* Each process fills its own blocks. */
+    for(jl = 0; jl < n_loc; jl++){
+        j = global_index(jl, nb, my_pcol, n_pcol);
+        c = (term[j] >= 0) ? x + (size_t)term[j] * ldx : NULL;
+        for(il = 0; il < m_loc; il++){
+            i = global_index(il, nb, my_prow, n_prow);
+            a[jl * lld + il] = ((c != NULL) ? c[i] : 1.0f) * ((w != NULL) ? w[i] : 1.0f);
+        }
+    }
+    for(il = 0; il < m_loc && b_loc > 0; il++)
+        b[il] = yc[global_index(il, nb, my_prow, n_prow)];
+
+    psgels_("N", &m, &p, &one, a, &one, &one, desc_a, b, &one, &one, desc_b,
+            &query, &minus_one, &info);
+    lwork = (MKL_INT)query;
+    if((work = (float*)malloc(((lwork > 0) ? lwork : 1) * sizeof(float))) == NULL){
+        fprintf(stderr, "cannot allocate memory: psgels work\n");
+        goto done;
+    }
+    psgels_("N", &m, &p, &one, a, &one, &one, desc_a, b, &one, &one, desc_b,
+            work, &lwork, &info);
+    if(info != 0){
+        fprintf(stderr, "psgels: info = %lld\n", (long long)info);
+        goto done;
+    }
+    pstrtri_("U", "N", &p, a, &one, &one, desc_a, &info);
+    if(info != 0){
+        fprintf(stderr, "pstrtri: info = %lld\n", (long long)info);
+        goto done;
+    }
+
+    /* Rows below p of Q^T * y are the residual. */
+    for(il = 0; il < m_loc && b_loc > 0; il++){
+        i = global_index(il, nb, my_prow, n_prow);
+        if(i < p)
+            out[i] = b[il];
+        else
+            out[2 * p] += (double)b[il] * b[il];
+    }
+    for(jl = 0; jl < n_loc; jl++){
+        j = global_index(jl, nb, my_pcol, n_pcol);
+        for(il = 0; il < m_loc; il++){
+            i = global_index(il, nb, my_prow, n_prow);
+            if(i <= j)
+                out[p + i] += (double)a[jl * lld + il] * a[jl * lld + il];
+        }
+    }
+    status = 0;
+
+done:
+    free(a);
+    free(b);
+    free(work);
+    blacs_gridexit_(&ctxt);
+
+    /* A failure anywhere fails the fit on every rank. */
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if(status == 0)
+        MPI_Allreduce(MPI_IN_PLACE, out, 2 * n_term + 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+    return status;
+}
+
+/*
+ * pfit_wanted
+ *   DESCRIPTION: Whether a model is large enough for the distributed fit.
+ *   INPUTS: n_obs  -- observed individuals.
+ *           n_term -- terms, intercept included.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) with several ranks and at least PFIT_CELLS design
+ *                 cells, (0) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+int pfit_wanted(double n_obs, int n_term){
+    return dist_size() > 1 && n_obs > n_term && n_obs * n_term >= (double)PFIT_CELLS;
+}
+
+/*
+ * pfit_model
+ *   DESCRIPTION: Fits a model over every rank; called on rank 0 while the
+ *                others are in pfit_serve.
+ *   INPUTS: x            -- first marker column (the same on every rank).
+ *           ldx          -- leading dimension of x.
+ *           n_individual -- rows of x.
+ *           w            -- weights of the trait, NULL if none missing.
+ *           yc           -- centered trait, 0 where missing.
+ *           mean         -- mean of the trait.
+ *           n_obs        -- observed individuals.
+ *           term         -- marker of each term, -1: intercept.
+ *           n_term       -- terms, fewer than n_obs.
+ *   OUTPUTS: r -- one result per term: slope holds the coefficient
+ *                (intercept and p-values unset).
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective; writes to stderr.
+ */
+int pfit_model(const float* x, int ldx, int n_individual, const float* w, const float* yc,
+               double mean, double n_obs, const int* term, int n_term, scan_result* r){
+
+    double* out = NULL;         /* Coefficients, norms and RSS. */
+    double start = wall_time(); /* Fit timer.      */
+    double head[2];             /* Terms and whether w is sent. */
+    double sigma = 0.0;
+    int i;                      /* Loop variable.  */
+
+    if((out = (double*)malloc((2 * (size_t)n_term + 1) * sizeof(double))) == NULL){
+        fprintf(stderr, "cannot allocate memory: distributed fit\n");
+        return 1;
+    }
+    head[0] = n_term;
+    head[1] = (w != NULL);
+    MPI_Bcast(head, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    MPI_Bcast((void*)term, n_term, MPI_INT, 0, MPI_COMM_WORLD);
+    MPI_Bcast((void*)yc, n_individual, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    if(w != NULL)
+        MPI_Bcast((void*)w, n_individual, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+    if(pfit_fit(x, ldx, n_individual, w, yc, term, n_term, out)){
+        free(out);
+        return 1;
+    }
+
+    sigma = sqrt(out[2 * n_term] / (n_obs - n_term));
+    for(i = 0; i < n_term; i++){
+        r[i].intercept = NAN;
+        r[i].slope = (float)(out[i] + ((i == 0) ? mean : 0.0));
+        r[i].se = (float)(sigma * sqrt(out[n_term + i]));
+        r[i].t = r[i].slope / r[i].se;
+        r[i].p = r[i].nlog10p = NAN;
+    }
+    fprintf(stderr, "Distributed fit: %d terms x %.0f individuals on %d ranks in %.3f s\n",
+            n_term, n_obs, dist_size(), wall_time() - start);
+    free(out);
+
+    return 0;
+}
+
+/*
+ * pfit_serve
+ *   DESCRIPTION: Joins the fits of rank 0 until pfit_done; called on the
+ *                other ranks.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective.
+ */
+int pfit_serve(const float* x, int ldx, int n_individual){
+
+    int* term = NULL;
+    float* yc = NULL;
+    float* w = NULL;
+    double* out = NULL;
+    double head[2];
+    int n_term = 0;
+    int status = 0;
+
+    for(;;){
+        MPI_Bcast(head, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if((n_term = (int)head[0]) < 1)
+            break;
+        if((term = (int*)malloc(n_term * sizeof(int))) == NULL ||
+           (yc = (float*)malloc(n_individual * sizeof(float))) == NULL ||
+           (head[1] != 0.0 && (w = (float*)malloc(n_individual * sizeof(float))) == NULL) ||
+           (out = (double*)malloc((2 * (size_t)n_term + 1) * sizeof(double))) == NULL){
+            fprintf(stderr, "cannot allocate memory: distributed fit\n");
+            return 1;
+        }
+        MPI_Bcast(term, n_term, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Bcast(yc, n_individual, MPI_FLOAT, 0, MPI_COMM_WORLD);
+        if(w != NULL)
+            MPI_Bcast(w, n_individual, MPI_FLOAT, 0, MPI_COMM_WORLD);
+
+        status = pfit_fit(x, ldx, n_individual, w, yc, term, n_term, out);
+        free(term);
+        free(yc);
+        free(w);
+        free(out);
+        term = NULL;
+        yc = w = NULL;
+        out = NULL;
+        if(status)
+            return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * pfit_done
+ *   DESCRIPTION: Releases the ranks in pfit_serve; called on rank 0.
+ *   INPUTS: None.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Collective.
+ */
+void pfit_done(void){
+
+    double head[2] = {0.0, 0.0};
+
+    if(dist_size() > 1)
+        MPI_Bcast(head, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+}
@@ -0,0 +1,100 @@
+/* Distributed Fit : Header File */
+
+#ifndef PFIT_H
+#define PFIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include "mkl.h"
+#include "mkl_blacs.h"
+#include "mkl_scalapack.h"
+#include "scan.h"
+
+/*
+ * Design cells (observed individuals times terms) from which a final
+ * model is fitted over every rank instead of on rank 0. Compile with
+ * -DPFIT_CELLS=0 to send every model of a multi-rank run there.
+ */
+#ifndef PFIT_CELLS
+#define PFIT_CELLS (1L << 28)
+#endif
+
+/* Rows and columns of a block of the block-cyclic layout. */
+#define PFIT_BLOCK 64
+
+/*
+ * Least-squares fit of one model, y = [1, X_terms] * b, over a BLACS grid
+ * of every rank of MPI_COMM_WORLD. The design is laid out in 2-D
+ * block-cyclic form in PFIT_BLOCK square blocks, and each process fills
+ * its own blocks straight from the genotype every rank holds, so no rank
+ * ever forms the whole design. psgels factors it as Q * R and solves for
+ * b; R is also the Cholesky factor of X^T * X, so pstrtri gives R^(-1),
+ * whose squared row norms are the diagonal of (X^T * X)^(-1) that the
+ * standard errors need. Rows of individuals missing the trait are zero.
+ *
+ * Rank 0 drives: pfit_model sends it each model and the other ranks,
+ * waiting in pfit_serve, join the fit until pfit_done.
+ */
+
+
+
+/*
+ * pfit_wanted
+ *   DESCRIPTION: Whether a model is large enough for the distributed fit.
+ *   INPUTS: n_obs  -- observed individuals.
+ *           n_term -- terms, intercept included.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) with several ranks and at least PFIT_CELLS design
+ *                 cells, (0) otherwise.
+ *   SIDE EFFECTS: None.
+ */
+int pfit_wanted(double n_obs, int n_term);
+
+/*
+ * pfit_model
+ *   DESCRIPTION: Fits a model over every rank; called on rank 0 while the
+ *                others are in pfit_serve.
+ *   INPUTS: x            -- first marker column (the same on every rank).
+ *           ldx          -- leading dimension of x.
+ *           n_individual -- rows of x.
+ *           w            -- weights of the trait, NULL if none missing.
+ *           yc           -- centered trait, 0 where missing.
+ *           mean         -- mean of the trait.
+ *           n_obs        -- observed individuals.
+ *           term         -- marker of each term, -1: intercept.
+ *           n_term       -- terms, fewer than n_obs.
+ *   OUTPUTS: r -- one result per term: slope holds the coefficient
+ *                (intercept and p-values unset).
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective; writes to stderr.
+ */
+int pfit_model(const float* x, int ldx, int n_individual, const float* w, const float* yc,
+               double mean, double n_obs, const int* term, int n_term, scan_result* r);
+
+/*
+ * pfit_serve
+ *   DESCRIPTION: Joins the fits of rank 0 until pfit_done; called on the
+ *                other ranks.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_individual -- rows of x.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective.
+ */
+int pfit_serve(const float* x, int ldx, int n_individual);
+
+/*
+ * pfit_done
+ *   DESCRIPTION: Releases the ranks in pfit_serve; called on rank 0.
+ *   INPUTS: None.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Collective.
+ */
+void pfit_done(void);
+
+#endif
@@ -0,0 +1,326 @@
+/* Result Collection : Function Definition File */
+
+#include "results.h"
+
+/*
+ * weaker
+ *   DESCRIPTION: Heap order: whether test a ranks below test b.
+ */
+static int weaker(const result_entry* a, const result_entry* b){
+    return fabsf(a->r.t) < fabsf(b->r.t);
+}
+
+/*
+ * output_order
+ *   DESCRIPTION: qsort order of result_write: by trait, then by decreasing
+ *                |t|, then by markers.
+ */
+static int output_order(const void* x, const void* y){
+
+    const result_entry* a = (const result_entry*)x;
+    const result_entry* b = (const result_entry*)y;
+    float ta = fabsf(a->r.t);
+    float tb = fabsf(b->r.t);
+
+    if(a->trait != b->trait)
+        return (a->trait > b->trait) - (a->trait < b->trait);
+    if(ta != tb)
+        return (ta < tb) - (ta > tb);
+    if(a->a != b->a)
+        return (a->a > b->a) - (a->a < b->a);
+    return (a->b > b->b) - (a->b < b->b);
+}
+
+/*
+ * heap_push
+ *   DESCRIPTION: Adds e to a min-heap of n entries with room for top,
+ *                replacing the root when the heap is full.
+ *   INPUTS: h   -- heap.
+ *           n   -- entries in h.
+ *           top -- capacity of h.
+ *           e   -- new entry, stronger than the root if h is full.
+ *   OUTPUTS: n
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Reorders h.
+ */
+static void heap_push(result_entry* h, int* n, int top, const result_entry* e){
+
+    result_entry tmp;
+    int i = 0;
+    int c = 0;                  /* Child or parent. */
+
+    if(*n < top){
+        /* Sift up from the new leaf. */
+        i = (*n)++;
+        while(i > 0 && weaker(e, &h[c = (i - 1) / 2])){
+            h[i] = h[c];
+            i = c;
+        }
+        h[i] = *e;
+        return;
+    }
+
+    /* Sift down from the root. */
+    tmp = *e;
+    for(i = 0; (c = 2 * i + 1) < top; i = c){
+        if(c + 1 < top && weaker(&h[c + 1], &h[c]))
+            c++;
+        if(!weaker(&h[c], &tmp))
+            break;
+        h[i] = h[c];
+    }
+    h[i] = tmp;
+}
+
+/*
+ * result_set_create
+ *   DESCRIPTION: Allocates an empty result_set.
+ *   INPUTS: n_trait   -- number of traits.
+ *           top       -- tests kept per trait by |t|, 0 for none.
+ *           threshold -- p-value threshold of the hit list, 0 for none.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated result_set, NULL on failure.
+ *   SIDE EFFECTS: Allocates a result_set.
+ */
+result_set* result_set_create(int n_trait, int top, double threshold){
+
+    result_set* s = NULL;       /* Return argument. */
+
+    if((s = (result_set*)calloc(1, sizeof(result_set))) == NULL){
+        fprintf(stderr, "cannot allocate memory: result_set*\n");
+        return NULL;
+    }
+    s->n_trait = n_trait;
+    s->top = (top > 0) ? top : 0;
+    s->threshold = threshold;
+
+    if((s->n_heap = (int*)calloc(n_trait, sizeof(int))) == NULL ||
+       (s->top > 0 && (s->heap = (result_entry*)malloc((size_t)n_trait * s->top * sizeof(result_entry))) == NULL)){
+        fprintf(stderr, "cannot allocate memory: result_set*\n");
+        free_result_set(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+/*
+ * result_insert
+ *   DESCRIPTION: Slow path of result_add: pushes a test into the heap of
+ *                its trait and/or the hit list.
+ *   INPUTS: s     -- pointer to result_set.
+ *           e     -- test.
+ *           heap  -- whether the test enters the heap.
+ *           hit   -- whether the test is a hit.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s (s->status on allocation failure).
+ */
+void result_insert(result_set* s, const result_entry* e, int heap, int hit){
+
+    result_entry* grown = NULL;
+    long max_hit = 0;
+
+    if(heap)
+        heap_push(s->heap + (size_t)e->trait * s->top, &s->n_heap[e->trait], s->top, e);
+
+    if(hit){
+        if(s->n_hit == s->max_hit){
+            max_hit = (s->max_hit > 0) ? 2 * s->max_hit : RESULTS_HIT_INIT;
+            if((grown = (result_entry*)realloc(s->hit, max_hit * sizeof(result_entry))) == NULL){
+                if(!s->status)
+                    fprintf(stderr, "cannot allocate memory: result hits\n");
+                s->status = 1;
+                return;
+            }
+            s->hit = grown;
+            s->max_hit = max_hit;
+        }
+        s->hit[s->n_hit++] = *e;
+    }
+}
+
+/*
+ * result_add_scan
+ *   DESCRIPTION: Offers the results of scan_single to the set.
+ *   INPUTS: s        -- pointer to result_set.
+ *           first    -- index of the first marker in r.
+ *           n_marker -- number of markers.
+ *           r        -- results of scan_single, s->n_trait per marker.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s.
+ */
+void result_add_scan(result_set* s, int first, int n_marker, const scan_result* r){
+
+    int j, k;                   /* Loop variables. */
+
+    for(j = 0; j < n_marker; j++)
+        for(k = 0; k < s->n_trait; k++)
+            result_add(s, first + j, -1, k, &r[(size_t)j * s->n_trait + k]);
+}
+
+/*
+ * result_floor
+ *   DESCRIPTION: |t| a test of trait k must beat to enter the heap.
+ *   INPUTS: s -- pointer to result_set.
+ *           k -- trait.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Smallest kept |t| once the heap is full, 0 before,
+ *                 INFINITY without a heap.
+ *   SIDE EFFECTS: None.
+ */
+double result_floor(const result_set* s, int k){
+
+    if(s->top == 0)
+        return INFINITY;
+    if(s->n_heap[k] < s->top)
+        return 0.0;
+    return fabsf(s->heap[(size_t)k * s->top].r.t);
+}
+
+/*
+ * result_merge
+ *   DESCRIPTION: Adds every kept test of src to dst.
+ *   INPUTS: dst -- pointer to result_set.
+ *           src -- pointer to result_set with the same traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Updates dst.
+ */
+int result_merge(result_set* dst, const result_set* src){
+
+    const result_entry* e = NULL;
+    result_entry* h = NULL;
+    long i = 0;
+    int k = 0;                  /* Loop variables. */
+
+    for(k = 0; k < src->n_trait && dst->top > 0; k++){
+        h = dst->heap + (size_t)k * dst->top;
+        for(i = 0; i < src->n_heap[k]; i++){
+            e = src->heap + (size_t)k * src->top + i;
+            if(dst->n_heap[k] < dst->top || weaker(&h[0], e))
+                heap_push(h, &dst->n_heap[k], dst->top, e);
+        }
+    }
+    for(i = 0; i < src->n_hit; i++)
+        result_insert(dst, &src->hit[i], 0, 1);
+    dst->n_test += src->n_test;
+    dst->status |= src->status;
+
+    return dst->status;
+}
+
+/*
+ * result_rename_pairs
+ *   DESCRIPTION: Renumbers the markers of every kept pair test, for pairs
+ *                scanned on a subset of the markers.
+ *   INPUTS: s     -- pointer to result_set.
+ *           index -- marker of each subset position.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s (single-marker tests are untouched).
+ */
+void result_rename_pairs(result_set* s, const int* index){
+
+    result_entry* e = NULL;
+    long i = 0;
+    int k = 0;                  /* Loop variables. */
+
+    for(k = 0; k < s->n_trait && s->top > 0; k++){
+        for(i = 0; i < s->n_heap[k]; i++){
+            e = s->heap + (size_t)k * s->top + i;
+            if(e->b >= 0){
+                e->a = index[e->a];
+                e->b = index[e->b];
+            }
+        }
+    }
+    for(i = 0; i < s->n_hit; i++){
+        e = s->hit + i;
+        if(e->b >= 0){
+            e->a = index[e->a];
+            e->b = index[e->b];
+        }
+    }
+}
+
+/*
+ * result_write
+ *   DESCRIPTION: Writes the hits and the top tests of every trait in the
+ *                scan_write format, trait by trait by decreasing |t|; a
+ *                test in both lists is written once. Pairs are named
+ *                "a*b". p-values the scan skipped are computed here.
+ *   INPUTS: s      -- pointer to result_set.
+ *           f      -- output stream.
+ *           marker -- marker names.
+ *           trait  -- trait names of the phenotype.
+ *           y      -- scanned traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f; fills the skipped p-values in s.
+ */
+int result_write(result_set* s, FILE* f, const name_table* marker, const name_table* trait,
+                 const scan_trait* y){
+
+    result_entry* out = NULL;   /* Tests to write. */
+    result_entry* e = NULL;
+    char p[TDIST_PVALUE_CHARS];
+    long n_out = 0;
+    long i = 0;
+    int k = 0;                  /* Loop variables. */
+
+    if(s->status)
+        return 1;
+    if((out = (result_entry*)malloc(((size_t)s->n_trait * s->top + s->n_hit + 1) * sizeof(result_entry))) == NULL){
+        fprintf(stderr, "cannot allocate memory: result_entry*\n");
+        return 1;
+    }
+
+    for(k = 0; k < s->n_trait; k++){
+        for(i = 0; i < s->n_heap[k]; i++){
+            e = s->heap + (size_t)k * s->top + i;
+            if(isnan(e->r.p))
+                tdist_pvalue(&y->dist[k], &e->r.t, 1, &e->r.p, &e->r.nlog10p);
+            if(!(s->threshold > 0.0 && e->r.p <= s->threshold))
+                out[n_out++] = *e;
+        }
+    }
+    if(s->n_hit > 0){
+        memcpy(out + n_out, s->hit, s->n_hit * sizeof(result_entry));
+        n_out += s->n_hit;
+    }
+    qsort(out, n_out, sizeof(result_entry), output_order);
+
+    for(i = 0; i < n_out; i++){
+        e = &out[i];
+        if(e->b < 0)
+            fprintf(f, "%s", name_table_get(marker, e->a));
+        else
+            fprintf(f, "%s*%s", name_table_get(marker, e->a), name_table_get(marker, e->b));
+        fprintf(f, "\t%s\t%g\t%g\t%g\t%g\t%s\t%g\n",
+                name_table_get(trait, y->index[e->trait]),
+                e->r.intercept, e->r.slope, e->r.se, e->r.t,
+                tdist_format_pvalue(p, e->r.p, e->r.nlog10p), e->r.nlog10p);
+    }
+    free(out);
+
+    return 0;
+}
+
+/*
+ * free_result_set
+ *   DESCRIPTION: Deallocates memory associated with a result_set.
+ *   INPUTS: s -- pointer to result_set.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a result_set.
+ */
+void free_result_set(result_set* s){
+    if(s != NULL){
+        free(s->heap);
+        free(s->n_heap);
+        free(s->hit);
+        free(s);
+    }
+}
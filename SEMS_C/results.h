@@ -0,0 +1,185 @@
+/* Result Collection : Header File */
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "names.h"
+#include "scan.h"
+
+/* First allocation of a hit list. */
+#define RESULTS_HIT_INIT 1024
+
+/* One test: marker a (and b for a pair) against trait k of a scan_trait. */
+typedef struct {
+    int a;
+    int b;                      /* Second marker, -1 for none. */
+    int trait;
+    scan_result r;
+} result_entry;
+
+/*
+ * The tests worth keeping from a scan whose full output would be too
+ * large: per trait, the top tests by |t| in a bounded min-heap (the root
+ * is the weakest kept test, so most tests are rejected by one compare),
+ * and every test with p at or below threshold in a growing hit list.
+ * Memory depends on top and the number of hits, not on the number of
+ * tests. A result_set belongs to one thread; threads fill their own and
+ * result_merge combines them once the threads are done.
+ */
+typedef struct {
+    int n_trait;
+    int top;                    /* Heap size per trait, 0 for none.    */
+    double threshold;           /* Hit threshold, 0 for none.          */
+
+    result_entry* heap;         /* Trait k: heap[k * top ...].         */
+    int* n_heap;
+    result_entry* hit;
+    long n_hit;
+    long max_hit;
+    long n_test;                /* Tests offered.                      */
+    int status;                 /* 1 after a failed allocation.        */
+} result_set;
+
+
+
+/*
+ * result_set_create
+ *   DESCRIPTION: Allocates an empty result_set.
+ *   INPUTS: n_trait   -- number of traits.
+ *           top       -- tests kept per trait by |t|, 0 for none.
+ *           threshold -- p-value threshold of the hit list, 0 for none.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated result_set, NULL on failure.
+ *   SIDE EFFECTS: Allocates a result_set.
+ */
+result_set* result_set_create(int n_trait, int top, double threshold);
+
+/*
+ * result_insert
+ *   DESCRIPTION: Slow path of result_add: pushes a test into the heap of
+ *                its trait and/or the hit list.
+ *   INPUTS: s     -- pointer to result_set.
+ *           e     -- test.
+ *           heap  -- whether the test enters the heap.
+ *           hit   -- whether the test is a hit.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s (s->status on allocation failure).
+ */
+void result_insert(result_set* s, const result_entry* e, int heap, int hit);
+
+/*
+ * result_add
+ *   DESCRIPTION: Offers one test to the set.
+ *   INPUTS: s     -- pointer to result_set.
+ *           a, b  -- markers (b = -1 for a single marker).
+ *           trait -- trait of the scan_trait.
+ *           r     -- fitted test.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s.
+ */
+static inline void result_add(result_set* s, int a, int b, int trait, const scan_result* r){
+
+    result_entry e;
+    float t = fabsf(r->t);
+    int heap = 0;
+    int hit = 0;
+
+    s->n_test++;
+    if(isnan(t))
+        return;
+    if(s->top > 0)
+        heap = s->n_heap[trait] < s->top || t > fabsf(s->heap[(size_t)trait * s->top].r.t);
+    hit = s->threshold > 0.0 && r->p <= s->threshold;
+
+    if(heap || hit){
+        e.a = a;
+        e.b = b;
+        e.trait = trait;
+        e.r = *r;
+        result_insert(s, &e, heap, hit);
+    }
+}
+
+/*
+ * result_add_scan
+ *   DESCRIPTION: Offers the results of scan_single to the set.
+ *   INPUTS: s        -- pointer to result_set.
+ *           first    -- index of the first marker in r.
+ *           n_marker -- number of markers.
+ *           r        -- results of scan_single, s->n_trait per marker.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s.
+ */
+void result_add_scan(result_set* s, int first, int n_marker, const scan_result* r);
+
+/*
+ * result_floor
+ *   DESCRIPTION: |t| a test of trait k must beat to enter the heap.
+ *   INPUTS: s -- pointer to result_set.
+ *           k -- trait.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Smallest kept |t| once the heap is full, 0 before,
+ *                 INFINITY without a heap.
+ *   SIDE EFFECTS: None.
+ */
+double result_floor(const result_set* s, int k);
+
+/*
+ * result_merge
+ *   DESCRIPTION: Adds every kept test of src to dst.
+ *   INPUTS: dst -- pointer to result_set.
+ *           src -- pointer to result_set with the same traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Updates dst.
+ */
+int result_merge(result_set* dst, const result_set* src);
+
+/*
+ * result_rename_pairs
+ *   DESCRIPTION: Renumbers the markers of every kept pair test, for pairs
+ *                scanned on a subset of the markers.
+ *   INPUTS: s     -- pointer to result_set.
+ *           index -- marker of each subset position.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s (single-marker tests are untouched).
+ */
+void result_rename_pairs(result_set* s, const int* index);
+
+/*
+ * result_write
+ *   DESCRIPTION: Writes the hits and the top tests of every trait in the
+ *                scan_write format, trait by trait by decreasing |t|; a
+ *                test in both lists is written once. Pairs are named
+ *                "a*b". p-values the scan skipped are computed here.
+ *   INPUTS: s      -- pointer to result_set.
+ *           f      -- output stream.
+ *           marker -- marker names.
+ *           trait  -- trait names of the phenotype.
+ *           y      -- scanned traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f; fills the skipped p-values in s.
+ */
+int result_write(result_set* s, FILE* f, const name_table* marker, const name_table* trait,
+                 const scan_trait* y);
+
+/*
+ * free_result_set
+ *   DESCRIPTION: Deallocates memory associated with a result_set.
+ *   INPUTS: s -- pointer to result_set.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a result_set.
+ */
+void free_result_set(result_set* s);
+
+#endif
@@ -0,0 +1,406 @@
+/* Marker Scan : Function Definition File */
+
+#include "scan.h"
+#include "data.h"
+
+/*
+ * scan_trait_create
+ *   DESCRIPTION: Centers a set of trait columns once for any number of
+ *                scans.
+ *   INPUTS: y            -- trait columns (NAN for missing).
+ *           ldy          -- leading dimension of y.
+ *           n_individual -- rows of y.
+ *           index        -- columns of y to use (copied).
+ *           n_trait      -- number of columns in index.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated scan_trait, NULL on failure.
+ *   SIDE EFFECTS: Allocates a scan_trait.
+ */
+scan_trait* scan_trait_create(const float* y, int ldy, int n_individual,
+                              const int* index, int n_trait){
+
+    scan_trait* t = NULL;       /* Return argument.  */
+    const float* c = NULL;      /* Current column.   */
+    double sum = 0.0;
+    double d = 0.0;
+    int n_missing = 0;
+    int ld = 0;
+    int k, i;                   /* Loop variables.   */
+
+    if((t = (scan_trait*)calloc(1, sizeof(scan_trait))) == NULL){
+        fprintf(stderr, "cannot allocate memory: scan_trait*\n");
+        return NULL;
+    }
+    t->n_individual = n_individual;
+    t->n_trait = n_trait;
+
+    if((t->index = (int*)malloc(n_trait * sizeof(int))) == NULL ||
+       (t->yc = matrix_alloc(n_individual, n_trait, &t->ld)) == NULL ||
+       (t->n = (double*)calloc(n_trait, sizeof(double))) == NULL ||
+       (t->mean = (double*)calloc(n_trait, sizeof(double))) == NULL ||
+       (t->syy = (double*)calloc(n_trait, sizeof(double))) == NULL ||
+       (t->dist = (tdist*)malloc(n_trait * sizeof(tdist))) == NULL ||
+       (t->t_crit = (double*)calloc(n_trait, sizeof(double))) == NULL ||
+       (t->sxy = (float*)malloc(SCAN_BLOCK * n_trait * sizeof(float))) == NULL){
+        fprintf(stderr, "cannot allocate memory: scan_trait*\n");
+        free_scan_trait(t);
+        return NULL;
+    }
+    memcpy(t->index, index, n_trait * sizeof(int));
+
+    for(k = 0; k < n_trait; k++){
+        c = y + (size_t)index[k] * ldy;
+        sum = 0.0;
+        for(i = 0; i < n_individual; i++){
+            if(!isnan(c[i])){
+                sum += c[i];
+                t->n[k] += 1.0;
+            }
+        }
+        t->mean[k] = (t->n[k] > 0.0) ? sum / t->n[k] : 0.0;
+
+        for(i = 0; i < n_individual; i++){
+            if(isnan(c[i])){
+                t->yc[(size_t)k * t->ld + i] = 0.0f;
+                n_missing++;
+            }
+            else{
+                d = c[i] - t->mean[k];
+                t->yc[(size_t)k * t->ld + i] = (float)d;
+                t->syy[k] += d * d;
+            }
+        }
+        tdist_init(&t->dist[k], (t->n[k] > 2.0) ? t->n[k] - 2.0 : 1.0);
+    }
+
+    /* Weights and product buffers only when some value is missing. */
+    if(n_missing > 0){
+        if((t->w = matrix_alloc(n_individual, n_trait, &ld)) == NULL ||
+           (t->xx = matrix_alloc(n_individual, SCAN_BLOCK, &ld)) == NULL ||
+           (t->sx = (float*)malloc(SCAN_BLOCK * n_trait * sizeof(float))) == NULL ||
+           (t->sxx = (float*)malloc(SCAN_BLOCK * n_trait * sizeof(float))) == NULL){
+            fprintf(stderr, "cannot allocate memory: scan_trait*\n");
+            free_scan_trait(t);
+            return NULL;
+        }
+        for(k = 0; k < n_trait; k++){
+            c = y + (size_t)index[k] * ldy;
+            for(i = 0; i < n_individual; i++)
+                t->w[(size_t)k * t->ld + i] = isnan(c[i]) ? 0.0f : 1.0f;
+        }
+    }
+
+    return t;
+}
+
+/*
+ * scan_fit
+ *   DESCRIPTION: Turns the sums of one predictor and trait into the fitted
+ *                single-predictor model.
+ *   INPUTS: n    -- observed individuals.
+ *           sx   -- sum of x.
+ *           sxx  -- sum of x^2.
+ *           sxy  -- x^T * yc.
+ *           mean -- mean of y.
+ *           syy  -- centered sum of squares of y.
+ *           tol  -- relative size below which x counts as constant.
+ *   OUTPUTS: r -- result.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void scan_fit(double n, double sx, double sxx, double sxy, double mean, double syy,
+              double tol, scan_result* r){
+
+    double css = sxx - sx * sx / n;     /* Centered sum of squares of x. */
+    double slope = 0.0;
+    double rss = 0.0;
+    double se = 0.0;
+
+    if(!(css > tol * sxx) || n < 3.0){
+        r->intercept = r->slope = r->se = r->t = NAN;
+        return;
+    }
+
+    slope = sxy / css;
+    rss = syy - slope * sxy;
+    if(rss < 0.0)
+        rss = 0.0;
+
+    se = sqrt(rss / (n - 2.0) / css);
+
+    r->slope = (float)slope;
+    r->intercept = (float)(mean - slope * sx / n);
+    r->se = (float)se;
+    r->t = (float)(slope / se);
+}
+
+/*
+ * scan_set_threshold
+ *   DESCRIPTION: Sets the p-value threshold and the critical |t| of every
+ *                trait, so scan_single only evaluates p-values that can
+ *                pass and scan_write only writes those that do.
+ *   INPUTS: y         -- centered traits.
+ *           threshold -- p-value threshold in (0, 1), 0 for none.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to y.
+ */
+void scan_set_threshold(scan_trait* y, double threshold){
+
+    int k = 0;                  /* Loop variable. */
+
+    y->threshold = threshold;
+    for(k = 0; k < y->n_trait; k++){
+        if(threshold <= 0.0)
+            y->t_crit[k] = 0.0;
+        else if(k > 0 && y->dist[k].df == y->dist[k - 1].df)
+            y->t_crit[k] = y->t_crit[k - 1];
+        else
+            y->t_crit[k] = tdist_critical(&y->dist[k], threshold);
+    }
+}
+
+/*
+ * scan_skip_pvalues
+ *   DESCRIPTION: Makes every critical |t| infinite, so scan_single stops
+ *                at t and leaves every p-value NAN.
+ *   INPUTS: y -- centered traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to y.
+ */
+void scan_skip_pvalues(scan_trait* y){
+
+    int k = 0;                  /* Loop variable. */
+
+    for(k = 0; k < y->n_trait; k++)
+        y->t_crit[k] = INFINITY;
+}
+
+/*
+ * scan_test_trait
+ *   DESCRIPTION: p-values of n results of trait k, for the statistics at
+ *                or above its critical |t|.
+ *   INPUTS: y -- centered traits.
+ *           k -- trait of y.
+ *           n -- number of predictors.
+ *           r -- n * y->n_trait results, r[j * n_trait + t].
+ *   OUTPUTS: r
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void scan_test_trait(const scan_trait* y, int k, int n, scan_result* r){
+
+    float t[SCAN_BLOCK];        /* Statistics that need a p-value. */
+    float p[SCAN_BLOCK];
+    float q[SCAN_BLOCK];
+    int at[SCAN_BLOCK];         /* Their predictors.               */
+    scan_result* rj = NULL;
+    int n_test = 0;
+    int j0, j;                  /* Loop variables.                 */
+
+    for(j0 = 0; j0 < n; j0 += SCAN_BLOCK){
+        n_test = 0;
+        for(j = j0; j < n && j < j0 + SCAN_BLOCK; j++){
+            rj = r + (size_t)j * y->n_trait + k;
+            if(fabs(rj->t) >= y->t_crit[k] || isnan(rj->t)){
+                t[n_test] = rj->t;
+                at[n_test++] = j;
+            }
+            else
+                rj->p = rj->nlog10p = NAN;
+        }
+
+        tdist_pvalue(&y->dist[k], t, n_test, p, q);
+
+        for(j = 0; j < n_test; j++){
+            rj = r + (size_t)at[j] * y->n_trait + k;
+            rj->p = p[j];
+            rj->nlog10p = q[j];
+        }
+    }
+}
+
+/*
+ * scan_test
+ *   DESCRIPTION: p-values of n results per trait, trait by trait, for the
+ *                statistics at or above the critical |t|.
+ *   INPUTS: y -- centered traits.
+ *           n -- number of predictors.
+ *           r -- n * y->n_trait results, r[j * n_trait + t].
+ *   OUTPUTS: r
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void scan_test(const scan_trait* y, int n, scan_result* r){
+
+    int k = 0;                  /* Loop variable. */
+
+    for(k = 0; k < y->n_trait; k++)
+        scan_test_trait(y, k, n, r);
+}
+
+/*
+ * scan_single
+ *   DESCRIPTION: Fits the single-marker model for n_marker consecutive
+ *                markers against every trait of y in one pass over the
+ *                columns: one markers x traits X^T * Yc product per block
+ *                of SCAN_BLOCK markers, plus the per-marker sums (read
+ *                from st for complete markers, two more products against
+ *                the weights when trait values are missing). p-values
+ *                follow per block, skipping |t| below the critical value
+ *                when a threshold is set.
+ *   INPUTS: x        -- first marker column.
+ *           ldx      -- leading dimension of x (>= n_individual).
+ *           n_marker -- number of markers.
+ *           st       -- marker statistics, NULL for none.
+ *           first    -- index of marker x in st.
+ *           y        -- centered traits.
+ *   OUTPUTS: r -- n_marker * y->n_trait results, r[j * n_trait + t].
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Uses the scratch buffers of y.
+ */
+void scan_single(const float* x, int ldx, int n_marker, const marker_stats* st, int first,
+                 scan_trait* y, scan_result* r){
+
+    const float* xb = NULL;     /* First column of the block. */
+    const float* c = NULL;      /* Current column.            */
+    scan_result* rj = NULL;     /* Results of one marker.     */
+    double sx, sxx;
+    int n_block = 0;
+    int m = 0;                  /* Marker index in st.        */
+    int j0, j, k, i;            /* Loop variables.            */
+
+    for(j0 = 0; j0 < n_marker; j0 += SCAN_BLOCK){
+        n_block = (n_marker - j0 < SCAN_BLOCK) ? n_marker - j0 : SCAN_BLOCK;
+        xb = x + (size_t)j0 * ldx;
+
+        /* X^T * Yc for all traits while the block is brought into cache. */
+        cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+                    n_block, y->n_trait, y->n_individual,
+                    1.0f,
+                    xb, ldx,
+                    y->yc, y->ld,
+                    0.0f,
+                    y->sxy, SCAN_BLOCK);
+
+        /* Complete traits: one set of column sums in double, from st or from cache. */
+        if(y->w == NULL){
+            for(j = 0; j < n_block; j++){
+                m = first + j0 + j;
+                if(st != NULL && st->n_missing[m] == 0){
+                    sx = st->sum[m];
+                    sxx = st->sumsq[m];
+                }
+                else{
+                    c = xb + (size_t)j * ldx;
+                    sx = sxx = 0.0;
+                    for(i = 0; i < y->n_individual; i++){
+                        sx += c[i];
+                        sxx += (double)c[i] * c[i];
+                    }
+                }
+                rj = r + (size_t)(j0 + j) * y->n_trait;
+                for(k = 0; k < y->n_trait; k++)
+                    scan_fit(y->n[k], sx, sxx, y->sxy[k * SCAN_BLOCK + j],
+                                y->mean[k], y->syy[k], 1e-9, rj + k);
+            }
+            scan_test(y, n_block, r + (size_t)j0 * y->n_trait);
+            continue;
+        }
+
+        /* Missing values: sums over each trait's observed individuals. */
+        for(j = 0; j < n_block; j++){
+            c = xb + (size_t)j * ldx;
+            for(i = 0; i < y->n_individual; i++)
+                y->xx[(size_t)j * y->ld + i] = c[i] * c[i];
+        }
+        cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+                    n_block, y->n_trait, y->n_individual,
+                    1.0f, xb, ldx, y->w, y->ld,
+                    0.0f, y->sx, SCAN_BLOCK);
+        cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans,
+                    n_block, y->n_trait, y->n_individual,
+                    1.0f, y->xx, y->ld, y->w, y->ld,
+                    0.0f, y->sxx, SCAN_BLOCK);
+
+        /* Single precision sums: a looser test for constant markers. */
+        for(j = 0; j < n_block; j++){
+            rj = r + (size_t)(j0 + j) * y->n_trait;
+            for(k = 0; k < y->n_trait; k++)
+                scan_fit(y->n[k], y->sx[k * SCAN_BLOCK + j], y->sxx[k * SCAN_BLOCK + j],
+                            y->sxy[k * SCAN_BLOCK + j], y->mean[k], y->syy[k], 1e-5, rj + k);
+        }
+        scan_test(y, n_block, r + (size_t)j0 * y->n_trait);
+    }
+}
+
+/*
+ * scan_write_header
+ *   DESCRIPTION: Writes the column names of the scan_write table.
+ */
+void scan_write_header(FILE* f){
+    fprintf(f, "Marker\tTrait\tIntercept\tSlope\tSE\tT\tP\tNegLog10P\n");
+}
+
+/*
+ * scan_write
+ *   DESCRIPTION: Writes one line per marker and trait: marker name, trait
+ *                name, intercept, slope, standard error, t, p and -log10 p.
+ *                With a threshold, only lines with p <= threshold.
+ *   INPUTS: f        -- output stream.
+ *           marker   -- marker names.
+ *           first    -- index of the first marker in r.
+ *           n_marker -- number of markers.
+ *           trait    -- trait names of the phenotype.
+ *           y        -- scanned traits.
+ *           r        -- results of scan_single.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to f.
+ */
+void scan_write(FILE* f, const name_table* marker, int first, int n_marker,
+                const name_table* trait, const scan_trait* y, const scan_result* r){
+
+    const scan_result* rj = NULL;
+    char p[TDIST_PVALUE_CHARS];
+    int j, k;                   /* Loop variables. */
+
+    for(j = 0; j < n_marker; j++){
+        rj = r + (size_t)j * y->n_trait;
+        for(k = 0; k < y->n_trait; k++){
+            if(y->threshold > 0.0 && !(rj[k].p <= y->threshold))
+                continue;
+            fprintf(f, "%s\t%s\t%g\t%g\t%g\t%g\t%s\t%g\n",
+                    name_table_get(marker, first + j), name_table_get(trait, y->index[k]),
+                    rj[k].intercept, rj[k].slope, rj[k].se, rj[k].t,
+                    tdist_format_pvalue(p, rj[k].p, rj[k].nlog10p), rj[k].nlog10p);
+        }
+    }
+}
+
+/*
+ * free_scan_trait
+ *   DESCRIPTION: Deallocates memory associated with a scan_trait.
+ *   INPUTS: y -- pointer to scan_trait.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a scan_trait.
+ */
+void free_scan_trait(scan_trait* y){
+    if(y != NULL){
+        free(y->index);
+        free(y->yc);
+        free(y->w);
+        free(y->n);
+        free(y->mean);
+        free(y->syy);
+        free(y->dist);
+        free(y->t_crit);
+        free(y->sxy);
+        free(y->sx);
+        free(y->sxx);
+        free(y->xx);
+        free(y);
+    }
+}
@@ -0,0 +1,207 @@
+/* Marker Scan : Header File */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mkl.h"
+#include "markerstats.h"
+#include "names.h"
+#include "tdist.h"
+
+/* Markers per X^T * Y product; a block of columns stays in cache. */
+#define SCAN_BLOCK 64
+
+/*
+ * Single-marker model y = intercept + slope * x for one marker and trait.
+ * Markers without variance (or with missing values) give NAN. With a
+ * threshold, p and nlog10p are NAN for markers rejected on |t| alone.
+ */
+typedef struct {
+    float intercept;
+    float slope;
+    float se;                   /* Standard error of slope. */
+    float t;                    /* slope / se.              */
+    float p;                    /* Two-tailed p-value; 0 below
+                                   the smallest float, see
+                                   tdist_format_pvalue.     */
+    float nlog10p;              /* -log10 p                 */
+} scan_result;
+
+/*
+ * Set of centered traits: individuals with a missing value get weight 0
+ * and a centered value of 0, so they drop out of every sum of that trait.
+ * Also holds the per-block scratch of scan_single, so one scan_trait
+ * serves one scan at a time.
+ */
+typedef struct {
+    int n_individual;
+    int n_trait;
+    int ld;                     /* Leading dimension of yc and w.      */
+    int* index;                 /* Phenotype column of each trait.     */
+
+    float* yc;                  /* y - mean(y), 0 where missing.       */
+    float* w;                   /* 1 where observed, 0 where missing;
+                                   NULL when no value is missing.      */
+    double* n;                  /* Observed individuals per trait.     */
+    double* mean;
+    double* syy;                /* Centered sum of squares per trait.  */
+
+    tdist* dist;                /* t distribution with n - 2 df.       */
+    double threshold;           /* p-value threshold, 0 for none.      */
+    double* t_crit;             /* |t| needed to reach threshold.      */
+
+    float* sxy;                 /* Scratch: X^T * yc, SCAN_BLOCK rows. */
+    float* sx;                  /* Scratch: X^T * w.                   */
+    float* sxx;                 /* Scratch: (X o X)^T * w.             */
+    float* xx;                  /* Scratch: X o X for one block.       */
+} scan_trait;
+
+
+
+/*
+ * scan_trait_create
+ *   DESCRIPTION: Centers a set of trait columns once for any number of
+ *                scans.
+ *   INPUTS: y            -- trait columns (NAN for missing).
+ *           ldy          -- leading dimension of y.
+ *           n_individual -- rows of y.
+ *           index        -- columns of y to use (copied).
+ *           n_trait      -- number of columns in index.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated scan_trait, NULL on failure.
+ *   SIDE EFFECTS: Allocates a scan_trait.
+ */
+scan_trait* scan_trait_create(const float* y, int ldy, int n_individual,
+                              const int* index, int n_trait);
+
+/*
+ * scan_set_threshold
+ *   DESCRIPTION: Sets the p-value threshold and the critical |t| of every
+ *                trait, so scan_single only evaluates p-values that can
+ *                pass and scan_write only writes those that do.
+ *   INPUTS: y         -- centered traits.
+ *           threshold -- p-value threshold in (0, 1), 0 for none.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to y.
+ */
+void scan_set_threshold(scan_trait* y, double threshold);
+
+/*
+ * scan_skip_pvalues
+ *   DESCRIPTION: Makes every critical |t| infinite, so scan_single stops
+ *                at t and leaves every p-value NAN.
+ *   INPUTS: y -- centered traits.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to y.
+ */
+void scan_skip_pvalues(scan_trait* y);
+
+/*
+ * scan_fit
+ *   DESCRIPTION: Turns the sums of one predictor and trait into the fitted
+ *                single-predictor model.
+ *   INPUTS: n    -- observed individuals.
+ *           sx   -- sum of x.
+ *           sxx  -- sum of x^2.
+ *           sxy  -- x^T * yc.
+ *           mean -- mean of y.
+ *           syy  -- centered sum of squares of y.
+ *           tol  -- relative size below which x counts as constant.
+ *   OUTPUTS: r -- result (p-value not set).
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void scan_fit(double n, double sx, double sxx, double sxy, double mean, double syy,
+              double tol, scan_result* r);
+
+/*
+ * scan_test_trait
+ *   DESCRIPTION: p-values of n results of trait k, for the statistics at
+ *                or above its critical |t|.
+ *   INPUTS: y -- centered traits.
+ *           k -- trait of y.
+ *           n -- number of predictors.
+ *           r -- n * y->n_trait results, r[j * n_trait + t].
+ *   OUTPUTS: r
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void scan_test_trait(const scan_trait* y, int k, int n, scan_result* r);
+
+/*
+ * scan_test
+ *   DESCRIPTION: p-values of n results per trait, trait by trait, for the
+ *                statistics at or above the critical |t|.
+ *   INPUTS: y -- centered traits.
+ *           n -- number of predictors.
+ *           r -- n * y->n_trait results, r[j * n_trait + t].
+ *   OUTPUTS: r
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void scan_test(const scan_trait* y, int n, scan_result* r);
+
+/*
+ * scan_single
+ *   DESCRIPTION: Fits the single-marker model for n_marker consecutive
+ *                markers against every trait of y in one pass over the
+ *                columns: one markers x traits X^T * Yc product per block
+ *                of SCAN_BLOCK markers, plus the per-marker sums (read
+ *                from st for complete markers, two more products against
+ *                the weights when trait values are missing). p-values
+ *                follow per block, skipping |t| below the critical value
+ *                when a threshold is set.
+ *   INPUTS: x        -- first marker column.
+ *           ldx      -- leading dimension of x (>= n_individual).
+ *           n_marker -- number of markers.
+ *           st       -- marker statistics, NULL for none.
+ *           first    -- index of marker x in st.
+ *           y        -- centered traits.
+ *   OUTPUTS: r -- n_marker * y->n_trait results, r[j * n_trait + t].
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Uses the scratch buffers of y.
+ */
+void scan_single(const float* x, int ldx, int n_marker, const marker_stats* st, int first,
+                 scan_trait* y, scan_result* r);
+
+/*
+ * scan_write
+ *   DESCRIPTION: Writes one line per marker and trait: marker name, trait
+ *                name, intercept, slope, standard error, t, p and -log10 p.
+ *                With a threshold, only lines with p <= threshold.
+ *   INPUTS: f        -- output stream.
+ *           marker   -- marker names.
+ *           first    -- index of the first marker in r.
+ *           n_marker -- number of markers.
+ *           trait    -- trait names of the phenotype.
+ *           y        -- scanned traits.
+ *           r        -- results of scan_single.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to f.
+ */
+void scan_write(FILE* f, const name_table* marker, int first, int n_marker,
+                const name_table* trait, const scan_trait* y, const scan_result* r);
+
+/*
+ * scan_write_header
+ *   DESCRIPTION: Writes the column names of the scan_write table.
+ */
+void scan_write_header(FILE* f);
+
+/*
+ * free_scan_trait
+ *   DESCRIPTION: Deallocates memory associated with a scan_trait.
+ *   INPUTS: y -- pointer to scan_trait.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a scan_trait.
+ */
+void free_scan_trait(scan_trait* y);
+
+#endif
@@ -0,0 +1,261 @@
+/* Task Scheduler : Function Definition File */
+
+#include "scheduler.h"
+#include "fastio.h"
+
+/* One thread of a sched_run. */
+typedef struct {
+    sched* s;
+    int id;
+    double busy;                /* Seconds inside tasks in this run.   */
+} sched_worker;
+
+/*
+ * sched_create
+ *   DESCRIPTION: Creates a scheduler for n_threads threads.
+ *   INPUTS: n_threads -- number of threads.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated sched, NULL on failure.
+ *   SIDE EFFECTS: Allocates a sched.
+ */
+sched* sched_create(int n_threads){
+
+    sched* s = NULL;            /* Return argument. */
+    int k = 0;                  /* Loop variable.   */
+
+    if(n_threads < 1)
+        n_threads = 1;
+    if((s = (sched*)calloc(1, sizeof(sched))) == NULL ||
+       (s->q = (sched_queue*)calloc(n_threads, sizeof(sched_queue))) == NULL){
+        fprintf(stderr, "cannot allocate memory: sched*\n");
+        free(s);
+        return NULL;
+    }
+    s->n_threads = n_threads;
+    for(k = 0; k < n_threads; k++)
+        pthread_mutex_init(&s->q[k].lock, NULL);
+
+    return s;
+}
+
+/*
+ * sched_pop
+ *   DESCRIPTION: Takes the first task of a deque.
+ *   INPUTS: q -- deque.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Task, -1 if the deque is empty.
+ *   SIDE EFFECTS: Updates q.
+ */
+static long sched_pop(sched_queue* q){
+
+    long t = -1;                /* Return argument. */
+
+    pthread_mutex_lock(&q->lock);
+    if(q->count > 0){
+        t = q->next;
+        q->next += q->step;
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return t;
+}
+
+/*
+ * sched_steal
+ *   DESCRIPTION: Moves the back half of the fullest other deque (a lone
+ *                task included) to the empty deque of thread id.
+ *   INPUTS: s  -- pointer to sched.
+ *           id -- thread.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if tasks were stolen, (0) once every deque is empty.
+ *   SIDE EFFECTS: Updates two deques.
+ */
+static int sched_steal(sched* s, int id){
+
+    sched_queue* v = NULL;      /* Victim.          */
+    long most = 0, count = 0;
+    long h = 0, next = 0, step = 1;
+    int k = 0;                  /* Loop variable.   */
+
+    for(;;){
+        v = NULL;
+        most = 0;
+        for(k = 0; k < s->n_threads; k++){
+            if(k == id)
+                continue;
+            pthread_mutex_lock(&s->q[k].lock);
+            count = s->q[k].count;
+            pthread_mutex_unlock(&s->q[k].lock);
+            if(count > most){
+                most = count;
+                v = &s->q[k];
+            }
+        }
+        if(v == NULL)
+            return 0;
+
+        /* The victim may have run dry since; look again if so. */
+        pthread_mutex_lock(&v->lock);
+        if((count = v->count) > 0){
+            h = (count > 1) ? count / 2 : 1;
+            next = v->next + (count - h) * v->step;
+            step = v->step;
+            v->count -= h;
+        }
+        pthread_mutex_unlock(&v->lock);
+        if(count > 0)
+            break;
+    }
+
+    pthread_mutex_lock(&s->q[id].lock);
+    s->q[id].next = next;
+    s->q[id].step = step;
+    s->q[id].count = h;
+    s->q[id].n_steal++;
+    pthread_mutex_unlock(&s->q[id].lock);
+
+    return 1;
+}
+
+/*
+ * sched_thread
+ *   DESCRIPTION: Thread body of sched_run: runs the tasks of its own
+ *                deque, then steals until every deque is empty.
+ *   INPUTS: arg -- pointer to sched_worker.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: NULL
+ *   SIDE EFFECTS: Runs tasks.
+ */
+static void* sched_thread(void* arg){
+
+    sched_worker* w = (sched_worker*)arg;
+    sched* s = w->s;
+    sched_queue* q = &s->q[w->id];
+    double start = 0.0;
+    long t = 0;
+
+    for(;;){
+        if((t = sched_pop(q)) < 0){
+            if(!sched_steal(s, w->id))
+                break;
+            continue;
+        }
+        start = wall_time();
+        s->body(s->arg, w->id, t);
+        w->busy += wall_time() - start;
+        q->n_run++;
+    }
+
+    return NULL;
+}
+
+/*
+ * sched_run
+ *   DESCRIPTION: Runs body(arg, thread, task) for every task on the
+ *                threads and returns when all are done. Thread 0 is the
+ *                calling thread.
+ *   INPUTS: s      -- pointer to sched.
+ *           n_task -- number of tasks.
+ *           body   -- task function.
+ *           arg    -- first argument of body.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) once every task has run, (1) on failure (none has).
+ *                 A thread that cannot be started leaves its deque to
+ *                 the others.
+ *   SIDE EFFECTS: Updates the thread times of s.
+ */
+int sched_run(sched* s, long n_task, sched_task body, void* arg){
+
+    sched_worker* w = NULL;     /* One per thread.  */
+    pthread_t* tid = NULL;
+    double start = wall_time(); /* Run timer.       */
+    double elapsed = 0.0;
+    int n = s->n_threads;
+    int started = 1;            /* Threads to join. */
+    int k = 0;                  /* Loop variable.   */
+
+    if((w = (sched_worker*)calloc(n, sizeof(sched_worker))) == NULL ||
+       (tid = (pthread_t*)malloc(n * sizeof(pthread_t))) == NULL){
+        fprintf(stderr, "cannot allocate memory: sched threads\n");
+        free(w);
+        return 1;
+    }
+    s->body = body;
+    s->arg = arg;
+    for(k = 0; k < n; k++){
+        w[k].s = s;
+        w[k].id = k;
+        s->q[k].next = k;
+        s->q[k].step = n;
+        s->q[k].count = (n_task > k) ? (n_task - k + n - 1) / n : 0;
+    }
+
+    for(k = 1; k < n && n_task > 1; k++, started++){
+        if(pthread_create(&tid[k], NULL, sched_thread, &w[k]) != 0){
+            fprintf(stderr, "cannot start scheduler thread\n");
+            break;
+        }
+    }
+    /* Deques of threads that did not start are stolen by the others. */
+    sched_thread(&w[0]);
+    for(k = 1; k < started; k++)
+        pthread_join(tid[k], NULL);
+
+    elapsed = wall_time() - start;
+    for(k = 0; k < n; k++){
+        s->q[k].busy += w[k].busy;
+        s->q[k].idle += elapsed - w[k].busy;
+    }
+    free(w);
+    free(tid);
+
+    return 0;
+}
+
+/*
+ * sched_report
+ *   DESCRIPTION: Writes the tasks, steals, busy and idle time of every
+ *                thread and the spread of busy time.
+ *   INPUTS: s -- pointer to sched.
+ *           f -- output stream.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to f.
+ */
+void sched_report(const sched* s, FILE* f){
+
+    double lo = 0.0, hi = 0.0, sum = 0.0;
+    int k = 0;                  /* Loop variable. */
+
+    for(k = 0; k < s->n_threads; k++){
+        fprintf(f, "Thread %d: %ld tasks, %ld steals, busy %.3f s, idle %.3f s\n",
+                k, s->q[k].n_run, s->q[k].n_steal, s->q[k].busy, s->q[k].idle);
+        if(k == 0 || s->q[k].busy < lo)
+            lo = s->q[k].busy;
+        if(k == 0 || s->q[k].busy > hi)
+            hi = s->q[k].busy;
+        sum += s->q[k].busy;
+    }
+    fprintf(f, "Busy time: min %.3f s, mean %.3f s, max %.3f s\n", lo, sum / s->n_threads, hi);
+}
+
+/*
+ * free_sched
+ *   DESCRIPTION: Deallocates memory associated with a sched.
+ *   INPUTS: s -- pointer to sched.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a sched.
+ */
+void free_sched(sched* s){
+
+    int k = 0;                  /* Loop variable. */
+
+    if(s != NULL){
+        for(k = 0; k < s->n_threads; k++)
+            pthread_mutex_destroy(&s->q[k].lock);
+        free(s->q);
+        free(s);
+    }
+}
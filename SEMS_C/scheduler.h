@@ -0,0 +1,95 @@
+/* Task Scheduler : Header File */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*
+ * Work-stealing scheduler for independent tasks 0 .. n_task - 1 of uneven
+ * cost, such as tile pairs near the diagonal or pruned by a bound. Tasks
+ * are dealt round-robin, so thread k starts with k, k + n_threads, ...;
+ * each thread's deque is therefore an arithmetic run (next, step, count)
+ * and needs no storage. A thread takes tasks from the front of its own
+ * deque, in the order they were dealt; when it runs dry it steals the
+ * back half of the fullest deque, itself a run with the same step. Each
+ * deque has its own lock, taken once per task and per steal. Busy time
+ * (inside tasks) and idle time (stealing and waiting for the others) are
+ * kept per thread across runs.
+ */
+typedef void (*sched_task)(void* arg, int thread, long task);
+
+typedef struct {
+    pthread_mutex_t lock;
+    long next;                  /* First task of the deque.            */
+    long step;
+    long count;                 /* Tasks left.                         */
+
+    double busy;                /* Seconds inside tasks.               */
+    double idle;                /* Seconds in runs outside tasks.      */
+    long n_run;                 /* Tasks run.                          */
+    long n_steal;               /* Successful steals.                  */
+} sched_queue;
+
+typedef struct {
+    int n_threads;
+    sched_queue* q;
+
+    sched_task body;            /* Task of the current run.            */
+    void* arg;
+} sched;
+
+
+
+/*
+ * sched_create
+ *   DESCRIPTION: Creates a scheduler for n_threads threads.
+ *   INPUTS: n_threads -- number of threads.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated sched, NULL on failure.
+ *   SIDE EFFECTS: Allocates a sched.
+ */
+sched* sched_create(int n_threads);
+
+/*
+ * sched_run
+ *   DESCRIPTION: Runs body(arg, thread, task) for every task on the
+ *                threads and returns when all are done. Thread 0 is the
+ *                calling thread.
+ *   INPUTS: s      -- pointer to sched.
+ *           n_task -- number of tasks.
+ *           body   -- task function.
+ *           arg    -- first argument of body.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) once every task has run, (1) on failure (none has).
+ *                 A thread that cannot be started leaves its deque to
+ *                 the others.
+ *   SIDE EFFECTS: Updates the thread times of s.
+ */
+int sched_run(sched* s, long n_task, sched_task body, void* arg);
+
+/*
+ * sched_report
+ *   DESCRIPTION: Writes the tasks, steals, busy and idle time of every
+ *                thread and the spread of busy time.
+ *   INPUTS: s -- pointer to sched.
+ *           f -- output stream.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Writes to f.
+ */
+void sched_report(const sched* s, FILE* f);
+
+/*
+ * free_sched
+ *   DESCRIPTION: Deallocates memory associated with a sched.
+ *   INPUTS: s -- pointer to sched.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a sched.
+ */
+void free_sched(sched* s);
+
+#endif
@@ -0,0 +1,773 @@
+/* Stepwise Model Selection : Function Definition File */
+
+#include "stepwise.h"
+#include "data.h"
+#include "fastio.h"
+
+#define LAYOUT      CblasColMajor
+#define LP_LAYOUT   LAPACK_COL_MAJOR
+
+/*
+ * term_pvalue
+ *   DESCRIPTION: Two-tailed p-value of one t statistic.
+ *   INPUTS: t  -- statistic.
+ *           df -- degrees of freedom.
+ *   OUTPUTS: nlog10p -- -log10 of the p-value, exact where the p-value
+ *                       underflows to 0.
+ *   RETURN VALUE: p-value.
+ *   SIDE EFFECTS: None.
+ */
+static float term_pvalue(float t, double df, float* nlog10p){
+
+    tdist d;
+    float p = NAN;
+
+    tdist_init(&d, df);
+    tdist_pvalue(&d, &t, 1, &p, nlog10p);
+
+    return p;
+}
+
+/*
+ * counted
+ *   DESCRIPTION: Passes an allocation of s through, counting it in debug
+ *                builds.
+ */
+static void* counted(stepwise* s, void* ptr){
+#ifdef DEBUG
+    if(ptr != NULL)
+        s->n_alloc++;
+#else
+    (void)s;
+#endif
+    return ptr;
+}
+
+/*
+ * stepwise_create
+ *   DESCRIPTION: Allocates a stepwise selection over an in-memory genotype
+ *                slab for models of up to max_terms markers.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *           st           -- marker statistics, NULL for none.
+ *           max_terms    -- largest model, intercept excluded.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated stepwise, NULL on failure.
+ *   SIDE EFFECTS: Allocates a stepwise.
+ */
+stepwise* stepwise_create(const float* x, int ldx, int n_marker, int n_individual,
+                          const marker_stats* st, int max_terms){
+
+    stepwise* s = NULL;         /* Return argument. */
+    size_t p = 0;               /* Largest order of R. */
+
+    /* A model needs a residual degree of freedom left over. */
+    if(max_terms > n_marker)
+        max_terms = n_marker;
+    if(max_terms > n_individual - 2)
+        max_terms = n_individual - 2;
+    if(max_terms < 1){
+        fprintf(stderr, "stepwise: too few markers or individuals\n");
+        return NULL;
+    }
+    p = (size_t)max_terms + 1;
+
+    if((s = (stepwise*)calloc(1, sizeof(stepwise))) == NULL){
+        fprintf(stderr, "cannot allocate memory: stepwise*\n");
+        return NULL;
+    }
+    counted(s, s);
+    s->x = x;
+    s->ldx = ldx;
+    s->n_marker = n_marker;
+    s->n_individual = n_individual;
+    s->st = st;
+    s->max_terms = max_terms;
+
+    s->ldq = n_individual;
+
+    if((s->q = (double*)counted(s, malloc((size_t)n_individual * p * sizeof(double)))) == NULL ||
+       (s->e = (double*)counted(s, malloc(n_individual * sizeof(double)))) == NULL ||
+       (s->qe = (float*)counted(s, matrix_alloc(n_individual, 2, &s->ldqe))) == NULL ||
+       (s->r = (double*)counted(s, calloc(p * p, sizeof(double)))) == NULL ||
+       (s->rinv = (double*)counted(s, malloc(p * p * sizeof(double)))) == NULL ||
+       (s->z = (double*)counted(s, malloc(p * sizeof(double)))) == NULL ||
+       (s->h = (double*)counted(s, malloc(p * sizeof(double)))) == NULL ||
+       (s->est = (scan_result*)counted(s, malloc(p * sizeof(scan_result)))) == NULL ||
+       (s->term = (int*)counted(s, malloc(p * sizeof(int)))) == NULL ||
+       (s->entry_p = (float*)counted(s, malloc(p * sizeof(float)))) == NULL ||
+       (s->entry_nlog10p = (float*)counted(s, malloc(p * sizeof(float)))) == NULL ||
+       (s->proj = (float*)counted(s, malloc((size_t)n_marker * 2 * sizeof(float)))) == NULL ||
+       (s->norm = (double*)counted(s, malloc(n_marker * sizeof(double)))) == NULL ||
+       (s->sxx = (double*)counted(s, malloc(n_marker * sizeof(double)))) == NULL){
+        fprintf(stderr, "cannot allocate memory: stepwise*\n");
+        free_stepwise(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+/*
+ * stepwise_start
+ *   DESCRIPTION: Starts a new selection from the intercept-only model of
+ *                trait k.
+ *   INPUTS: s -- pointer to stepwise.
+ *           y -- centered traits.
+ *           k -- trait of y.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Resets s; one pass over the genotype.
+ */
+void stepwise_start(stepwise* s, const scan_trait* y, int k){
+
+    int n = s->n_individual;
+    const float* yc = y->yc + (size_t)k * y->ld;
+    const float* c = NULL;      /* Current column. */
+    double sx = 0.0;
+    double sxx = 0.0;
+    double q0 = 0.0;
+    int i, j;                   /* Loop variables. */
+
+    s->w = (y->w != NULL) ? y->w + (size_t)k * y->ld : NULL;
+    s->yc = yc;
+    s->n_obs = y->n[k];
+    s->mean = y->mean[k];
+    s->rss = y->syy[k];
+    for(i = 0; i < n; i++){
+        s->e[i] = yc[i];
+        s->qe[s->ldqe + i] = yc[i];
+    }
+
+    /* The intercept: q = w / sqrt(n), R = sqrt(n), and yc has no part in it. */
+    q0 = (s->n_obs > 0.0) ? 1.0 / sqrt(s->n_obs) : 0.0;
+    for(i = 0; i < n; i++)
+        s->q[i] = (s->w != NULL) ? s->w[i] * q0 : q0;
+    s->r[0] = sqrt(s->n_obs);
+    s->z[0] = 0.0;
+    s->term[0] = -1;
+    s->entry_p[0] = s->entry_nlog10p[0] = NAN;
+    s->n_term = 1;
+
+    /* Residual norms against the intercept, complete markers of complete traits from st. */
+    for(j = 0; j < s->n_marker; j++){
+        if(s->w == NULL && s->st != NULL && s->st->n_missing[j] == 0){
+            s->sxx[j] = s->st->sumsq[j];
+            s->norm[j] = s->st->css[j];
+            continue;
+        }
+        c = s->x + (size_t)j * s->ldx;
+        sx = sxx = 0.0;
+        if(s->w != NULL){
+            for(i = 0; i < n; i++){
+                sx += s->w[i] * c[i];
+                sxx += s->w[i] * c[i] * c[i];
+            }
+        }
+        else{
+            for(i = 0; i < n; i++){
+                sx += c[i];
+                sxx += (double)c[i] * c[i];
+            }
+        }
+        s->sxx[j] = sxx;
+        s->norm[j] = (s->n_obs > 0.0) ? sxx - sx * sx / s->n_obs : 0.0;
+    }
+
+    /* x_c^T * e; missing individuals have e = 0. */
+    cblas_sgemv(LAYOUT, CblasTrans, n, s->n_marker, 1.0f, s->x, s->ldx, s->qe + s->ldqe, 1,
+                0.0f, s->proj + s->n_marker, 1);
+}
+
+/*
+ * stepwise_forward
+ *   DESCRIPTION: Adds the candidate that lowers the residual sum of
+ *                squares most, if its p-value in the larger model is at
+ *                most threshold.
+ *   INPUTS: s         -- pointer to stepwise.
+ *           threshold -- entry p-value threshold.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if a term entered, (0) otherwise.
+ *   SIDE EFFECTS: Updates s; one pass over the genotype.
+ */
+int stepwise_forward(stepwise* s, double threshold){
+
+    int n = s->n_individual;
+    int k = s->n_term;          /* Column of the new term. */
+    int ldr = s->max_terms + 1;
+    double* v = s->q + (size_t)k * s->ldq;
+    const float* score = s->proj + s->n_marker;
+    const float* c = NULL;
+    double df = s->n_obs - k - 1.0;
+    double gain = 0.0;
+    double best_gain = 0.0;
+    double rkk = 0.0;
+    double zk = 0.0;
+    double sum = 0.0;
+    float t = 0.0f;
+    float p = 0.0f;
+    float nlog10p = 0.0f;
+    int best = 0;
+    int i, j, pass;             /* Loop variables. */
+
+    if(k > s->max_terms || df < 1.0)
+        return 0;
+
+    for(;;){
+        /* Candidate that explains the most of the residual. */
+        best = -1;
+        best_gain = 0.0;
+        for(j = 0; j < s->n_marker; j++){
+            if(!(s->norm[j] > STEPWISE_TOL * s->sxx[j]))
+                continue;
+            gain = (double)score[j] * score[j] / s->norm[j];
+            if(gain > best_gain){
+                best_gain = gain;
+                best = j;
+            }
+        }
+        if(best < 0)
+            return 0;
+
+        /* Orthogonalize W * x_best against Q, twice so Q stays orthogonal. */
+        c = s->x + (size_t)best * s->ldx;
+        for(i = 0; i < n; i++)
+            v[i] = (s->w != NULL) ? s->w[i] * c[i] : c[i];
+        for(i = 0; i < k; i++)
+            s->r[(size_t)k * ldr + i] = 0.0;
+        for(pass = 0; pass < 2; pass++){
+            cblas_dgemv(LAYOUT, CblasTrans, n, k, 1.0, s->q, s->ldq, v, 1, 0.0, s->h, 1);
+            cblas_dgemv(LAYOUT, CblasNoTrans, n, k, -1.0, s->q, s->ldq, s->h, 1, 1.0, v, 1);
+            cblas_daxpy(k, 1.0, s->h, 1, s->r + (size_t)k * ldr, 1);
+        }
+        sum = cblas_ddot(n, v, 1, v, 1);
+
+        /* The updated norm was too optimistic: dependent on the model. */
+        if(!(sum > STEPWISE_TOL * s->sxx[best])){
+            s->norm[best] = 0.0;
+            continue;
+        }
+        break;
+    }
+
+    rkk = sqrt(sum);
+    cblas_dscal(n, 1.0 / rkk, v, 1);
+
+    /* t of the new term in the larger model. */
+    zk = cblas_ddot(n, v, 1, s->e, 1);
+    sum = s->rss - zk * zk;
+    if(sum < 0.0)
+        sum = 0.0;
+    t = (float)(zk / sqrt(sum / df));
+    p = term_pvalue(t, df, &nlog10p);
+    if(!(p <= threshold))
+        return 0;
+
+    s->r[(size_t)k * ldr + k] = rkk;
+    s->z[k] = zk;
+    s->term[k] = best;
+    s->entry_p[k] = p;
+    s->entry_nlog10p[k] = nlog10p;
+    s->n_term++;
+
+    cblas_daxpy(n, -zk, v, 1, s->e, 1);
+    s->rss = cblas_ddot(n, s->e, 1, s->e, 1);
+
+    /* One pass over X updates every norm and every x_c^T * e. */
+    for(i = 0; i < n; i++){
+        s->qe[i] = (float)v[i];
+        s->qe[s->ldqe + i] = (float)s->e[i];
+    }
+    cblas_sgemm(LAYOUT, CblasTrans, CblasNoTrans,
+                s->n_marker, 2, n,
+                1.0f,
+                s->x, s->ldx,
+                s->qe, s->ldqe,
+                0.0f,
+                s->proj, s->n_marker);
+    for(j = 0; j < s->n_marker; j++)
+        s->norm[j] -= (double)s->proj[j] * s->proj[j];
+    s->norm[best] = 0.0;
+
+    return 1;
+}
+
+/*
+ * term_statistics
+ *   DESCRIPTION: Coefficients, standard errors and t statistics of the
+ *                current model, without p-values.
+ *   INPUTS: s -- pointer to stepwise.
+ *   OUTPUTS: r -- one result per term, intercept first.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Uses the R^(-1) scratch of s.
+ */
+static int term_statistics(const stepwise* s, scan_result* r){
+
+    int p = s->n_term;
+    int ldr = s->max_terms + 1;
+    double df = s->n_obs - p;
+    double sigma = (df > 0.0) ? sqrt(s->rss / df) : NAN;
+    double beta = 0.0;
+    double norm = 0.0;
+    lapack_int info = 0;
+    int i, j;                   /* Loop variables. */
+
+    for(j = 0; j < p; j++)
+        memcpy(s->rinv + (size_t)j * p, s->r + (size_t)j * ldr, p * sizeof(double));
+    if((info = LAPACKE_dtrtri(LP_LAYOUT, 'U', 'N', p, s->rinv, p)) != 0){
+        fprintf(stderr, "dtrtri: info = %lld\n", info);
+        return 1;
+    }
+
+    for(i = 0; i < p; i++){
+        beta = norm = 0.0;
+        for(j = i; j < p; j++){
+            beta += s->rinv[(size_t)j * p + i] * s->z[j];
+            norm += s->rinv[(size_t)j * p + i] * s->rinv[(size_t)j * p + i];
+        }
+        if(i == 0)
+            beta += s->mean;
+
+        r[i].intercept = NAN;
+        r[i].slope = (float)beta;
+        r[i].se = (float)(sigma * sqrt(norm));
+        r[i].t = r[i].slope / r[i].se;
+        r[i].p = r[i].nlog10p = NAN;
+    }
+
+    return 0;
+}
+
+/*
+ * stepwise_estimates
+ *   DESCRIPTION: Coefficients of the current model, R^(-1) * Q^T * yc, and
+ *                their standard errors from the row norms of R^(-1). A
+ *                model past pfit_wanted goes to pfit_model instead.
+ *   INPUTS: s -- pointer to stepwise.
+ *   OUTPUTS: r -- one result per term, intercept first: slope holds the
+ *                coefficient (intercept is unused), p and nlog10p set.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective when the model goes to pfit_model.
+ */
+int stepwise_estimates(const stepwise* s, scan_result* r){
+
+    double df = s->n_obs - s->n_term;
+    int i;                      /* Loop variable. */
+
+    if(pfit_wanted(s->n_obs, s->n_term) ?
+       pfit_model(s->x, s->ldx, s->n_individual, s->w, s->yc, s->mean, s->n_obs,
+                  s->term, s->n_term, r) :
+       term_statistics(s, r))
+        return 1;
+    for(i = 0; i < s->n_term; i++)
+        if(df > 0.0)
+            r[i].p = term_pvalue(r[i].t, df, &r[i].nlog10p);
+
+    return 0;
+}
+
+/*
+ * stepwise_remove
+ *   DESCRIPTION: Drops term i from the model without refitting. Deleting
+ *                column i of R leaves it upper Hessenberg from column i on;
+ *                Givens rotations of rows (j, j + 1) restore the triangle
+ *                and are applied to the columns of Q and to Q^T * yc as
+ *                well. The last column of Q is then the direction that
+ *                left the model: its part of yc returns to the residual and
+ *                its projections return to the candidate norms.
+ *   INPUTS: s -- pointer to stepwise.
+ *           i -- term to drop (not the intercept).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s; one pass over the genotype.
+ */
+void stepwise_remove(stepwise* s, int i){
+
+    int n = s->n_individual;
+    int p = s->n_term;
+    int ldr = s->max_terms + 1;
+    double* qd = s->q + (size_t)(p - 1) * s->ldq;
+    double a = 0.0;
+    double b = 0.0;
+    double c = 0.0;
+    double sn = 0.0;
+    double rho = 0.0;
+    double zd = 0.0;
+    int j;                      /* Loop variable. */
+
+    /* Delete column i of R and the entry of the term. */
+    for(j = i; j < p - 1; j++){
+        memcpy(s->r + (size_t)j * ldr, s->r + (size_t)(j + 1) * ldr, (j + 2) * sizeof(double));
+        s->term[j] = s->term[j + 1];
+        s->entry_p[j] = s->entry_p[j + 1];
+        s->entry_nlog10p[j] = s->entry_nlog10p[j + 1];
+    }
+
+    /* Zero the subdiagonal of columns i .. p - 2. */
+    for(j = i; j < p - 1; j++){
+        a = s->r[(size_t)j * ldr + j];
+        b = s->r[(size_t)j * ldr + j + 1];
+        rho = hypot(a, b);
+        c = a / rho;
+        sn = b / rho;
+        cblas_drot(p - 1 - j, s->r + (size_t)j * ldr + j, ldr, s->r + (size_t)j * ldr + j + 1, ldr, c, sn);
+        s->r[(size_t)j * ldr + j + 1] = 0.0;
+        cblas_drot(n, s->q + (size_t)j * s->ldq, 1, s->q + (size_t)(j + 1) * s->ldq, 1, c, sn);
+        cblas_drot(1, s->z + j, 1, s->z + j + 1, 1, c, sn);
+    }
+    for(j = 0; j < p; j++)
+        s->r[(size_t)(p - 1) * ldr + j] = 0.0;
+    s->n_term--;
+
+    /* Return the dropped direction to e and to the candidates. */
+    zd = s->z[p - 1];
+    cblas_daxpy(n, zd, qd, 1, s->e, 1);
+    s->rss = cblas_ddot(n, s->e, 1, s->e, 1);
+
+    for(j = 0; j < n; j++){
+        s->qe[j] = (float)qd[j];
+        s->qe[s->ldqe + j] = (float)s->e[j];
+    }
+    cblas_sgemm(LAYOUT, CblasTrans, CblasNoTrans,
+                s->n_marker, 2, n,
+                1.0f,
+                s->x, s->ldx,
+                s->qe, s->ldqe,
+                0.0f,
+                s->proj, s->n_marker);
+    for(j = 0; j < s->n_marker; j++)
+        s->norm[j] += (double)s->proj[j] * s->proj[j];
+}
+
+/*
+ * stepwise_backward
+ *   DESCRIPTION: Drops the term with the smallest partial |t| if its
+ *                p-value in the current model is above threshold. The
+ *                partial t statistics come from the row norms of R^(-1).
+ *   INPUTS: s         -- pointer to stepwise.
+ *           threshold -- p-value threshold to stay in the model.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if a term left, (0) otherwise.
+ *   SIDE EFFECTS: Updates s.
+ */
+int stepwise_backward(stepwise* s, double threshold){
+
+    double df = s->n_obs - s->n_term;
+    float p = 0.0f;
+    int worst = 0;
+    int i;                      /* Loop variable. */
+
+    if(s->n_term < 2 || df < 1.0 || term_statistics(s, s->est))
+        return 0;
+
+    worst = 1;
+    for(i = 2; i < s->n_term; i++)
+        if(fabsf(s->est[i].t) < fabsf(s->est[worst].t))
+            worst = i;
+
+    p = term_pvalue(s->est[worst].t, df, &s->est[worst].nlog10p);
+    if(p <= threshold)
+        return 0;
+
+    stepwise_remove(s, worst);
+    return 1;
+}
+
+/*
+ * collinear_count
+ *   DESCRIPTION: Candidates of the current model that vary but cannot
+ *                enter, their residual norm being below STEPWISE_TOL of
+ *                their sum of squares: combinations of the terms, or of
+ *                the intercept alone for markers constant over the
+ *                observed individuals.
+ *   INPUTS: s -- pointer to stepwise.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Number of such candidates.
+ *   SIDE EFFECTS: None.
+ */
+static long collinear_count(const stepwise* s){
+
+    long n = 0;
+    int i, j;                   /* Loop variables. */
+
+    for(j = 0; j < s->n_marker; j++)
+        if(s->sxx[j] > 0.0 && !(s->norm[j] > STEPWISE_TOL * s->sxx[j]))
+            n++;
+    /* Terms of the model have no residual left either. */
+    for(i = 1; i < s->n_term; i++){
+        j = s->term[i];
+        if(s->sxx[j] > 0.0 && !(s->norm[j] > STEPWISE_TOL * s->sxx[j]))
+            n--;
+    }
+
+    return n;
+}
+
+/*
+ * stepwise_write_header
+ *   DESCRIPTION: Writes the column names of the stepwise_write table.
+ */
+void stepwise_write_header(FILE* f){
+    fprintf(f, "Trait\tStep\tTerm\tEntryP\tCoefficient\tSE\tT\tP\tNegLog10P\n");
+}
+
+/*
+ * stepwise_write
+ *   DESCRIPTION: Writes one line per term of the current model: trait
+ *                name, step, term name, entry p-value, coefficient,
+ *                standard error, t, p and -log10 p in the final model.
+ *   INPUTS: s      -- pointer to stepwise.
+ *           f      -- output stream.
+ *           marker -- marker names.
+ *           trait  -- trait name.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f.
+ */
+int stepwise_write(const stepwise* s, FILE* f, const name_table* marker, const char* trait){
+
+    char entry_p[TDIST_PVALUE_CHARS];
+    char p[TDIST_PVALUE_CHARS];
+    int i;                      /* Loop variable. */
+
+    if(stepwise_estimates(s, s->est))
+        return 1;
+
+    for(i = 0; i < s->n_term; i++)
+        fprintf(f, "%s\t%d\t%s\t%s\t%g\t%g\t%g\t%s\t%g\n",
+                trait, i,
+                (s->term[i] < 0) ? "(Intercept)" : name_table_get(marker, s->term[i]),
+                tdist_format_pvalue(entry_p, s->entry_p[i], s->entry_nlog10p[i]),
+                s->est[i].slope, s->est[i].se, s->est[i].t,
+                tdist_format_pvalue(p, s->est[i].p, s->est[i].nlog10p), s->est[i].nlog10p);
+
+    return 0;
+}
+
+/*
+ * state_bytes
+ *   DESCRIPTION: Size of the state of the current model: terms, residual
+ *                sum of squares, R, Q^T * yc, Q, the residual and the
+ *                candidate norms and scores.
+ */
+static size_t state_bytes(const stepwise* s){
+
+    size_t p = (size_t)s->n_term;
+
+    return sizeof(int) + sizeof(double) + p * (sizeof(int) + 2 * sizeof(float)) +
+           (p * p + p + p * s->n_individual + s->n_individual + s->n_marker) * sizeof(double) +
+           (size_t)s->n_marker * sizeof(float);
+}
+
+/*
+ * put_bytes, get_bytes
+ *   DESCRIPTION: Copy to or from a state buffer and step past the bytes.
+ */
+static char* put_bytes(char* buf, const void* src, size_t bytes){
+    memcpy(buf, src, bytes);
+    return buf + bytes;
+}
+
+static const char* get_bytes(void* dst, const char* buf, size_t bytes){
+    memcpy(dst, buf, bytes);
+    return buf + bytes;
+}
+
+/*
+ * save_state
+ *   DESCRIPTION: Copies the state of the current model to buf, state_bytes
+ *                long. With the trait, it is all a selection needs to go
+ *                on exactly as it would have.
+ */
+static void save_state(const stepwise* s, char* buf){
+
+    int p = s->n_term;
+    int ldr = s->max_terms + 1;
+    int j;                      /* Loop variable. */
+
+    buf = put_bytes(buf, &s->n_term, sizeof(int));
+    buf = put_bytes(buf, &s->rss, sizeof(double));
+    buf = put_bytes(buf, s->term, p * sizeof(int));
+    buf = put_bytes(buf, s->entry_p, p * sizeof(float));
+    buf = put_bytes(buf, s->entry_nlog10p, p * sizeof(float));
+    for(j = 0; j < p; j++)
+        buf = put_bytes(buf, s->r + (size_t)j * ldr, p * sizeof(double));
+    buf = put_bytes(buf, s->z, p * sizeof(double));
+    for(j = 0; j < p; j++)
+        buf = put_bytes(buf, s->q + (size_t)j * s->ldq, s->n_individual * sizeof(double));
+    buf = put_bytes(buf, s->e, s->n_individual * sizeof(double));
+    buf = put_bytes(buf, s->norm, s->n_marker * sizeof(double));
+    buf = put_bytes(buf, s->proj + s->n_marker, s->n_marker * sizeof(float));
+}
+
+/*
+ * restore_state
+ *   DESCRIPTION: Restores a model saved by save_state over one just
+ *                started for the same trait.
+ *   RETURN VALUE: (0) on success, (1) if buf is not a state of s.
+ */
+static int restore_state(stepwise* s, const char* buf, size_t bytes){
+
+    int p = 0;
+    int ldr = s->max_terms + 1;
+    int j;                      /* Loop variable. */
+
+    if(bytes >= sizeof(int))
+        memcpy(&p, buf, sizeof(int));
+    s->n_term = p;
+    if(p < 1 || p > ldr || bytes != state_bytes(s)){
+        fprintf(stderr, "stepwise: checkpoint of another model\n");
+        return 1;
+    }
+
+    buf += sizeof(int);
+    buf = get_bytes(&s->rss, buf, sizeof(double));
+    buf = get_bytes(s->term, buf, p * sizeof(int));
+    buf = get_bytes(s->entry_p, buf, p * sizeof(float));
+    buf = get_bytes(s->entry_nlog10p, buf, p * sizeof(float));
+    for(j = 0; j < p; j++)
+        buf = get_bytes(s->r + (size_t)j * ldr, buf, p * sizeof(double));
+    buf = get_bytes(s->z, buf, p * sizeof(double));
+    for(j = 0; j < p; j++)
+        buf = get_bytes(s->q + (size_t)j * s->ldq, buf, s->n_individual * sizeof(double));
+    buf = get_bytes(s->e, buf, s->n_individual * sizeof(double));
+    buf = get_bytes(s->norm, buf, s->n_marker * sizeof(double));
+    buf = get_bytes(s->proj + s->n_marker, buf, s->n_marker * sizeof(float));
+
+    return 0;
+}
+
+/*
+ * stepwise_checkpoint
+ *   DESCRIPTION: Saves the traits written to f and, with n_step >= 0, the
+ *                current model of trait done.
+ *   INPUTS: s      -- pointer to stepwise.
+ *           f      -- output stream.
+ *           ck     -- checkpoint.
+ *           done   -- traits written.
+ *           n_step -- forward steps of the current model, -1 for none.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Replaces the checkpoint file.
+ */
+static int stepwise_checkpoint(const stepwise* s, FILE* f, checkpoint* ck, int done, long n_step){
+
+    char* buf = NULL;
+
+    if(fflush(f) != 0 || (ck->offset = ftell(f)) < 0){
+        fprintf(stderr, "cannot checkpoint the stepwise output\n");
+        return 1;
+    }
+    ck->stage = CHECKPOINT_STEPWISE;
+    ck->done = done;
+    if(n_step < 0)
+        checkpoint_model(ck, 0, 0);
+    else if((buf = checkpoint_model(ck, state_bytes(s), n_step)) == NULL)
+        return 1;
+    else
+        save_state(s, buf);
+
+    return checkpoint_save(ck);
+}
+
+/*
+ * stepwise_run
+ *   DESCRIPTION: Stepwise selection for every trait of y: after each
+ *                forward step, backward steps drop terms until every term
+ *                passes threshold again. Each model is written once no
+ *                candidate passes threshold, max_terms markers are in, or
+ *                STEPWISE_MAX_STEPS * max_terms forward steps were taken.
+ *   INPUTS: s         -- pointer to stepwise.
+ *           y         -- centered traits.
+ *           threshold -- p-value threshold to enter and to stay.
+ *           f         -- output stream.
+ *           marker    -- marker names.
+ *           trait     -- trait names of the phenotype.
+ *           ck        -- checkpoint to resume from and save to, NULL for
+ *                        none. With stage CHECKPOINT_STEPWISE, f holds
+ *                        ck->offset bytes of the traits before ck->done.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f and stderr; updates ck.
+ */
+int stepwise_run(stepwise* s, const scan_trait* y, double threshold, FILE* f,
+                 const name_table* marker, const name_table* trait, checkpoint* ck){
+
+    double start = wall_time(); /* Selection timer. */
+    long n_step = 0;
+    long n_drop = 0;
+    long limit = (long)STEPWISE_MAX_STEPS * s->max_terms;
+    long n_alloc = s->n_alloc;  /* Allocations before the steps. */
+    long n_collinear = 0;
+    long i = 0;
+    int resume = (ck != NULL && ck->stage == CHECKPOINT_STEPWISE);
+    int k;                      /* Loop variable.   */
+
+    if(!resume || ck->offset == 0)
+        stepwise_write_header(f);
+    for(k = resume ? (int)ck->done : 0; k < y->n_trait; k++){
+        stepwise_start(s, y, k);
+        i = 0;
+        if(resume && ck->model_bytes > 0){
+            if(restore_state(s, ck->model, ck->model_bytes))
+                return 1;
+            i = ck->n_step;
+        }
+        resume = 0;
+        for(; i < limit && stepwise_forward(s, threshold); i++){
+            while(stepwise_backward(s, threshold))
+                n_drop++;
+            if(ck != NULL && checkpoint_due(ck) && stepwise_checkpoint(s, f, ck, k, i + 1))
+                return 1;
+        }
+        n_step += i;
+        if((n_collinear = collinear_count(s)) > 0)
+            fprintf(stderr, "Stepwise %s: %ld candidates collinear with the model\n",
+                    name_table_get(trait, y->index[k]), n_collinear);
+        if(stepwise_write(s, f, marker, name_table_get(trait, y->index[k])))
+            return 1;
+        if(ck != NULL && checkpoint_due(ck) && stepwise_checkpoint(s, f, ck, k + 1, -1))
+            return 1;
+    }
+
+    fprintf(stderr, "Stepwise steps: %ld forward, %ld backward\nStepwise time: %.3f s\n",
+            n_step, n_drop, wall_time() - start);
+#ifdef DEBUG
+    fprintf(stderr, "Stepwise allocations: %ld in stepwise_create, %ld in the steps\n",
+            n_alloc, s->n_alloc - n_alloc);
+#else
+    (void)n_alloc;
+#endif
+
+    return 0;
+}
+
+/*
+ * free_stepwise
+ *   DESCRIPTION: Deallocates memory associated with a stepwise.
+ *   INPUTS: s -- pointer to stepwise.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a stepwise (x is untouched).
+ */
+void free_stepwise(stepwise* s){
+    if(s != NULL){
+        free(s->q);
+        free(s->e);
+        free(s->qe);
+        free(s->r);
+        free(s->rinv);
+        free(s->z);
+        free(s->h);
+        free(s->est);
+        free(s->term);
+        free(s->entry_p);
+        free(s->entry_nlog10p);
+        free(s->proj);
+        free(s->norm);
+        free(s->sxx);
+        free(s);
+    }
+}
@@ -0,0 +1,242 @@
+/* Stepwise Model Selection : Header File */
+
+#ifndef STEPWISE_H
+#define STEPWISE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mkl.h"
+#include "checkpoint.h"
+#include "markerstats.h"
+#include "names.h"
+#include "pfit.h"
+#include "scan.h"
+#include "tdist.h"
+
+/* Entry threshold when -stepwise-threshold is not given (as in the prototype). */
+#define STEPWISE_THRESHOLD 0.05
+
+/*
+ * A candidate whose squared residual norm is below this fraction of its
+ * sum of squares is a combination of the model terms and cannot enter.
+ */
+#define STEPWISE_TOL 1e-5
+
+/*
+ * Forward steps per trait, in units of max_terms, after which a selection
+ * that keeps trading terms in and out stops.
+ */
+#define STEPWISE_MAX_STEPS 4
+
+/*
+ * Stepwise selection of markers for one trait at a time, the C version of
+ * ConductForwardSteps with backward steps added. Each term gets an
+ * orthonormal column in Q, built by Gram-Schmidt (applied twice) against
+ * the terms already in, so that
+ *     W * X_model = Q * R     (W zeroes the individuals missing y)
+ * with the intercept as the first column. Nothing is refitted per step:
+ *     e       = yc - Q * Q^T * yc, the residual of the current model,
+ *     norm[c] = || (I - Q * Q^T) * W * x_c ||^2 for every candidate c,
+ * so adding candidate c lowers the residual sum of squares by
+ * (x_c^T * e)^2 / norm[c], and its t statistic in the larger model follows
+ * from that alone. After a term enters, one X^T * [q, e] product updates
+ * every norm and every x_c^T * e, O(n * candidates) per step. Q, R and e
+ * are kept in double so long runs of updates do not drift; they are small
+ * next to the float genotype.
+ *
+ * Backward steps work on the same factorization: the partial t of every
+ * term comes from the row norms of R^(-1), and a term leaves through
+ * Givens rotations that restore R after its column is deleted, which
+ * hands one column of Q back to the residual and to the candidates.
+ *
+ * A final model past pfit_wanted is refitted over every rank by pfit
+ * instead, so its fit and covariance need not fit one node.
+ *
+ * Every buffer is sized for max_terms by stepwise_create, so steps make
+ * no heap allocations. Compile with -DDEBUG to count allocations;
+ * stepwise_run reports those its steps made.
+ */
+typedef struct {
+    const float* x;             /* Genotype slab.                      */
+    int ldx;
+    int n_marker;
+    int n_individual;
+    const marker_stats* st;     /* Marker statistics, NULL for none.   */
+    int max_terms;              /* Largest model, intercept excluded.  */
+
+    double* q;                  /* Orthonormal columns, one per term.  */
+    int ldq;
+    double* r;                  /* Upper triangular R, max_terms + 1
+                                   square.                             */
+    double* z;                  /* Q^T * yc                            */
+    double* e;                  /* Residual of the current model.      */
+    float* qe;                  /* Newest q and e in float for X^T.    */
+    int ldqe;
+    const float* w;             /* Weights of the trait (in the
+                                   scan_trait), NULL if none.          */
+    const float* yc;            /* Centered trait (in the scan_trait). */
+    float* proj;                /* X^T * [q, e], n_marker rows.        */
+    double* h;                  /* Gram-Schmidt coefficients.          */
+    double* rinv;               /* Scratch: R^(-1).                    */
+    scan_result* est;           /* Scratch: estimates of the terms.    */
+    double* norm;               /* Residual norms of the candidates.   */
+    double* sxx;                /* W-weighted sums of x^2.             */
+
+    int* term;                  /* Marker of each term, -1: intercept. */
+    float* entry_p;             /* p-value of each term when it entered. */
+    float* entry_nlog10p;       /* Its -log10.                         */
+    int n_term;                 /* Terms in the model, intercept included. */
+    double n_obs;               /* Observed individuals of the trait.  */
+    double mean;                /* Mean of the trait.                  */
+    double rss;                 /* Residual sum of squares.            */
+    long n_alloc;               /* Heap allocations (-DDEBUG only).    */
+} stepwise;
+
+
+
+/*
+ * stepwise_create
+ *   DESCRIPTION: Allocates a stepwise selection over an in-memory genotype
+ *                slab for models of up to max_terms markers.
+ *   INPUTS: x            -- first marker column.
+ *           ldx          -- leading dimension of x.
+ *           n_marker     -- number of markers.
+ *           n_individual -- rows of x.
+ *           st           -- marker statistics, NULL for none.
+ *           max_terms    -- largest model, intercept excluded.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated stepwise, NULL on failure.
+ *   SIDE EFFECTS: Allocates a stepwise.
+ */
+stepwise* stepwise_create(const float* x, int ldx, int n_marker, int n_individual,
+                          const marker_stats* st, int max_terms);
+
+/*
+ * stepwise_start
+ *   DESCRIPTION: Starts a new selection from the intercept-only model of
+ *                trait k.
+ *   INPUTS: s -- pointer to stepwise.
+ *           y -- centered traits.
+ *           k -- trait of y.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Resets s; one pass over the genotype.
+ */
+void stepwise_start(stepwise* s, const scan_trait* y, int k);
+
+/*
+ * stepwise_forward
+ *   DESCRIPTION: Adds the candidate that lowers the residual sum of
+ *                squares most, if its p-value in the larger model is at
+ *                most threshold.
+ *   INPUTS: s         -- pointer to stepwise.
+ *           threshold -- entry p-value threshold.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if a term entered, (0) otherwise.
+ *   SIDE EFFECTS: Updates s; one pass over the genotype.
+ */
+int stepwise_forward(stepwise* s, double threshold);
+
+/*
+ * stepwise_remove
+ *   DESCRIPTION: Drops term i from the model without refitting. Deleting
+ *                column i of R leaves it upper Hessenberg from column i on;
+ *                Givens rotations of rows (j, j + 1) restore the triangle
+ *                and are applied to the columns of Q and to Q^T * yc as
+ *                well. The last column of Q is then the direction that
+ *                left the model: its part of yc returns to the residual and
+ *                its projections return to the candidate norms.
+ *   INPUTS: s -- pointer to stepwise.
+ *           i -- term to drop (not the intercept).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Updates s; one pass over the genotype.
+ */
+void stepwise_remove(stepwise* s, int i);
+
+/*
+ * stepwise_backward
+ *   DESCRIPTION: Drops the term with the smallest partial |t| if its
+ *                p-value in the current model is above threshold. The
+ *                partial t statistics come from the row norms of R^(-1).
+ *   INPUTS: s         -- pointer to stepwise.
+ *           threshold -- p-value threshold to stay in the model.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (1) if a term left, (0) otherwise.
+ *   SIDE EFFECTS: Updates s.
+ */
+int stepwise_backward(stepwise* s, double threshold);
+
+/*
+ * stepwise_estimates
+ *   DESCRIPTION: Coefficients of the current model, R^(-1) * Q^T * yc, and
+ *                their standard errors from the row norms of R^(-1). A
+ *                model past pfit_wanted goes to pfit_model instead.
+ *   INPUTS: s -- pointer to stepwise.
+ *   OUTPUTS: r -- one result per term, intercept first: slope holds the
+ *                coefficient (intercept is unused), p and nlog10p set.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Collective when the model goes to pfit_model.
+ */
+int stepwise_estimates(const stepwise* s, scan_result* r);
+
+/*
+ * stepwise_write_header
+ *   DESCRIPTION: Writes the column names of the stepwise_write table.
+ */
+void stepwise_write_header(FILE* f);
+
+/*
+ * stepwise_write
+ *   DESCRIPTION: Writes one line per term of the current model: trait
+ *                name, step, term name, entry p-value, coefficient,
+ *                standard error, t, p and -log10 p in the final model.
+ *   INPUTS: s      -- pointer to stepwise.
+ *           f      -- output stream.
+ *           marker -- marker names.
+ *           trait  -- trait name.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f.
+ */
+int stepwise_write(const stepwise* s, FILE* f, const name_table* marker, const char* trait);
+
+/*
+ * stepwise_run
+ *   DESCRIPTION: Stepwise selection for every trait of y: after each
+ *                forward step, backward steps drop terms until every term
+ *                passes threshold again. Each model is written once no
+ *                candidate passes threshold, max_terms markers are in, or
+ *                STEPWISE_MAX_STEPS * max_terms forward steps were taken.
+ *                Candidates left out as collinear with a model are
+ *                counted on stderr.
+ *   INPUTS: s         -- pointer to stepwise.
+ *           y         -- centered traits.
+ *           threshold -- p-value threshold to enter and to stay.
+ *           f         -- output stream.
+ *           marker    -- marker names.
+ *           trait     -- trait names of the phenotype.
+ *           ck        -- checkpoint to resume from and save to, NULL for
+ *                        none. A checkpoint holds the traits written, the
+ *                        bytes of f they take, and the factorization and
+ *                        candidate norms of the current model, so that a
+ *                        resumed selection takes the same steps.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Writes to f and stderr; updates ck.
+ */
+int stepwise_run(stepwise* s, const scan_trait* y, double threshold, FILE* f,
+                 const name_table* marker, const name_table* trait, checkpoint* ck);
+
+/*
+ * free_stepwise
+ *   DESCRIPTION: Deallocates memory associated with a stepwise.
+ *   INPUTS: s -- pointer to stepwise.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Deallocates a stepwise (x is untouched).
+ */
+void free_stepwise(stepwise* s);
+
+#endif
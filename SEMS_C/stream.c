@@ -0,0 +1,402 @@
+/* Marker Stream : Function Definition File */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "stream.h"
+
+/*
+ * read_full
+ *   DESCRIPTION: pread that retries until size bytes are read.
+ *   INPUTS: fd     -- file descriptor.
+ *           buf    -- destination.
+ *           size   -- bytes to read.
+ *           offset -- file offset.
+ *   OUTPUTS: buf
+ *   RETURN VALUE: (0) on success, (1) on failure or short file.
+ *   SIDE EFFECTS: None.
+ */
+static int read_full(int fd, void* buf, size_t size, uint64_t offset){
+    char* p = (char*)buf;
+    ssize_t n = 0;
+
+    while(size > 0){
+        if((n = pread(fd, p, size, (off_t)offset)) <= 0)
+            return 1;
+        p += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+/*
+ * open_binary
+ *   DESCRIPTION: Reads the header and names of a binary cache.
+ *   INPUTS: ms -- stream with fd and fileName set.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Allocates the names block, name tables and read buffer.
+ */
+static int open_binary(marker_stream* ms){
+
+    struct stat st;             /* File status. */
+    data_header* h = &ms->header;
+
+    if(fstat(ms->fd, &st) != 0 || data_header_check(h, (uint64_t)st.st_size, ms->fileName) != 0)
+        return 1;
+
+    if((ms->names = (char*)malloc(h->names_size)) == NULL){
+        fprintf(stderr, "cannot allocate memory: stream names\n");
+        return 1;
+    }
+    if(read_full(ms->fd, ms->names, h->names_size, h->names_offset) != 0){
+        fprintf(stderr, "cannot read file \"%s\"\n", ms->fileName);
+        return 1;
+    }
+    if(data_names_wrap(h, ms->names, ms->fileName, &ms->marker, &ms->individual) != 0)
+        return 1;
+
+    ms->n_marker = (int)h->n_col;
+    ms->n_individual = (int)h->n_row;
+
+    if(h->encoding == DATA_ENCODING_DOSAGE &&
+       (ms->code = (unsigned char*)malloc(ms->block_markers * data_column_size(h))) == NULL){
+        fprintf(stderr, "cannot allocate memory: stream buffer\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * open_text
+ *   DESCRIPTION: Maps a text genotype file, interns the marker and
+ *                individual names, and points a cursor at the first value
+ *                of every individual's line.
+ *   INPUTS: ms -- stream with fileName set.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Maps the file, allocates name tables and cursors.
+ */
+static int open_text(marker_stream* ms){
+
+    const char* header = NULL;  /* Scan pointers.  */
+    const char* body = NULL;
+    const char* end = NULL;
+    const char* q = NULL;
+    const char* t = NULL;
+    int n_row = 0;
+    int j = 0;                  /* Loop variable.  */
+
+    if((ms->map = map_file(ms->fileName)) == NULL)
+        return 1;
+    end = ms->map->data + ms->map->size;
+
+    if(text_header(ms->map->data, ms->map->size, ms->fileName, &header, &body, &ms->n_marker) != 0)
+        return 1;
+
+    /* Marker names. */
+    if((ms->marker = name_table_create(ms->n_marker, (size_t)(body - header))) == NULL)
+        return 1;
+    for(j = 0, q = header; j < ms->n_marker; j++){
+        t = skip_token(q, end);
+        if(name_table_add(ms->marker, q, (size_t)(t - q)) < 0)
+            return 1;
+        q = skip_blank(t, end);
+    }
+
+    /* Rows. */
+    for(q = body; q < end; q = next_line(q, end)){
+        t = skip_blank(q, end);
+        if(t < end && !is_eol(*t))
+            n_row++;
+    }
+    if(ms->n_marker == 0 || n_row == 0){
+        fprintf(stderr, "file \"%s\": no data\n", ms->fileName);
+        return 1;
+    }
+
+    if((ms->individual = name_table_create(n_row, 16 * (size_t)n_row)) == NULL ||
+       (ms->cursor = (const char**)malloc(n_row * sizeof(const char*))) == NULL){
+        fprintf(stderr, "cannot allocate memory: stream cursors\n");
+        return 1;
+    }
+    for(q = body; q < end; q = next_line(q, end)){
+        q = skip_blank(q, end);
+        if(q >= end || is_eol(*q))
+            continue;
+        t = skip_token(q, end);
+        ms->cursor[ms->individual->n_name] = t;
+        if(name_table_add(ms->individual, q, (size_t)(t - q)) < 0)
+            return 1;
+    }
+    ms->n_individual = n_row;
+
+    return 0;
+}
+
+/*
+ * fill_block
+ *   DESCRIPTION: Reads block k of the stream into b.
+ *   INPUTS: ms -- pointer to marker_stream.
+ *           b  -- destination block.
+ *           k  -- block index.
+ *   OUTPUTS: b
+ *   RETURN VALUE: (0) on success, (1) on failure.
+ *   SIDE EFFECTS: Advances the text cursors.
+ */
+static int fill_block(marker_stream* ms, marker_block* b, int k){
+
+    const char* end = NULL;     /* Text scan pointers. */
+    const char* p = NULL;
+    data_header* h = &ms->header;
+    uint64_t column_size = 0;
+    int i, j;                   /* Loop variables.     */
+
+    b->first = k * ms->block_markers;
+    b->n_marker = ms->n_marker - b->first;
+    if(b->n_marker > ms->block_markers)
+        b->n_marker = ms->block_markers;
+
+    /* Text: the next n_marker values of every line. */
+    if(ms->map != NULL){
+        end = ms->map->data + ms->map->size;
+        for(i = 0; i < ms->n_individual; i++){
+            p = ms->cursor[i];
+            for(j = 0; j < b->n_marker; j++){
+                p = skip_blank(p, end);
+                if(p >= end || is_eol(*p)){
+                    fprintf(stderr, "file \"%s\": row %d has %d of %d values\n",
+                            ms->fileName, i + 1, b->first + j, ms->n_marker);
+                    return 1;
+                }
+                if((p = parse_float(p, end, b->matrix + (size_t)j * b->ld + i)) == NULL){
+                    fprintf(stderr, "file \"%s\": row %d, column %d is not a number\n",
+                            ms->fileName, i + 1, b->first + j + 1);
+                    return 1;
+                }
+            }
+            ms->cursor[i] = p;
+        }
+        return 0;
+    }
+
+    /* Binary: one contiguous read, straight into the block for floats. */
+    column_size = data_column_size(h);
+    if(h->encoding == DATA_ENCODING_FLOAT){
+        if(read_full(ms->fd, b->matrix, b->n_marker * column_size, h->matrix_offset + b->first * column_size) != 0){
+            fprintf(stderr, "cannot read file \"%s\"\n", ms->fileName);
+            return 1;
+        }
+        return 0;
+    }
+
+    if(read_full(ms->fd, ms->code, b->n_marker * column_size, h->matrix_offset + b->first * column_size) != 0){
+        fprintf(stderr, "cannot read file \"%s\"\n", ms->fileName);
+        return 1;
+    }
+    for(j = 0; j < b->n_marker; j++)
+        data_decode_dosage(ms->code + j * column_size, ms->n_individual, b->matrix + (size_t)j * b->ld);
+
+    return 0;
+}
+
+/*
+ * stream_reader
+ *   DESCRIPTION: Reader thread body: fills blocks in order, alternating
+ *                between the two buffers, waiting while the next buffer is
+ *                still in use.
+ *   INPUTS: arg -- pointer to marker_stream.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: NULL.
+ *   SIDE EFFECTS: Fills blocks, sets status on error.
+ */
+static void* stream_reader(void* arg){
+
+    marker_stream* ms = (marker_stream*)arg;
+    int k = 0;                  /* Block index.  */
+    int s = 0;                  /* Buffer index. */
+
+    for(k = 0; k < ms->n_block; k++){
+        s = k & 1;
+
+        pthread_mutex_lock(&ms->lock);
+        while(ms->filled[s] && !ms->stop)
+            pthread_cond_wait(&ms->cond, &ms->lock);
+        if(ms->stop){
+            pthread_mutex_unlock(&ms->lock);
+            break;
+        }
+        pthread_mutex_unlock(&ms->lock);
+
+        /* Read outside the lock so the caller keeps computing. */
+        if(fill_block(ms, &ms->block[s], k) != 0){
+            pthread_mutex_lock(&ms->lock);
+            ms->status = 1;
+            pthread_cond_broadcast(&ms->cond);
+            pthread_mutex_unlock(&ms->lock);
+            break;
+        }
+
+        pthread_mutex_lock(&ms->lock);
+        ms->filled[s] = 1;
+        pthread_cond_broadcast(&ms->cond);
+        pthread_mutex_unlock(&ms->lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * marker_stream_open
+ *   DESCRIPTION: Opens a genotype file for block-wise reading and starts
+ *                the reader thread on the first block. Text files are
+ *                indexed once (individual names and row starts); binary
+ *                caches are read with pread, one block at a time.
+ *   INPUTS: fileName      -- name of text or binary genotype file.
+ *           block_markers -- markers per block.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stream, NULL on failure.
+ *   SIDE EFFECTS: Allocates two blocks and starts a thread.
+ */
+marker_stream* marker_stream_open(char* fileName, int block_markers){
+
+    marker_stream* ms = NULL;   /* Return argument. */
+    int n_block = 0;
+    int binary = 0;
+    int s = 0;                  /* Loop variable.   */
+
+    if((ms = (marker_stream*)calloc(1, sizeof(marker_stream))) == NULL){
+        fprintf(stderr, "cannot allocate memory: marker_stream*\n");
+        return NULL;
+    }
+    ms->fileName = fileName;
+    ms->current = -1;
+    ms->block_markers = (block_markers > 0) ? block_markers : 1;
+
+    /* Open file error handling. */
+    if((ms->fd = open(fileName, O_RDONLY)) < 0){
+        fprintf(stderr, "file \"%s\" does not exist\n", fileName);
+        free(ms);
+        return NULL;
+    }
+
+    /* Binary cache or text. */
+    binary = (read_full(ms->fd, &ms->header, sizeof(data_header), 0) == 0 &&
+              memcmp(ms->header.magic, GENOTYPE_MAGIC, sizeof(GENOTYPE_MAGIC)) == 0);
+    if(!binary){
+        close(ms->fd);
+        ms->fd = -1;
+    }
+    if((binary ? open_binary(ms) : open_text(ms)) != 0){
+        marker_stream_close(ms);
+        return NULL;
+    }
+
+    if(ms->block_markers > ms->n_marker)
+        ms->block_markers = ms->n_marker;
+    n_block = (ms->n_marker + ms->block_markers - 1) / ms->block_markers;
+
+    /* Two block buffers. */
+    for(s = 0; s < 2; s++){
+        ms->block[s].n_individual = ms->n_individual;
+        if((ms->block[s].matrix = matrix_alloc(ms->n_individual, ms->block_markers, &ms->block[s].ld)) == NULL){
+            fprintf(stderr, "cannot allocate memory: stream block\n");
+            marker_stream_close(ms);
+            return NULL;
+        }
+    }
+
+    /* The reader runs once n_block is set; close joins it from then on. */
+    pthread_mutex_init(&ms->lock, NULL);
+    pthread_cond_init(&ms->cond, NULL);
+    ms->n_block = n_block;
+    if(pthread_create(&ms->reader, NULL, stream_reader, ms) != 0){
+        fprintf(stderr, "cannot start reader thread\n");
+        pthread_mutex_destroy(&ms->lock);
+        pthread_cond_destroy(&ms->cond);
+        ms->n_block = 0;
+        marker_stream_close(ms);
+        return NULL;
+    }
+
+    fprintf(stderr, "Markers: %d\nIndividuals: %d\nBlocks: %d x %d markers\n",
+            ms->n_marker, ms->n_individual, ms->n_block, ms->block_markers);
+
+    return ms;
+}
+
+/*
+ * marker_stream_next
+ *   DESCRIPTION: Hands out the next block. The previous block is given
+ *                back to the reader, so it must not be used afterwards.
+ *   INPUTS: ms -- pointer to marker_stream.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to the next block, NULL at the end or on error
+ *                 (see ms->status).
+ *   SIDE EFFECTS: Lets the reader refill the previous block.
+ */
+marker_block* marker_stream_next(marker_stream* ms){
+
+    marker_block* b = NULL;     /* Return argument. */
+    int s = 0;                  /* Buffer index. */
+
+    pthread_mutex_lock(&ms->lock);
+
+    /* Give the previous block back. */
+    if(ms->current >= 0){
+        ms->filled[ms->current & 1] = 0;
+        pthread_cond_broadcast(&ms->cond);
+    }
+
+    if(ms->current + 1 >= ms->n_block){
+        ms->current = ms->n_block;
+        pthread_mutex_unlock(&ms->lock);
+        return NULL;
+    }
+    ms->current++;
+    s = ms->current & 1;
+
+    while(!ms->filled[s] && !ms->status)
+        pthread_cond_wait(&ms->cond, &ms->lock);
+    /* filled belongs to the reader once the lock is released. */
+    if(ms->filled[s])
+        b = &ms->block[s];
+    pthread_mutex_unlock(&ms->lock);
+
+    return b;
+}
+
+/*
+ * marker_stream_close
+ *   DESCRIPTION: Stops the reader and deallocates a marker_stream.
+ *   INPUTS: ms -- pointer to marker_stream.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Joins the reader thread, deallocates memory.
+ */
+void marker_stream_close(marker_stream* ms){
+    if(ms != NULL){
+        if(ms->n_block > 0){
+            pthread_mutex_lock(&ms->lock);
+            ms->stop = 1;
+            pthread_cond_broadcast(&ms->cond);
+            pthread_mutex_unlock(&ms->lock);
+            pthread_join(ms->reader, NULL);
+            pthread_mutex_destroy(&ms->lock);
+            pthread_cond_destroy(&ms->cond);
+        }
+        free(ms->block[0].matrix);
+        free(ms->block[1].matrix);
+        free_name_table(ms->marker);
+        free_name_table(ms->individual);
+        free(ms->names);
+        free(ms->code);
+        free(ms->cursor);
+        unmap_file(ms->map);
+        if(ms->fd >= 0)
+            close(ms->fd);
+        free(ms);
+    }
+}
@@ -0,0 +1,98 @@
+/* Marker Stream : Header File */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "data.h"
+
+/*
+ * A block of consecutive markers for all individuals, laid out like
+ * genotype.matrix (column major, 64-byte aligned columns).
+ */
+typedef struct {
+    int first;                  /* Index of the first marker.          */
+    int n_marker;               /* Markers in this block.              */
+    int n_individual;
+    int ld;                     /* Leading dimension of matrix.        */
+    float* matrix;
+} marker_block;
+
+/*
+ * Reads a genotype file (text or binary cache) block_markers markers at a
+ * time. A reader thread fills one block while the caller works on the
+ * other, so at most two blocks are in memory at once.
+ */
+typedef struct {
+    int n_marker;
+    int n_individual;
+    int block_markers;
+    int n_block;
+
+    name_table* marker;
+    name_table* individual;
+
+    /* Text source: mapped file and a parse cursor per individual. */
+    mapped_file* map;
+    const char** cursor;
+
+    /* Binary source: descriptor, header and names block. */
+    int fd;
+    data_header header;
+    char* names;
+    unsigned char* code;        /* Read buffer for one binary block.   */
+
+    char* fileName;
+
+    /* Double buffering. */
+    marker_block block[2];
+    int filled[2];              /* Buffer holds a block not yet used.  */
+    int current;                /* Block handed out last, -1 at start. */
+    int stop;                   /* Reader should exit.                 */
+    int status;                 /* (1) once the reader hit an error.   */
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} marker_stream;
+
+
+
+/*
+ * marker_stream_open
+ *   DESCRIPTION: Opens a genotype file for block-wise reading and starts
+ *                the reader thread on the first block. Text files are
+ *                indexed once (individual names and row starts); binary
+ *                caches are read with pread, one block at a time.
+ *   INPUTS: fileName      -- name of text or binary genotype file.
+ *           block_markers -- markers per block.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to newly allocated marker_stream, NULL on failure.
+ *   SIDE EFFECTS: Allocates two blocks and starts a thread.
+ */
+marker_stream* marker_stream_open(char* fileName, int block_markers);
+
+/*
+ * marker_stream_next
+ *   DESCRIPTION: Hands out the next block. The previous block is given
+ *                back to the reader, so it must not be used afterwards.
+ *   INPUTS: ms -- pointer to marker_stream.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Pointer to the next block, NULL at the end or on error
+ *                 (see ms->status).
+ *   SIDE EFFECTS: Lets the reader refill the previous block.
+ */
+marker_block* marker_stream_next(marker_stream* ms);
+
+/*
+ * marker_stream_close
+ *   DESCRIPTION: Stops the reader and deallocates a marker_stream.
+ *   INPUTS: ms -- pointer to marker_stream.
+ *   OUTPUTS: None.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: Joins the reader thread, deallocates memory.
+ */
+void marker_stream_close(marker_stream* ms);
+
+#endif
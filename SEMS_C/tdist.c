@@ -0,0 +1,211 @@
+/* Student t Distribution : Function Definition File */
+
+#include "tdist.h"
+
+/* Keeps the continued fraction away from division by zero. */
+#define TDIST_TINY 1e-300
+
+/* Natural log of 10. */
+#define TDIST_LN10 2.30258509299404568402
+
+/*
+ * lanes_log_pvalue
+ *   DESCRIPTION: log of the two-tailed p-value for up to TDIST_LANES
+ *                statistics. Every lane runs the modified Lentz iteration
+ *                for the continued fraction of I_x(a, b) in lockstep
+ *                until all have converged; lanes past the midpoint of the
+ *                distribution use I_x(a, b) = 1 - I_(1-x)(b, a).
+ *   INPUTS: d      -- distribution.
+ *           t      -- statistics.
+ *           n_lane -- number of lanes in use.
+ *   OUTPUTS: logp -- natural log of the p-values.
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+static void lanes_log_pvalue(const tdist* d, const double* t, int n_lane, double* logp){
+
+    double a[TDIST_LANES], b[TDIST_LANES], x[TDIST_LANES];  /* Oriented I_x(a, b). */
+    double front[TDIST_LANES];                              /* log x^a (1-x)^b / (a B) */
+    double c[TDIST_LANES], e[TDIST_LANES], h[TDIST_LANES];  /* Lentz state.        */
+    int swap[TDIST_LANES];
+    double t2, s, lx, l1x, num, del;
+    int done = 0;
+    int m, k;                   /* Loop variables. */
+
+    for(k = 0; k < n_lane; k++){
+        t2 = t[k] * t[k];
+        s = d->df + t2;
+        lx = log(d->df) - log(s);                   /* log x       */
+        l1x = log(t2) - log(s);                     /* log (1 - x) */
+        swap[k] = (d->df / s) >= (d->a + 1.0) / (d->a + d->b + 2.0);
+
+        a[k] = swap[k] ? d->b : d->a;
+        b[k] = swap[k] ? d->a : d->b;
+        x[k] = swap[k] ? t2 / s : d->df / s;
+        front[k] = d->a * lx + d->b * l1x - d->log_beta - log(a[k]);
+
+        c[k] = 1.0;
+        e[k] = 1.0 - (a[k] + b[k]) * x[k] / (a[k] + 1.0);
+        e[k] = 1.0 / ((fabs(e[k]) < TDIST_TINY) ? TDIST_TINY : e[k]);
+        h[k] = e[k];
+    }
+
+    for(m = 1; m <= TDIST_MAX_ITER && !done; m++){
+        done = 1;
+        for(k = 0; k < n_lane; k++){
+            /* Even step. */
+            num = m * (b[k] - m) * x[k] / ((a[k] + 2 * m - 1.0) * (a[k] + 2 * m));
+            e[k] = 1.0 + num * e[k];
+            e[k] = 1.0 / ((fabs(e[k]) < TDIST_TINY) ? TDIST_TINY : e[k]);
+            c[k] = 1.0 + num / c[k];
+            c[k] = (fabs(c[k]) < TDIST_TINY) ? TDIST_TINY : c[k];
+            h[k] *= e[k] * c[k];
+
+            /* Odd step. */
+            num = -(a[k] + m) * (a[k] + b[k] + m) * x[k] / ((a[k] + 2 * m) * (a[k] + 2 * m + 1.0));
+            e[k] = 1.0 + num * e[k];
+            e[k] = 1.0 / ((fabs(e[k]) < TDIST_TINY) ? TDIST_TINY : e[k]);
+            c[k] = 1.0 + num / c[k];
+            c[k] = (fabs(c[k]) < TDIST_TINY) ? TDIST_TINY : c[k];
+            del = e[k] * c[k];
+            h[k] *= del;
+
+            if(fabs(del - 1.0) > TDIST_EPS)
+                done = 0;
+        }
+    }
+
+    for(k = 0; k < n_lane; k++){
+        if(isnan(t[k]))
+            logp[k] = NAN;
+        else if(isinf(t[k]))
+            logp[k] = -INFINITY;
+        else if(swap[k])
+            logp[k] = log1p(-exp(front[k] + log(h[k])));
+        else
+            logp[k] = front[k] + log(h[k]);
+    }
+}
+
+/*
+ * tdist_init
+ *   DESCRIPTION: Precomputes the constants for df degrees of freedom.
+ *   INPUTS: d  -- distribution to fill.
+ *           df -- degrees of freedom (> 0).
+ *   OUTPUTS: d
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void tdist_init(tdist* d, double df){
+    d->df = df;
+    d->a = 0.5 * df;
+    d->b = 0.5;
+    d->log_beta = lgamma(d->a) + lgamma(d->b) - lgamma(d->a + d->b);
+}
+
+/*
+ * tdist_pvalue
+ *   DESCRIPTION: Two-tailed p-values of n t statistics, TDIST_LANES at a
+ *                time. The p-value is computed in log space, so -log10 p
+ *                stays exact far below the smallest float.
+ *   INPUTS: d -- distribution.
+ *           t -- t statistics (NAN gives NAN).
+ *           n -- number of statistics.
+ *   OUTPUTS: p       -- p-values (may be NULL).
+ *            nlog10p -- -log10 of the p-values (may be NULL).
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void tdist_pvalue(const tdist* d, const float* t, int n, float* p, float* nlog10p){
+
+    double tl[TDIST_LANES];     /* Lane inputs.  */
+    double logp[TDIST_LANES];   /* Lane outputs. */
+    int n_lane = 0;
+    int i, k;                   /* Loop variables. */
+
+    for(i = 0; i < n; i += TDIST_LANES){
+        n_lane = (n - i < TDIST_LANES) ? n - i : TDIST_LANES;
+        for(k = 0; k < n_lane; k++)
+            tl[k] = t[i + k];
+
+        lanes_log_pvalue(d, tl, n_lane, logp);
+
+        for(k = 0; k < n_lane; k++){
+            if(p != NULL)
+                p[i + k] = (float)exp(logp[k]);
+            if(nlog10p != NULL)
+                nlog10p[i + k] = (float)(-logp[k] / TDIST_LN10);
+        }
+    }
+}
+
+/*
+ * tdist_critical
+ *   DESCRIPTION: Smallest |t| whose two-tailed p-value is at most alpha,
+ *                found by bisection. Statistics below it can be rejected
+ *                without evaluating the distribution.
+ *   INPUTS: d     -- distribution.
+ *           alpha -- p-value threshold in (0, 1).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Critical value of |t|.
+ *   SIDE EFFECTS: None.
+ */
+double tdist_critical(const tdist* d, double alpha){
+
+    double target = log(alpha);
+    double lo = 0.0;
+    double hi = 1.0;
+    double mid = 0.0;
+    double logp = 0.0;
+    int i = 0;                  /* Loop variable. */
+
+    /* Bracket: p-values fall with |t|. */
+    for(lanes_log_pvalue(d, &hi, 1, &logp); logp > target && hi < 1e300; lanes_log_pvalue(d, &hi, 1, &logp)){
+        lo = hi;
+        hi *= 2.0;
+    }
+
+    for(i = 0; i < 200 && hi - lo > 1e-12 * hi; i++){
+        mid = 0.5 * (lo + hi);
+        lanes_log_pvalue(d, &mid, 1, &logp);
+        if(logp > target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return hi;
+}
+
+/*
+ * tdist_format_pvalue
+ *   DESCRIPTION: Formats a p-value as %g. A p-value that underflowed a
+ *                float to 0 is formatted from its -log10 instead, so only
+ *                an infinite t shows as 0.
+ *   INPUTS: p       -- p-value.
+ *           nlog10p -- -log10 p, as from tdist_pvalue.
+ *   OUTPUTS: buf -- TDIST_PVALUE_CHARS characters.
+ *   RETURN VALUE: buf
+ *   SIDE EFFECTS: None.
+ */
+char* tdist_format_pvalue(char* buf, float p, float nlog10p){
+
+    double e = 0.0;             /* Decimal exponent of p.    */
+    double m = 0.0;             /* Mantissa of p, in [1, 10). */
+
+    if(p != 0.0f || !(nlog10p > 0.0f) || isinf(nlog10p)){
+        snprintf(buf, TDIST_PVALUE_CHARS, "%g", p);
+        return buf;
+    }
+
+    /* p = m * 10^(-e) */
+    e = ceil(nlog10p);
+    m = pow(10.0, e - nlog10p);
+    if(m >= 9.999995){          /* %g would round it to 10. */
+        m = 1.0;
+        e -= 1.0;
+    }
+    snprintf(buf, TDIST_PVALUE_CHARS, "%ge-%.0f", m, e);
+
+    return buf;
+}
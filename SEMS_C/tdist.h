@@ -0,0 +1,85 @@
+/* Student t Distribution : Header File */
+
+#ifndef TDIST_H
+#define TDIST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/* Values evaluated side by side; the inner loops run over the lanes. */
+#define TDIST_LANES 8
+
+/* Continued fraction limits. */
+#define TDIST_MAX_ITER 300
+#define TDIST_EPS      1e-12
+
+/* Characters tdist_format_pvalue writes, with the terminating NUL. */
+#define TDIST_PVALUE_CHARS 32
+
+/*
+ * Constants of one Student t distribution. The two-tailed p-value of t is
+ * the regularized incomplete beta I_x(df / 2, 1 / 2) at x = df / (df + t^2).
+ */
+typedef struct {
+    double df;                  /* Degrees of freedom.     */
+    double a;                   /* df / 2                  */
+    double b;                   /* 1 / 2                   */
+    double log_beta;            /* log B(a, b)             */
+} tdist;
+
+
+
+/*
+ * tdist_init
+ *   DESCRIPTION: Precomputes the constants for df degrees of freedom.
+ *   INPUTS: d  -- distribution to fill.
+ *           df -- degrees of freedom (> 0).
+ *   OUTPUTS: d
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void tdist_init(tdist* d, double df);
+
+/*
+ * tdist_pvalue
+ *   DESCRIPTION: Two-tailed p-values of n t statistics, TDIST_LANES at a
+ *                time. The p-value is computed in log space, so -log10 p
+ *                stays exact far below the smallest float.
+ *   INPUTS: d -- distribution.
+ *           t -- t statistics (NAN gives NAN).
+ *           n -- number of statistics.
+ *   OUTPUTS: p       -- p-values (may be NULL).
+ *            nlog10p -- -log10 of the p-values (may be NULL).
+ *   RETURN VALUE: None.
+ *   SIDE EFFECTS: None.
+ */
+void tdist_pvalue(const tdist* d, const float* t, int n, float* p, float* nlog10p);
+
+/*
+ * tdist_critical
+ *   DESCRIPTION: Smallest |t| whose two-tailed p-value is at most alpha,
+ *                found by bisection. Statistics below it can be rejected
+ *                without evaluating the distribution.
+ *   INPUTS: d     -- distribution.
+ *           alpha -- p-value threshold in (0, 1).
+ *   OUTPUTS: None.
+ *   RETURN VALUE: Critical value of |t|.
+ *   SIDE EFFECTS: None.
+ */
+double tdist_critical(const tdist* d, double alpha);
+
+/*
+ * tdist_format_pvalue
+ *   DESCRIPTION: Formats a p-value as %g. A p-value that underflowed a
+ *                float to 0 is formatted from its -log10 instead, so only
+ *                an infinite t shows as 0.
+ *   INPUTS: p       -- p-value.
+ *           nlog10p -- -log10 p, as from tdist_pvalue.
+ *   OUTPUTS: buf -- TDIST_PVALUE_CHARS characters.
+ *   RETURN VALUE: buf
+ *   SIDE EFFECTS: None.
+ */
+char* tdist_format_pvalue(char* buf, float p, float nlog10p);
+
+#endif